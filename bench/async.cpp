@@ -0,0 +1,116 @@
+/**
+ * @file   async.cpp
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Many in-flight coroutine transactions per thread (tm_async.hpp): each thread runs a scheduler with a number of
+ * coroutines (1, 16, 256 and 1024 by default, or -p coroutines), each of them running transfers between two random
+ * accounts out of -s accounts (1024 by default) until the end of the run. A transfer yields to the other coroutines
+ * between its two reads, so that the transfers of all the coroutines of a thread are in flight together. The latency
+ * of a transfer is measured from its first attempt to its commit, thus it includes the time spent running the other
+ * coroutines of the thread.
+ *
+ *   bin/async-default -t 1,4 -p 256
+ **/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <tm_async.hpp>
+
+#include "bench.h"
+
+struct AsyncWorkload
+{
+    shared_t shared;
+    uint64_t *accounts;
+    size_t count;
+    size_t coroutines; // Per thread
+};
+
+static tm_async::Task<void> async_worker(tm_async::Scheduler &scheduler, bench_thread_t *thread, AsyncWorkload *workload)
+{
+    while (!bench_stopped(thread))
+    {
+        uint64_t *from = &workload->accounts[bench_rand(thread) % workload->count];
+        uint64_t *to = &workload->accounts[bench_rand(thread) % workload->count];
+        if (from == to)
+        {
+            continue;
+        }
+
+        uint64_t start = bench_now_ns();
+        uint64_t attempts = 0;
+        co_await tm_async::atomically(scheduler, workload->shared, false, [&](tm_async::Tx &tx) -> tm_async::Task<bool> {
+            attempts++;
+            uint64_t source, target;
+            if (!co_await tx.read(from, sizeof(source), &source))
+            {
+                co_return false;
+            }
+            co_await scheduler.yield();
+            if (!co_await tx.read(to, sizeof(target), &target))
+            {
+                co_return false;
+            }
+            source--;
+            target++;
+            co_return tx.write(&source, sizeof(source), from) && tx.write(&target, sizeof(target), to);
+        });
+
+        bench_record_latency(thread, start);
+        thread->ops++;
+        thread->aborts += attempts - 1;
+    }
+}
+
+static void async_body(bench_thread_t *thread)
+{
+    AsyncWorkload *workload = (AsyncWorkload *)thread->arg;
+
+    tm_async::Scheduler scheduler;
+    for (size_t i = 0; i < workload->coroutines; i++)
+    {
+        scheduler.spawn(async_worker(scheduler, thread, workload));
+    }
+    scheduler.run();
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,4", 1.0);
+
+    AsyncWorkload workload;
+    workload.count = options.size ? options.size : 1024;
+    workload.shared = tm_create(workload.count * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "async: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.accounts = (uint64_t *)tm_start(workload.shared);
+
+    const size_t sweep[] = {1, 16, 256, 1024};
+    size_t sweeps = options.param ? 1 : sizeof(sweep) / sizeof(sweep[0]);
+
+    bench_header("coroutines\tlatency-mean-us\tlatency-max-us");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        for (size_t s = 0; s < sweeps; s++)
+        {
+            workload.coroutines = options.param ? options.param : sweep[s];
+            bench_result_t result = bench_run(options.threads[run], options.seconds, async_body, &workload);
+
+            char columns[96];
+            snprintf(columns, sizeof(columns), "%zu\t%.2f\t%.2f", workload.coroutines,
+                     result.ops ? (double)result.latency_sum / (double)result.ops / 1e3 : 0.0, (double)result.latency_max / 1e3);
+            bench_report("async", BENCH_VARIANT, options.threads[run], &result, columns);
+        }
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+/**
+ * @file   bench.h
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Minimal harness shared by the benchmarks of bench/ (C11 and C++): runs a workload on each thread count of a sweep
+ * for a fixed duration, and prints one tab-separated line per run: benchmark, variant (the flags of globals.h the
+ * library was built with, see bench/Makefile), threads, operations per second, then the columns of the benchmark.
+ *
+ *   bin/counter-default -t 1,2,4,8,16,32,64 -d 2
+ *
+ * bench_counter_open counts a hardware event over the threads of the runs (the benchmark must define _GNU_SOURCE).
+ * With BENCH_PERF_COUNTERS=1 in the environment, the hardware counters of the STM phases (tm_perf_counters, with a
+ * library built with PERF_COUNTERS, e.g. bin/counter-perf) are printed after the line of each run.
+ *
+ * Options: -t thread counts (comma-separated), -d seconds per run, -s size of the workload (meaning given by each
+ * benchmark, 0 for its default), -p parameter of the benchmark (idem).
+ **/
+
+#pragma once
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <tm.h>
+#include <tm_ext.h>
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#define BENCH_CACHE_ALIGNED alignas(64)
+#else
+#define BENCH_CACHE_ALIGNED _Alignas(64)
+#endif
+
+#define BENCH_MAX_RUNS 32
+#define BENCH_MAX_THREADS 1024
+
+/**
+ * @brief Options of a benchmark binary.
+ *
+ */
+typedef struct bench_options
+{
+    size_t threads[BENCH_MAX_RUNS]; // Thread counts of the sweep
+    size_t runs;
+    double seconds; // Duration of each run
+    size_t size;    // Size of the workload (0: default of the benchmark)
+    size_t param;   // Parameter of the benchmark (0: default of the benchmark)
+} bench_options_t;
+
+/**
+ * @brief State of a thread of a run, handed to the body of the benchmark. Aligned so that the counters of the threads
+ * never share a cache line.
+ *
+ */
+typedef struct bench_thread
+{
+    BENCH_CACHE_ALIGNED size_t id;
+    size_t threads;
+    void *arg;       // Argument of bench_run
+    uint64_t ops;    // Operations completed, counted by the body
+    uint64_t aborts; // Aborted attempts, counted by the body (reported as aborts per operation)
+    uint64_t seed;
+    uint64_t latency_sum; // Nanoseconds, summed by the bodies measuring the latency of their operations (see bench_now_ns)
+    uint64_t latency_max;
+    bool *stop;
+    pthread_barrier_t *barrier;
+    void (*body)(struct bench_thread *thread);
+} bench_thread_t;
+
+/**
+ * @brief Result of a run: the sums of the counters of its threads.
+ *
+ */
+typedef struct bench_result
+{
+    uint64_t ops;
+    uint64_t aborts;
+    uint64_t latency_sum;
+    uint64_t latency_max;
+    double seconds;
+    bool perf;                                      // Whether the run has hardware counters (see bench_perf_enabled)
+    tm_perf_counters_t perf_counters[tm_perf_phases]; // Counted during the run, by every thread
+} bench_result_t;
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Check whether the run is over (to be polled by the body, between its operations).
+ */
+static inline bool bench_stopped(bench_thread_t *thread)
+{
+    return __atomic_load_n(thread->stop, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Next pseudo-random number of a thread (xorshift64*).
+ */
+static inline uint64_t bench_rand(bench_thread_t *thread)
+{
+    thread->seed ^= thread->seed >> 12;
+    thread->seed ^= thread->seed << 25;
+    thread->seed ^= thread->seed >> 27;
+    return thread->seed * 0x2545f4914f6cdd1dull;
+}
+
+static inline void bench_record_latency(bench_thread_t *thread, uint64_t start)
+{
+    uint64_t latency = bench_now_ns() - start;
+    thread->latency_sum += latency;
+    if (latency > thread->latency_max)
+    {
+        thread->latency_max = latency;
+    }
+}
+
+/**
+ * @brief Parse the options of a benchmark binary, with the defaults of the benchmark. Exits on invalid options.
+ */
+static inline void bench_parse(int argc, char **argv, bench_options_t *options, const char *default_threads, double default_seconds)
+{
+    const char *threads = default_threads;
+    options->seconds = default_seconds;
+    options->size = 0;
+    options->param = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-t") == 0)
+        {
+            threads = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            options->seconds = atof(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            options->size = strtoull(argv[i + 1], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            options->param = strtoull(argv[i + 1], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-t threads,...] [-d seconds] [-s size] [-p param]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    options->runs = 0;
+    for (const char *p = threads; *p && options->runs < BENCH_MAX_RUNS;)
+    {
+        char *end;
+        size_t count = strtoull(p, &end, 10);
+        if (end == p || count == 0 || count > BENCH_MAX_THREADS)
+        {
+            fprintf(stderr, "%s: invalid thread counts '%s'\n", argv[0], threads);
+            exit(EXIT_FAILURE);
+        }
+        options->threads[options->runs++] = count;
+        p = (*end == ',') ? end + 1 : end;
+    }
+}
+
+/**
+ * @brief Check whether the hardware counters of the STM phases are requested (BENCH_PERF_COUNTERS set, and not 0).
+ */
+static inline bool bench_perf_enabled(void)
+{
+    const char *value = getenv("BENCH_PERF_COUNTERS");
+    return value && *value && strcmp(value, "0") != 0;
+}
+
+/**
+ * @brief Read the hardware counters of the STM phases of every thread, after a run (warns once if there are none).
+ */
+static inline bool bench_perf_read(tm_perf_counters_t *counters)
+{
+    static bool warned = false;
+    if (tm_perf_counters(counters))
+    {
+        return true;
+    }
+
+    if (!warned)
+    {
+        fprintf(stderr, "bench: BENCH_PERF_COUNTERS needs a library built with PERF_COUNTERS and readable counters\n");
+        warned = true;
+    }
+    return false;
+}
+
+static void *bench_thread_main(void *arg)
+{
+    bench_thread_t *thread = (bench_thread_t *)arg;
+    pthread_barrier_wait(thread->barrier);
+    thread->body(thread);
+    return NULL;
+}
+
+/**
+ * @brief Run a body on a number of threads for a duration (the threads start together, and stop at the first check of
+ * bench_stopped after the duration).
+ *
+ * @param threads The number of threads.
+ * @param seconds The duration.
+ * @param body The body, run once by each thread: it loops until bench_stopped, counting its operations.
+ * @param arg The argument of the body (thread->arg).
+ * @return bench_result_t The sums of the counters of the threads, and the measured duration.
+ */
+static inline bench_result_t bench_run(size_t threads, double seconds, void (*body)(bench_thread_t *thread), void *arg)
+{
+    bench_thread_t *states = (bench_thread_t *)aligned_alloc(64, threads * sizeof(bench_thread_t));
+    pthread_t *ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (!states || !ids)
+    {
+        fprintf(stderr, "bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The counters of tm_perf_counters are never reset: the run gets the difference (there are none before the first run)
+    tm_perf_counters_t perf_before[tm_perf_phases];
+    bool perf = bench_perf_enabled();
+    if (perf && !tm_perf_counters(perf_before))
+    {
+        memset(perf_before, 0, sizeof(perf_before));
+    }
+
+    bool stop = false;
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)threads + 1);
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        memset(&states[i], 0, sizeof(bench_thread_t));
+        states[i].id = i;
+        states[i].threads = threads;
+        states[i].arg = arg;
+        states[i].seed = 0x9e3779b97f4a7c15ull * (i + 1);
+        states[i].stop = &stop;
+        states[i].barrier = &barrier;
+        states[i].body = body;
+        if (pthread_create(&ids[i], NULL, bench_thread_main, &states[i]) != 0)
+        {
+            fprintf(stderr, "bench: cannot create thread %zu\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t start = bench_now_ns();
+    struct timespec duration = {(time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9)};
+    nanosleep(&duration, NULL);
+    __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    for (size_t i = 0; i < threads; i++)
+    {
+        pthread_join(ids[i], NULL);
+        result.ops += states[i].ops;
+        result.aborts += states[i].aborts;
+        result.latency_sum += states[i].latency_sum;
+        if (states[i].latency_max > result.latency_max)
+        {
+            result.latency_max = states[i].latency_max;
+        }
+    }
+    result.seconds = (double)(bench_now_ns() - start) / 1e9;
+
+    result.perf = perf && bench_perf_read(result.perf_counters);
+    for (size_t phase = 0; result.perf && phase < tm_perf_phases; phase++)
+    {
+        result.perf_counters[phase].calls -= perf_before[phase].calls;
+        for (size_t event = 0; event < tm_perf_events; event++)
+        {
+            result.perf_counters[phase].counts[event] -= perf_before[phase].counts[event];
+        }
+    }
+
+    pthread_barrier_destroy(&barrier);
+    free(ids);
+    free(states);
+
+    return result;
+}
+
+/**
+ * @brief Open a hardware counter (user space only) of the calling thread and of the threads it creates afterwards,
+ * e.g. before bench_run: the counts of the threads are added to it when they exit.
+ *
+ * @param type The perf event type (PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE...).
+ * @param config The perf event config.
+ * @return int The counter, -1 if the kernel or the CPU does not provide it.
+ */
+static inline int bench_counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * @brief Read a counter opened by bench_counter_open (0 if it is not opened).
+ */
+static inline uint64_t bench_counter_read(int counter)
+{
+    uint64_t count = 0;
+    if (counter < 0 || read(counter, &count, sizeof(count)) != (ssize_t)sizeof(count))
+    {
+        return 0;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Print the header of the output (once per binary), with the columns of the benchmark.
+ */
+static inline void bench_header(const char *columns)
+{
+    printf("benchmark\tvariant\tthreads\tops/s\taborts/op%s%s\n", columns && *columns ? "\t" : "", columns ? columns : "");
+}
+
+/**
+ * @brief Print the line of a run, with the (tab-separated) columns of the benchmark, then its hardware counters if any.
+ */
+static inline void bench_report(const char *benchmark, const char *variant, size_t threads, bench_result_t const *result, const char *columns)
+{
+    double ops = result->ops ? (double)result->ops : 1.0;
+    printf("%s\t%s\t%zu\t%.0f\t%.4f%s%s\n", benchmark, variant, threads, (double)result->ops / result->seconds,
+           (double)result->aborts / ops, columns && *columns ? "\t" : "", columns ? columns : "");
+    if (result->perf)
+    {
+        tm_perf_print(result->perf_counters);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Variant of the library the benchmark is linked with (set by bench/Makefile).
+ */
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT "default"
+#endif
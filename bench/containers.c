@@ -0,0 +1,436 @@
+/**
+ * @file   containers.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Scalability of the transactional containers against sequential structures behind a mutex: a FIFO queue (each
+ * thread alternates enqueues and dequeues, on a queue prefilled with -s values, 1024 by default), and maps of -s keys
+ * (50% lookups, 25% inserts and 25% removes): the hash map, the skip list and the B+-tree. Each operation is one txn on
+ * the tm_queue.h / tm_hashmap.h / tm_skiplist.h / tm_bptree.h containers, or one critical section on the mutex
+ * variants: a malloc'd linked list, a chained hash table, and a sorted array for the ordered maps.
+ *
+ *   bin/containers-default -t 1,2,4,8
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_bptree.h>
+#include <tm_hashmap.h>
+#include <tm_queue.h>
+#include <tm_skiplist.h>
+
+#include "bench.h"
+
+#define CONTAINERS_MUTEX_BUCKETS 4096
+
+typedef struct mutex_node
+{
+    struct mutex_node *next;
+    uint64_t key;
+    uint64_t value;
+} mutex_node_t;
+
+/**
+ * @brief Operations of a transactional map (the handles of the maps are all pointers in the region).
+ *
+ */
+typedef struct containers_tm_map
+{
+    void *map;
+    bool (*get)(shared_t shared, tx_t tx, void *map, tm_ds_word_t key, tm_ds_word_t *value, bool *found);
+    alloc_t (*put)(shared_t shared, tx_t tx, void *map, tm_ds_word_t key, tm_ds_word_t value);
+    bool (*remove)(shared_t shared, tx_t tx, void *map, tm_ds_word_t key, bool *removed);
+} containers_tm_map_t;
+
+typedef struct containers_workload
+{
+    shared_t shared;
+    tm_queue_t queue;
+    containers_tm_map_t hashmap;
+    containers_tm_map_t skiplist;
+    containers_tm_map_t bptree;
+    containers_tm_map_t *map; // Map of the current run
+    size_t keys;
+
+    pthread_mutex_t mutex;
+    mutex_node_t *queue_head; // Mutex queue: dequeued at the head, enqueued at the tail
+    mutex_node_t *queue_tail;
+    mutex_node_t *buckets[CONTAINERS_MUTEX_BUCKETS];
+    uint64_t *sorted_keys; // Mutex ordered map: keys in increasing order, and their values
+    uint64_t *sorted_values;
+    size_t sorted_count;
+} containers_workload_t;
+
+/*
+    =======
+    Transactional containers
+    =======
+*/
+
+static void containers_tm_queue_body(bench_thread_t *thread)
+{
+    containers_workload_t *workload = (containers_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        bool is_enqueue = (thread->ops % 2) == 0;
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        bool found;
+        tm_ds_word_t value = thread->ops;
+        bool ok = is_enqueue ? tm_queue_enqueue(workload->shared, tx, workload->queue, value) == success_alloc
+                             : tm_queue_dequeue(workload->shared, tx, workload->queue, &value, &found);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+static void containers_tm_map_body(bench_thread_t *thread)
+{
+    containers_workload_t *workload = (containers_workload_t *)thread->arg;
+    containers_tm_map_t *map = workload->map;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t r = bench_rand(thread);
+        tm_ds_word_t key = (r >> 8) % workload->keys;
+        tx_t tx = tm_begin(workload->shared, (r & 3) < 2);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        bool ok, found;
+        tm_ds_word_t value;
+        switch (r & 3)
+        {
+        case 2:
+            ok = map->put(workload->shared, tx, map->map, key, key) == success_alloc;
+            break;
+        case 3:
+            ok = map->remove(workload->shared, tx, map->map, key, &found);
+            break;
+        default:
+            ok = map->get(workload->shared, tx, map->map, key, &value, &found);
+            break;
+        }
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+/*
+    =======
+    Mutex-protected structures
+    =======
+*/
+
+static void containers_mutex_enqueue(containers_workload_t *workload, mutex_node_t *node)
+{
+    node->next = NULL;
+    if (workload->queue_tail)
+    {
+        workload->queue_tail->next = node;
+    }
+    else
+    {
+        workload->queue_head = node;
+    }
+    workload->queue_tail = node;
+}
+
+static void containers_mutex_queue_body(bench_thread_t *thread)
+{
+    containers_workload_t *workload = (containers_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        if ((thread->ops % 2) == 0)
+        {
+            mutex_node_t *node = (mutex_node_t *)malloc(sizeof(mutex_node_t));
+            node->value = thread->ops;
+
+            pthread_mutex_lock(&workload->mutex);
+            containers_mutex_enqueue(workload, node);
+            pthread_mutex_unlock(&workload->mutex);
+        }
+        else
+        {
+            pthread_mutex_lock(&workload->mutex);
+            mutex_node_t *node = workload->queue_head;
+            if (node)
+            {
+                workload->queue_head = node->next;
+                workload->queue_tail = node->next ? workload->queue_tail : NULL;
+            }
+            pthread_mutex_unlock(&workload->mutex);
+
+            free(node);
+        }
+        thread->ops++;
+    }
+}
+
+static void containers_mutex_hashmap_body(bench_thread_t *thread)
+{
+    containers_workload_t *workload = (containers_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t r = bench_rand(thread);
+        uint64_t key = (r >> 8) % workload->keys;
+        mutex_node_t **bucket = &workload->buckets[tm_ds_hash(key) % CONTAINERS_MUTEX_BUCKETS];
+        mutex_node_t *spare = (r & 3) == 2 ? (mutex_node_t *)malloc(sizeof(mutex_node_t)) : NULL;
+
+        pthread_mutex_lock(&workload->mutex);
+        mutex_node_t **link = bucket;
+        while (*link && (*link)->key != key)
+        {
+            link = &(*link)->next;
+        }
+
+        mutex_node_t *removed = NULL;
+        if ((r & 3) == 2 && *link)
+        {
+            (*link)->value = key;
+        }
+        else if ((r & 3) == 2)
+        {
+            spare->next = NULL;
+            spare->key = key;
+            spare->value = key;
+            *link = spare;
+            spare = NULL;
+        }
+        else if ((r & 3) == 3 && *link)
+        {
+            removed = *link;
+            *link = removed->next;
+        }
+        pthread_mutex_unlock(&workload->mutex);
+
+        free(spare);
+        free(removed);
+        thread->ops++;
+    }
+}
+
+/**
+ * @brief Find the position of a key in the sorted array (or where it would be inserted).
+ */
+static size_t containers_mutex_sorted_find(containers_workload_t *workload, uint64_t key)
+{
+    size_t low = 0, high = workload->sorted_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (workload->sorted_keys[mid] < key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static void containers_mutex_sorted_body(bench_thread_t *thread)
+{
+    containers_workload_t *workload = (containers_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t r = bench_rand(thread);
+        uint64_t key = (r >> 8) % workload->keys;
+
+        pthread_mutex_lock(&workload->mutex);
+        size_t i = containers_mutex_sorted_find(workload, key);
+        bool found = i < workload->sorted_count && workload->sorted_keys[i] == key;
+        size_t tail = workload->sorted_count - i;
+        if ((r & 3) == 2 && found)
+        {
+            workload->sorted_values[i] = key;
+        }
+        else if ((r & 3) == 2)
+        {
+            // The array has room for every key
+            memmove(&workload->sorted_keys[i + 1], &workload->sorted_keys[i], tail * sizeof(uint64_t));
+            memmove(&workload->sorted_values[i + 1], &workload->sorted_values[i], tail * sizeof(uint64_t));
+            workload->sorted_keys[i] = key;
+            workload->sorted_values[i] = key;
+            workload->sorted_count++;
+        }
+        else if ((r & 3) == 3 && found)
+        {
+            memmove(&workload->sorted_keys[i], &workload->sorted_keys[i + 1], (tail - 1) * sizeof(uint64_t));
+            memmove(&workload->sorted_values[i], &workload->sorted_values[i + 1], (tail - 1) * sizeof(uint64_t));
+            workload->sorted_count--;
+        }
+        pthread_mutex_unlock(&workload->mutex);
+
+        thread->ops++;
+    }
+}
+
+/*
+    =======
+    Setup
+    =======
+*/
+
+static bool containers_setup(containers_workload_t *workload)
+{
+    workload->hashmap = (containers_tm_map_t){NULL, tm_hashmap_get, tm_hashmap_put, tm_hashmap_remove};
+    workload->skiplist = (containers_tm_map_t){NULL, tm_skiplist_get, tm_skiplist_put, tm_skiplist_remove};
+    workload->bptree = (containers_tm_map_t){NULL, tm_bptree_get, tm_bptree_put, tm_bptree_remove};
+    containers_tm_map_t *maps[] = {&workload->hashmap, &workload->skiplist, &workload->bptree};
+
+    workload->sorted_keys = (uint64_t *)malloc(workload->keys * sizeof(uint64_t));
+    workload->sorted_values = (uint64_t *)malloc(workload->keys * sizeof(uint64_t));
+    workload->sorted_count = 0;
+    if (!workload->sorted_keys || !workload->sorted_values)
+    {
+        return false;
+    }
+
+    tx_t tx = tm_begin(workload->shared, false);
+    if (tx == invalid_tx || tm_queue_create(workload->shared, tx, &workload->queue) != success_alloc ||
+        tm_hashmap_create(workload->shared, tx, workload->keys, &workload->hashmap.map) != success_alloc ||
+        tm_skiplist_create(workload->shared, tx, &workload->skiplist.map) != success_alloc ||
+        tm_bptree_create(workload->shared, tx, &workload->bptree.map) != success_alloc)
+    {
+        return false;
+    }
+
+    // Prefill: the queue with -s values, the maps with half of the keys
+    for (size_t i = 0; i < workload->keys; i++)
+    {
+        if (tm_queue_enqueue(workload->shared, tx, workload->queue, i) != success_alloc)
+        {
+            return false;
+        }
+        for (size_t m = 0; i % 2 == 0 && m < sizeof(maps) / sizeof(maps[0]); m++)
+        {
+            if (maps[m]->put(workload->shared, tx, maps[m]->map, i, i) != success_alloc)
+            {
+                return false;
+            }
+        }
+
+        mutex_node_t *node = (mutex_node_t *)malloc(sizeof(mutex_node_t));
+        node->value = i;
+        containers_mutex_enqueue(workload, node);
+
+        if (i % 2 == 0)
+        {
+            mutex_node_t **bucket = &workload->buckets[tm_ds_hash(i) % CONTAINERS_MUTEX_BUCKETS];
+            node = (mutex_node_t *)malloc(sizeof(mutex_node_t));
+            node->next = *bucket;
+            node->key = i;
+            node->value = i;
+            *bucket = node;
+
+            workload->sorted_keys[workload->sorted_count] = i;
+            workload->sorted_values[workload->sorted_count++] = i;
+        }
+    }
+
+    return tm_end(workload->shared, tx);
+}
+
+static void containers_teardown(containers_workload_t *workload)
+{
+    while (workload->queue_head)
+    {
+        mutex_node_t *next = workload->queue_head->next;
+        free(workload->queue_head);
+        workload->queue_head = next;
+    }
+
+    for (size_t i = 0; i < CONTAINERS_MUTEX_BUCKETS; i++)
+    {
+        while (workload->buckets[i])
+        {
+            mutex_node_t *next = workload->buckets[i]->next;
+            free(workload->buckets[i]);
+            workload->buckets[i] = next;
+        }
+    }
+
+    free(workload->sorted_keys);
+    free(workload->sorted_values);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4,8", 1.0);
+
+    static containers_workload_t workload;
+    workload.keys = options.size ? options.size : 1024;
+    workload.shared = tm_create(sizeof(tm_ds_word_t), sizeof(tm_ds_word_t));
+    pthread_mutex_init(&workload.mutex, NULL);
+    if (workload.shared == invalid_shared || !containers_setup(&workload))
+    {
+        fprintf(stderr, "containers: setup failed\n");
+        return EXIT_FAILURE;
+    }
+
+    const struct
+    {
+        const char *container;
+        const char *sync;
+        void (*body)(bench_thread_t *thread);
+        containers_tm_map_t *map;
+    } configs[] = {
+        {"queue", "tm", containers_tm_queue_body, NULL},
+        {"queue", "mutex", containers_mutex_queue_body, NULL},
+        {"hashmap", "tm", containers_tm_map_body, &workload.hashmap},
+        {"hashmap", "mutex", containers_mutex_hashmap_body, NULL},
+        {"skiplist", "tm", containers_tm_map_body, &workload.skiplist},
+        {"bptree", "tm", containers_tm_map_body, &workload.bptree},
+        {"sorted-array", "mutex", containers_mutex_sorted_body, NULL},
+    };
+
+    bench_header("container\tsync");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+        {
+            workload.map = configs[c].map;
+            bench_result_t result = bench_run(options.threads[run], options.seconds, configs[c].body, &workload);
+
+            char columns[64];
+            snprintf(columns, sizeof(columns), "%s\t%s", configs[c].container, configs[c].sync);
+            bench_report("containers", BENCH_VARIANT, options.threads[run], &result, columns);
+        }
+    }
+
+    containers_teardown(&workload);
+    pthread_mutex_destroy(&workload.mutex);
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file   contexts.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Thread contexts: the same transfers between two random accounts out of -s accounts (1024 by default) are run by
+ * threads that do not register in the region (none: each txn allocates its descriptor and its sets), then by threads
+ * that register with tm_thread_enter (context: the txns reuse the descriptor and the sets of the thread). Each run
+ * reports the mallocs per committed txn (counted by the malloc of this binary, which wraps the one of glibc) and the
+ * mean and max latency of a txn, from tm_begin to the end of its commit.
+ *
+ *   bin/contexts-default -t 1,4
+ **/
+
+#define _GNU_SOURCE
+
+#include <stdatomic.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+extern void *__libc_malloc(size_t size);
+
+static _Thread_local uint64_t contexts_mallocs; // Calls to malloc of the calling thread
+
+/**
+ * @brief Count the calls of the thread, including the ones of the library (linked in this binary).
+ */
+void *malloc(size_t size)
+{
+    contexts_mallocs++;
+    return __libc_malloc(size);
+}
+
+typedef struct contexts_workload
+{
+    shared_t shared;
+    uint64_t *accounts;
+    size_t count;
+    bool enter;               // Whether the threads register with tm_thread_enter
+    _Atomic uint64_t mallocs; // Calls to malloc during the txns of the run
+} contexts_workload_t;
+
+static void contexts_body(bench_thread_t *thread)
+{
+    contexts_workload_t *workload = (contexts_workload_t *)thread->arg;
+    if (workload->enter && !tm_thread_enter(workload->shared))
+    {
+        fprintf(stderr, "contexts: tm_thread_enter failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t mallocs = 0;
+    while (!bench_stopped(thread))
+    {
+        uint64_t *from = &workload->accounts[bench_rand(thread) % workload->count];
+        uint64_t *to = &workload->accounts[bench_rand(thread) % workload->count];
+        if (from == to)
+        {
+            continue;
+        }
+
+        uint64_t before = contexts_mallocs;
+        uint64_t start = bench_now_ns();
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t source, target;
+        bool ok = tm_read(workload->shared, tx, from, sizeof(source), &source) &&
+                  tm_read(workload->shared, tx, to, sizeof(target), &target);
+        source--;
+        target++;
+        ok = ok && tm_write(workload->shared, tx, &source, sizeof(source), from) &&
+             tm_write(workload->shared, tx, &target, sizeof(target), to);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            bench_record_latency(thread, start);
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+        mallocs += contexts_mallocs - before;
+    }
+
+    if (workload->enter)
+    {
+        tm_thread_exit(workload->shared);
+    }
+    atomic_fetch_add_explicit(&workload->mallocs, mallocs, memory_order_relaxed);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4", 1.0);
+
+    static contexts_workload_t workload;
+    workload.count = options.size ? options.size : 1024;
+    workload.shared = tm_create(workload.count * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "contexts: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.accounts = (uint64_t *)tm_start(workload.shared);
+
+    bench_header("contexts\tmallocs/op\tlatency-mean-ns\tlatency-max-ns");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        for (int enter = 0; enter < 2; enter++)
+        {
+            workload.enter = enter;
+            atomic_store(&workload.mallocs, 0);
+            bench_result_t result = bench_run(options.threads[run], options.seconds, contexts_body, &workload);
+
+            double ops = result.ops ? (double)result.ops : 1.0;
+            char columns[128];
+            snprintf(columns, sizeof(columns), "%s\t%.3f\t%.0f\t%lu", enter ? "context" : "none",
+                     (double)atomic_load(&workload.mallocs) / ops, (double)result.latency_sum / ops, result.latency_max);
+            bench_report("contexts", BENCH_VARIANT, options.threads[run], &result, columns);
+        }
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
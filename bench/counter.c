@@ -0,0 +1,83 @@
+/**
+ * @file   counter.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Counter workload: each txn increments a counter, either a counter of its own thread (-p 0, the default: the txns
+ * never conflict, so the scaling only depends on the lines shared by the threads, i.e. the clock, the read-mostly
+ * fields of region_t and the txn descriptors) or one counter shared by all the threads (-p 1).
+ *
+ * The library is built without the padding of region_t, the clock and the txn descriptors (counter-unpadded, with
+ * -DPAD_HOT_FIELDS=false) and with it (counter-padded, the default), e.g.
+ *
+ *   bin/counter-unpadded -t 1,8,32,64 && bin/counter-padded -t 1,8,32,64
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+
+#include "bench.h"
+
+typedef struct counter_workload
+{
+    shared_t shared;
+    uint64_t *counters; // One per thread, in consecutive words
+    bool is_shared;     // All the threads increment counters[0]
+} counter_workload_t;
+
+static void counter_body(bench_thread_t *thread)
+{
+    counter_workload_t *workload = (counter_workload_t *)thread->arg;
+    uint64_t *counter = &workload->counters[workload->is_shared ? 0 : thread->id];
+
+    while (!bench_stopped(thread))
+    {
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t value;
+        bool ok = tm_read(workload->shared, tx, counter, sizeof(value), &value);
+        value++;
+        ok = ok && tm_write(workload->shared, tx, &value, sizeof(value), counter);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4,8,16,32,64", 1.0);
+
+    counter_workload_t workload;
+    workload.shared = tm_create(BENCH_MAX_THREADS * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "counter: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.counters = (uint64_t *)tm_start(workload.shared);
+    workload.is_shared = options.param != 0;
+
+    bench_header("counters");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, counter_body, &workload);
+        bench_report("counter", BENCH_VARIANT, options.threads[run], &result, workload.is_shared ? "shared" : "per-thread");
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
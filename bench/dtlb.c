@@ -0,0 +1,111 @@
+/**
+ * @file   dtlb.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * dTLB misses of random accesses to a large region: read-only txns reading random words (with a write txn every
+ * -p txns), so that the words and their stripes of the lock table are spread over the whole region and the table.
+ * The misses of the worker threads are counted with a hardware counter (dTLB read misses) over each run, per read:
+ * compare the 4k variant with the huge variant (USE_HUGE_PAGES). The counter is not read inside the txns, as the
+ * PERF_COUNTERS phases do: with page-table isolation, each read() of a counter flushes the TLB.
+ *
+ *   bin/dtlb-4k -s 1024 && bin/dtlb-huge -s 1024  # 1 GiB first segment
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define DTLB_READS 8
+
+typedef struct dtlb_workload
+{
+    shared_t shared;
+    uint64_t *words;
+    size_t count;       // Words of the first segment
+    size_t write_every; // A write txn every write_every txns
+} dtlb_workload_t;
+
+static void dtlb_body(bench_thread_t *thread)
+{
+    dtlb_workload_t *workload = (dtlb_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        bool is_ro = (thread->ops % workload->write_every) != 0;
+        tx_t tx = tm_begin(workload->shared, is_ro);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        bool ok = true;
+        uint64_t sum = 0;
+        for (int i = 0; ok && i < DTLB_READS; i++)
+        {
+            uint64_t value;
+            ok = tm_read(workload->shared, tx, &workload->words[bench_rand(thread) % workload->count], sizeof(value), &value);
+            sum += value;
+        }
+        if (ok && !is_ro)
+        {
+            ok = tm_write(workload->shared, tx, &sum, sizeof(sum), &workload->words[bench_rand(thread) % workload->count]);
+        }
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,4", 2.0);
+
+    size_t size = (options.size ? options.size : 512) << 20;
+    dtlb_workload_t workload;
+    workload.shared = tm_create(size, sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "dtlb: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.words = (uint64_t *)tm_start(workload.shared);
+    workload.count = size / sizeof(uint64_t);
+    workload.write_every = options.param ? options.param : 10;
+
+    bench_header("dtlb-misses/read\tcycles/read");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        int misses = bench_counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        int cycles = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+
+        bench_result_t result = bench_run(options.threads[run], options.seconds, dtlb_body, &workload);
+
+        double reads = (double)(result.ops + result.aborts) * DTLB_READS;
+        reads = reads > 0 ? reads : 1.0;
+        char columns[64] = "n/a\tn/a";
+        if (misses >= 0 && cycles >= 0)
+        {
+            snprintf(columns, sizeof(columns), "%.3f\t%.1f", (double)bench_counter_read(misses) / reads, (double)bench_counter_read(cycles) / reads);
+        }
+        bench_report("dtlb", BENCH_VARIANT, options.threads[run], &result, columns);
+
+        close(misses);
+        close(cycles);
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
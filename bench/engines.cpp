@@ -0,0 +1,119 @@
+/**
+ * @file   engines.cpp
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Policies of the C++ engine (stm.hpp): the same transfers between two random accounts out of -s accounts (1024 by
+ * default, fewer for more conflicts) run on several instantiations of stm::Stm, through the same templated driver.
+ * The baseline has the policies of tm.c, and every other instantiation changes one of them.
+ *
+ *   bin/engines-default -t 1,4 -s 64
+ **/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stm.hpp>
+
+#include "bench.h"
+
+using Baseline = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::AbortOnConflict, stm::LazyLocking>;
+using PassOnFailure = stm::Stm<stm::PassOnFailureClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::AbortOnConflict, stm::LazyLocking>;
+using Hashed = stm::Stm<stm::GlobalClock, stm::HashedLockMap<20, 3>, stm::ArraySets, stm::AbortOnConflict, stm::LazyLocking>;
+using Lists = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ListSets, stm::AbortOnConflict, stm::LazyLocking>;
+using Spin = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::SpinThenAbort<64>, stm::LazyLocking>;
+using Backoff = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::BackoffOnAbort<10>, stm::LazyLocking>;
+using Eager = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::AbortOnConflict, stm::EagerLocking>;
+
+template <class Engine>
+struct EnginesWorkload
+{
+    Engine *engine;
+    uint64_t *accounts;
+    size_t count;
+};
+
+template <class Engine>
+static void engines_body(bench_thread_t *thread)
+{
+    EnginesWorkload<Engine> *workload = (EnginesWorkload<Engine> *)thread->arg;
+    Engine *engine = workload->engine;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t *from = &workload->accounts[bench_rand(thread) % workload->count];
+        uint64_t *to = &workload->accounts[bench_rand(thread) % workload->count];
+        if (from == to)
+        {
+            continue;
+        }
+
+        typename Engine::Tx *tx = engine->begin(false);
+        if (!tx)
+        {
+            continue;
+        }
+
+        // A failed read, write or end has destroyed the txn
+        uint64_t source, target;
+        bool ok = engine->read(tx, from, sizeof(source), &source) && engine->read(tx, to, sizeof(target), &target);
+        source--;
+        target++;
+        ok = ok && engine->write(tx, &source, sizeof(source), from) && engine->write(tx, &target, sizeof(target), to) && engine->end(tx);
+
+        if (ok)
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+/**
+ * @brief Run the sweep of thread counts on a fresh region of an instantiation.
+ */
+template <class Engine>
+static bool engines_run(const char *name, bench_options_t const &options, size_t count)
+{
+    EnginesWorkload<Engine> workload;
+    workload.engine = Engine::create(count * sizeof(uint64_t), sizeof(uint64_t));
+    if (!workload.engine)
+    {
+        fprintf(stderr, "engines: %s: create failed\n", name);
+        return false;
+    }
+    workload.accounts = (uint64_t *)workload.engine->start();
+    workload.count = count;
+
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, engines_body<Engine>, &workload);
+        bench_report("engines", BENCH_VARIANT, options.threads[run], &result, name);
+    }
+
+    delete workload.engine;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4", 1.0);
+    size_t count = options.size ? options.size : 1024;
+
+    bench_header("policies");
+    bool ok = engines_run<Baseline>("baseline", options, count) &&
+              engines_run<PassOnFailure>("pass-on-failure-clock", options, count) &&
+              engines_run<Hashed>("hashed-lock-map", options, count) &&
+              engines_run<Lists>("list-sets", options, count) &&
+              engines_run<Spin>("spin-then-abort", options, count) &&
+              engines_run<Backoff>("backoff-on-abort", options, count) &&
+              engines_run<Eager>("eager-locking", options, count);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file   inline.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Cost of the calls to the library: each txn reads -p random words (16 by default) of a region of -s words (1 << 20 by
+ * default) and writes one word of its thread, through tm_read/tm_write (call) or through the fast paths of
+ * tm_inline.h (inline). The benchmark is linked with the shared library (inline-shared, every call through the PLT),
+ * the static library (inline-default) and the static library built with -flto (inline-lto, the library is optimized
+ * with the benchmark at link time).
+ *
+ *   bin/inline-shared -t 1 && bin/inline-default -t 1 && bin/inline-lto -t 1
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_inline.h>
+
+#include "bench.h"
+
+#define INLINE_SLOT_WORDS 8 // Words of the slot of a thread (a cache line)
+
+typedef struct inline_workload
+{
+    shared_t shared;
+    uint64_t *words;
+    size_t count;
+    uint64_t *slots; // Written words, one cache line per thread
+    size_t reads;    // Reads per txn
+} inline_workload_t;
+
+/**
+ * @brief Run the txns of a thread (inlined in both bodies, with the path as a constant).
+ */
+static inline void inline_run(bench_thread_t *thread, bool is_inline)
+{
+    inline_workload_t *workload = (inline_workload_t *)thread->arg;
+    shared_t shared = workload->shared;
+    uint64_t *slot = &workload->slots[thread->id * INLINE_SLOT_WORDS];
+
+    while (!bench_stopped(thread))
+    {
+        tx_t tx = tm_begin(shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        // A failed read or write has destroyed the txn
+        bool ok = true;
+        uint64_t sum = 0;
+        for (size_t i = 0; ok && i < workload->reads; i++)
+        {
+            uint64_t value;
+            uint64_t *word = &workload->words[bench_rand(thread) % workload->count];
+            ok = is_inline ? tm_read_inline(shared, tx, word, sizeof(value), &value) : tm_read(shared, tx, word, sizeof(value), &value);
+            sum += value;
+        }
+        ok = ok && (is_inline ? tm_write_inline(shared, tx, &sum, sizeof(sum), slot) : tm_write(shared, tx, &sum, sizeof(sum), slot));
+
+        if (ok && tm_end(shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+static void inline_call_body(bench_thread_t *thread)
+{
+    inline_run(thread, false);
+}
+
+static void inline_inline_body(bench_thread_t *thread)
+{
+    inline_run(thread, true);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4", 1.0);
+
+    inline_workload_t workload;
+    workload.count = options.size ? options.size : 1 << 20;
+    workload.reads = options.param ? options.param : 16;
+    workload.shared = tm_create(workload.count * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "inline: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.words = (uint64_t *)tm_start(workload.shared);
+
+    void *slots;
+    tx_t tx = tm_begin(workload.shared, false);
+    if (tx == invalid_tx || tm_alloc(workload.shared, tx, BENCH_MAX_THREADS * INLINE_SLOT_WORDS * sizeof(uint64_t), &slots) != success_alloc ||
+        !tm_end(workload.shared, tx))
+    {
+        fprintf(stderr, "inline: tm_alloc failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.slots = (uint64_t *)slots;
+
+    bench_header("path");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, inline_call_body, &workload);
+        bench_report("inline", BENCH_VARIANT, options.threads[run], &result, "call");
+
+        result = bench_run(options.threads[run], options.seconds, inline_inline_body, &workload);
+        bench_report("inline", BENCH_VARIANT, options.threads[run], &result, "inline");
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
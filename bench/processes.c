@@ -0,0 +1,210 @@
+/**
+ * @file   processes.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Processes against threads on a region shared by processes (tm_create_shared): the same transfers between two
+ * random accounts out of -s accounts (1024 by default) are run by N threads of one process, then by N processes of
+ * one thread each (this binary, run again in child mode, attached with tm_attach_shared). The difference is the cost
+ * of running in separate processes: the clock and the lock table are the same, only the caches, the TLBs and the
+ * scheduling differ.
+ *
+ *   bin/processes-default -t 1,2,4,8
+ **/
+
+#define _GNU_SOURCE
+
+#include <sys/wait.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+typedef struct processes_workload
+{
+    shared_t shared;
+    uint64_t *accounts;
+    size_t count;
+    uint64_t salt; // Added to the seeds of the threads, so that the child processes differ
+} processes_workload_t;
+
+static void processes_body(bench_thread_t *thread)
+{
+    processes_workload_t *workload = (processes_workload_t *)thread->arg;
+    thread->seed += workload->salt << 32;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t *from = &workload->accounts[bench_rand(thread) % workload->count];
+        uint64_t *to = &workload->accounts[bench_rand(thread) % workload->count];
+        if (from == to)
+        {
+            continue;
+        }
+
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t source, target;
+        bool ok = tm_read(workload->shared, tx, from, sizeof(source), &source) &&
+                  tm_read(workload->shared, tx, to, sizeof(target), &target);
+        source--;
+        target++;
+        ok = ok && tm_write(workload->shared, tx, &source, sizeof(source), from) &&
+             tm_write(workload->shared, tx, &target, sizeof(target), to);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+/**
+ * @brief Child mode: attach to the region, wait for the start (the end of the start pipe), run one thread for the
+ * duration, and write the result to the result pipe.
+ */
+static int processes_child(char **argv)
+{
+    processes_workload_t workload;
+    workload.shared = tm_attach_shared(argv[2]);
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "processes: tm_attach_shared(%s) failed\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    workload.accounts = (uint64_t *)tm_start(workload.shared);
+    workload.count = tm_size(workload.shared) / sizeof(uint64_t);
+    workload.salt = strtoull(argv[6], NULL, 10) + 1;
+
+    int start = atoi(argv[3]);
+    int results = atoi(argv[4]);
+    char byte;
+    while (read(start, &byte, 1) > 0)
+    {
+    }
+
+    bench_result_t result = bench_run(1, atof(argv[5]), processes_body, &workload);
+    bool written = write(results, &result, sizeof(result)) == (ssize_t)sizeof(result);
+
+    tm_destroy(workload.shared);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Run the transfers in a number of child processes, started together.
+ *
+ * @return bench_result_t The sums of the counters of the processes, and the longest duration.
+ */
+static bench_result_t processes_run(const char *name, size_t processes, double seconds)
+{
+    int start[2], results[2];
+    if (pipe(start) != 0 || pipe(results) != 0)
+    {
+        fprintf(stderr, "processes: pipe failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char start_fd[16], results_fd[16], duration[32];
+    snprintf(start_fd, sizeof(start_fd), "%d", start[0]);
+    snprintf(results_fd, sizeof(results_fd), "%d", results[1]);
+    snprintf(duration, sizeof(duration), "%f", seconds);
+
+    pid_t *pids = (pid_t *)malloc(processes * sizeof(pid_t));
+    for (size_t i = 0; i < processes; i++)
+    {
+        char index[24];
+        snprintf(index, sizeof(index), "%zu", i);
+
+        pids[i] = fork();
+        if (pids[i] == 0)
+        {
+            close(start[1]);
+            close(results[0]);
+            execl("/proc/self/exe", "processes", "--child", name, start_fd, results_fd, duration, index, (char *)NULL);
+            _exit(EXIT_FAILURE);
+        }
+        if (pids[i] < 0)
+        {
+            fprintf(stderr, "processes: fork failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The children start when the start pipe is closed by its last writer
+    close(start[0]);
+    close(results[1]);
+    close(start[1]);
+
+    bench_result_t total;
+    memset(&total, 0, sizeof(total));
+    bench_result_t result;
+    while (read(results[0], &result, sizeof(result)) == (ssize_t)sizeof(result))
+    {
+        total.ops += result.ops;
+        total.aborts += result.aborts;
+        total.seconds = result.seconds > total.seconds ? result.seconds : total.seconds;
+    }
+    close(results[0]);
+
+    for (size_t i = 0; i < processes; i++)
+    {
+        int status;
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "processes: child %zu failed\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(pids);
+
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 7 && strcmp(argv[1], "--child") == 0)
+    {
+        return processes_child(argv);
+    }
+
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4,8", 1.0);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/tm-bench-processes-%d", (int)getpid());
+
+    processes_workload_t workload;
+    workload.count = options.size ? options.size : 1024;
+    workload.shared = tm_create_shared(name, workload.count * sizeof(uint64_t), sizeof(uint64_t), 1 << 20);
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "processes: tm_create_shared failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.accounts = (uint64_t *)tm_start(workload.shared);
+    workload.salt = 0;
+
+    bench_header("mode");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, processes_body, &workload);
+        bench_report("processes", BENCH_VARIANT, options.threads[run], &result, "threads");
+
+        result = processes_run(name, options.threads[run], options.seconds);
+        bench_report("processes", BENCH_VARIANT, options.threads[run], &result, "processes");
+    }
+
+    tm_destroy(workload.shared);
+    tm_unlink_shared(name);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file   records.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Record workload on a segment of tm_alloc_objects: -s records (1024 by default) of RECORDS_FIELDS words, accessed
+ * in two ways:
+ *   - record: each txn reads a whole random record and updates one of its fields. With object locks (records-objects),
+ *     the record is one stripe of the read and write sets instead of RECORDS_FIELDS, and is validated once.
+ *   - field: each thread reads and updates its own field (the thread id modulo RECORDS_FIELDS) of random records. The
+ *     fields never conflict with one lock per word (records-default), but the threads of different fields of a record
+ *     conflict with object locks: the aborts per operation are the false conflicts of the coarser locks.
+ *
+ *   bin/records-default -t 1,2,4,8 && bin/records-objects -t 1,2,4,8
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define RECORDS_FIELDS 8
+
+typedef struct records_workload
+{
+    shared_t shared;
+    uint64_t *records; // RECORDS_FIELDS words per record
+    size_t count;
+} records_workload_t;
+
+static void records_record_body(bench_thread_t *thread)
+{
+    records_workload_t *workload = (records_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t r = bench_rand(thread);
+        uint64_t *record = &workload->records[(r >> 8) % workload->count * RECORDS_FIELDS];
+        size_t field = r % RECORDS_FIELDS;
+
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t values[RECORDS_FIELDS];
+        bool ok = tm_read(workload->shared, tx, record, sizeof(values), values);
+        values[field]++;
+        ok = ok && tm_write(workload->shared, tx, &values[field], sizeof(uint64_t), &record[field]);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+static void records_field_body(bench_thread_t *thread)
+{
+    records_workload_t *workload = (records_workload_t *)thread->arg;
+    size_t field = thread->id % RECORDS_FIELDS;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t *word = &workload->records[bench_rand(thread) % workload->count * RECORDS_FIELDS + field];
+
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t value;
+        bool ok = tm_read(workload->shared, tx, word, sizeof(value), &value);
+        value++;
+        ok = ok && tm_write(workload->shared, tx, &value, sizeof(value), word);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4,8", 1.0);
+
+    records_workload_t workload;
+    workload.count = options.size ? options.size : 1024;
+    workload.shared = tm_create(sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "records: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+
+    // Without OBJECT_LOCKS, the segment is a segment of tm_alloc
+    void *segment;
+    size_t record_size = RECORDS_FIELDS * sizeof(uint64_t);
+    tx_t tx = tm_begin(workload.shared, false);
+    if (tx == invalid_tx || tm_alloc_objects(workload.shared, tx, record_size, workload.count * record_size, &segment) != success_alloc ||
+        !tm_end(workload.shared, tx))
+    {
+        fprintf(stderr, "records: tm_alloc_objects failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.records = (uint64_t *)segment;
+
+    bench_header("access");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, records_record_body, &workload);
+        bench_report("records", BENCH_VARIANT, options.threads[run], &result, "record");
+
+        result = bench_run(options.threads[run], options.seconds, records_field_body, &workload);
+        bench_report("records", BENCH_VARIANT, options.threads[run], &result, "field");
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
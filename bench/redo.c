@@ -0,0 +1,105 @@
+/**
+ * @file   redo.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Durable commits (DURABLE_REDO_LOG): txns writing -p random words (2 by default) out of 1024, each one returning once
+ * its record is synced to the redo log. The group variant syncs the records of concurrent committers in batches (the
+ * default, REDO_LOG_GROUP_COMMIT), the single variant syncs once per commit. The log is written in $TMPDIR (/tmp by
+ * default), on the file system whose sync latency is measured.
+ *
+ *   bin/redo-group -t 1,4,16 && bin/redo-single -t 1,4,16
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define REDO_WORDS 1024
+
+typedef struct redo_workload
+{
+    shared_t shared;
+    uint64_t *words;
+    size_t writes; // Words written per txn
+} redo_workload_t;
+
+static void redo_body(bench_thread_t *thread)
+{
+    redo_workload_t *workload = (redo_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t start = bench_now_ns();
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        bool ok = true;
+        for (size_t i = 0; ok && i < workload->writes; i++)
+        {
+            uint64_t value = thread->ops;
+            ok = tm_write(workload->shared, tx, &value, sizeof(value), &workload->words[bench_rand(thread) % REDO_WORDS]);
+        }
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            bench_record_latency(thread, start);
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,4,16", 1.0);
+
+    const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    char path[4096], lock_path[4200];
+    snprintf(path, sizeof(path), "%s/tm-redo-bench-%d.log", dir, (int)getpid());
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+
+    redo_workload_t workload;
+    workload.shared = tm_create_durable(path, REDO_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "redo: tm_create_durable(%s) failed\n", path);
+        return EXIT_FAILURE;
+    }
+    workload.words = (uint64_t *)tm_start(workload.shared);
+    workload.writes = options.param ? options.param : 2;
+
+    bench_header("latency-mean-us\tlatency-max-us");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, redo_body, &workload);
+
+        char columns[64];
+        snprintf(columns, sizeof(columns), "%.1f\t%.1f", result.ops ? (double)result.latency_sum / (double)result.ops / 1e3 : 0.0,
+                 (double)result.latency_max / 1e3);
+        bench_report("redo", BENCH_VARIANT, options.threads[run], &result, columns);
+    }
+
+    int error = tm_durability_error(workload.shared);
+    tm_destroy(workload.shared);
+    unlink(path);
+    unlink(lock_path);
+
+    if (error)
+    {
+        fprintf(stderr, "redo: the redo log failed (errno %d)\n", error);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
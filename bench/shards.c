@@ -0,0 +1,120 @@
+/**
+ * @file   shards.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Tenant-partitioned workload: each thread is a tenant with its own -s accounts (1024 by default), allocated in the
+ * shard of the tenant (the tenant modulo REGION_SHARDS) with tm_alloc_in_shard, and runs transfers between two of its
+ * accounts in txns of tm_begin_in_shard. The tenants never conflict: with one shard (shards-default), they still
+ * share the clock, which every commit increments; with REGION_SHARDS = 8 (shards-sharded), up to 8 tenants have a
+ * clock of their own.
+ *
+ *   bin/shards-default -t 1,2,4,8 && bin/shards-sharded -t 1,2,4,8
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+#include <tm_ext.h>
+#include <globals.h>
+
+#include "bench.h"
+
+typedef struct shards_workload
+{
+    shared_t shared;
+    uint64_t *tenants[BENCH_MAX_THREADS]; // Accounts of each tenant
+    size_t count;                         // Accounts per tenant
+} shards_workload_t;
+
+static void shards_body(bench_thread_t *thread)
+{
+    shards_workload_t *workload = (shards_workload_t *)thread->arg;
+    uint64_t *accounts = workload->tenants[thread->id];
+    size_t shard = thread->id % REGION_SHARDS;
+
+    while (!bench_stopped(thread))
+    {
+        uint64_t *from = &accounts[bench_rand(thread) % workload->count];
+        uint64_t *to = &accounts[bench_rand(thread) % workload->count];
+        if (from == to)
+        {
+            continue;
+        }
+
+        tx_t tx = tm_begin_in_shard(workload->shared, false, shard);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        uint64_t source, target;
+        bool ok = tm_read(workload->shared, tx, from, sizeof(source), &source) &&
+                  tm_read(workload->shared, tx, to, sizeof(target), &target);
+        source--;
+        target++;
+        ok = ok && tm_write(workload->shared, tx, &source, sizeof(source), from) &&
+             tm_write(workload->shared, tx, &target, sizeof(target), to);
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4,8", 1.0);
+
+    size_t tenants = 0;
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        tenants = options.threads[run] > tenants ? options.threads[run] : tenants;
+    }
+
+    static shards_workload_t workload;
+    workload.count = options.size ? options.size : 1024;
+    workload.shared = tm_create(sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "shards: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+
+    tx_t tx = tm_begin(workload.shared, false);
+    for (size_t tenant = 0; tenant < tenants; tenant++)
+    {
+        void *accounts;
+        if (tx == invalid_tx || tm_alloc_in_shard(workload.shared, tx, tenant % REGION_SHARDS, workload.count * sizeof(uint64_t), &accounts) != success_alloc)
+        {
+            fprintf(stderr, "shards: tm_alloc_in_shard failed\n");
+            return EXIT_FAILURE;
+        }
+        workload.tenants[tenant] = (uint64_t *)accounts;
+    }
+    if (!tm_end(workload.shared, tx))
+    {
+        fprintf(stderr, "shards: tm_alloc_in_shard failed\n");
+        return EXIT_FAILURE;
+    }
+
+    char columns[32];
+    snprintf(columns, sizeof(columns), "%d", REGION_SHARDS);
+
+    bench_header("shards");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, shards_body, &workload);
+        bench_report("shards", BENCH_VARIANT, options.threads[run], &result, columns);
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file   validation.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Read-set validation: each txn reads random words of a region of -s words (1 << 20 by default), then writes a word
+ * of its thread and commits. Before the commit, the thread commits another small txn, so that the clock has moved and
+ * the commit always validates the whole read set. The sweep goes over read sets of 8 to 4096 stripes (or -p reads),
+ * with the scalar loop (validation-scalar) or the AVX2/AVX-512 gathers (validation-vector, when the CPU has them).
+ *
+ *   bin/validation-scalar -t 1 && bin/validation-vector -t 1
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+
+#include "bench.h"
+
+#define VALIDATION_SLOT_WORDS 16 // Words of the slots of a thread (two words, on their own cache lines)
+
+typedef struct validation_workload
+{
+    shared_t shared;
+    uint64_t *words;
+    size_t count;
+    uint64_t *slots; // Written words, VALIDATION_SLOT_WORDS per thread (never read by the other threads)
+    size_t reads;    // Reads per txn
+} validation_workload_t;
+
+/**
+ * @brief Commit a txn writing a word (bumps the clock).
+ */
+static bool validation_bump(shared_t shared, uint64_t *word, uint64_t value)
+{
+    tx_t tx = tm_begin(shared, false);
+    return tx != invalid_tx && tm_write(shared, tx, &value, sizeof(value), word) && tm_end(shared, tx);
+}
+
+static void validation_body(bench_thread_t *thread)
+{
+    validation_workload_t *workload = (validation_workload_t *)thread->arg;
+    uint64_t *slot = &workload->slots[thread->id * VALIDATION_SLOT_WORDS];
+
+    while (!bench_stopped(thread))
+    {
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        bool ok = true;
+        uint64_t sum = 0;
+        for (size_t i = 0; ok && i < workload->reads; i++)
+        {
+            uint64_t value;
+            ok = tm_read(workload->shared, tx, &workload->words[bench_rand(thread) % workload->count], sizeof(value), &value);
+            sum += value;
+        }
+        ok = ok && tm_write(workload->shared, tx, &sum, sizeof(sum), slot);
+
+        // A failed read or write has destroyed the txn
+        if (ok && validation_bump(workload->shared, slot + VALIDATION_SLOT_WORDS / 2, thread->ops) && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    bench_parse(argc, argv, &options, "1,2,4", 1.0);
+
+    validation_workload_t workload;
+    workload.count = options.size ? options.size : 1 << 20;
+    workload.shared = tm_create(workload.count * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "validation: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.words = (uint64_t *)tm_start(workload.shared);
+
+    void *slots;
+    tx_t tx = tm_begin(workload.shared, false);
+    if (tx == invalid_tx || tm_alloc(workload.shared, tx, BENCH_MAX_THREADS * VALIDATION_SLOT_WORDS * sizeof(uint64_t), &slots) != success_alloc ||
+        !tm_end(workload.shared, tx))
+    {
+        fprintf(stderr, "validation: tm_alloc failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.slots = (uint64_t *)slots;
+
+    const size_t sweep[] = {8, 64, 512, 4096};
+    size_t sizes = options.param ? 1 : sizeof(sweep) / sizeof(sweep[0]);
+
+    bench_header("reads");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        for (size_t s = 0; s < sizes; s++)
+        {
+            workload.reads = options.param ? options.param : sweep[s];
+            bench_result_t result = bench_run(options.threads[run], options.seconds, validation_body, &workload);
+
+            char columns[32];
+            snprintf(columns, sizeof(columns), "%zu", workload.reads);
+            bench_report("validation", BENCH_VARIANT, options.threads[run], &result, columns);
+        }
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file   wait.c
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Oversubscription: txns moving one unit from each of -p consecutive accounts (4 by default) to the account after
+ * them, out of -s hot accounts (64 by default), run by 1 to 8 threads per online CPU. A txn that finds a stripe locked
+ * aborts and retries right away (wait-default), or sleeps on a futex until the owner releases it (wait-futex, with
+ * WAIT_ON_LOCKED_STRIPES).
+ * With more threads than CPUs, the owner of a stripe may be preempted while holding it: the retries then burn the CPU
+ * it needs, while the sleepers leave it to the owner.
+ *
+ *   bin/wait-default && bin/wait-futex
+ **/
+
+#define _GNU_SOURCE
+
+#include <tm.h>
+
+#include "bench.h"
+
+#define WAIT_MAX_ACCOUNTS 64 // Accounts per txn
+
+typedef struct wait_workload
+{
+    shared_t shared;
+    uint64_t *accounts;
+    size_t count;
+    size_t touched; // Accounts per txn
+} wait_workload_t;
+
+static void wait_body(bench_thread_t *thread)
+{
+    wait_workload_t *workload = (wait_workload_t *)thread->arg;
+
+    while (!bench_stopped(thread))
+    {
+        size_t first = bench_rand(thread) % workload->count;
+
+        tx_t tx = tm_begin(workload->shared, false);
+        if (tx == invalid_tx)
+        {
+            continue;
+        }
+
+        // A failed read or write has destroyed the txn
+        bool ok = true;
+        uint64_t values[WAIT_MAX_ACCOUNTS + 1];
+        for (size_t i = 0; ok && i <= workload->touched; i++)
+        {
+            ok = tm_read(workload->shared, tx, &workload->accounts[(first + i) % workload->count], sizeof(uint64_t), &values[i]);
+        }
+        for (size_t i = 0; ok && i <= workload->touched; i++)
+        {
+            values[i] += (i == workload->touched) ? workload->touched : (uint64_t)-1;
+            ok = tm_write(workload->shared, tx, &values[i], sizeof(uint64_t), &workload->accounts[(first + i) % workload->count]);
+        }
+
+        if (ok && tm_end(workload->shared, tx))
+        {
+            thread->ops++;
+        }
+        else
+        {
+            thread->aborts++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpus = cpus > 0 ? cpus : 1;
+    char threads[96];
+    snprintf(threads, sizeof(threads), "%ld,%ld,%ld,%ld", cpus, 2 * cpus, 4 * cpus, 8 * cpus);
+
+    bench_options_t options;
+    bench_parse(argc, argv, &options, threads, 1.0);
+
+    wait_workload_t workload;
+    workload.count = options.size ? options.size : 64;
+    workload.touched = options.param ? options.param : 4;
+    if (workload.touched > WAIT_MAX_ACCOUNTS || workload.touched >= workload.count)
+    {
+        fprintf(stderr, "wait: -p must be at most %d, and below -s\n", WAIT_MAX_ACCOUNTS);
+        return EXIT_FAILURE;
+    }
+
+    workload.shared = tm_create(workload.count * sizeof(uint64_t), sizeof(uint64_t));
+    if (workload.shared == invalid_shared)
+    {
+        fprintf(stderr, "wait: tm_create failed\n");
+        return EXIT_FAILURE;
+    }
+    workload.accounts = (uint64_t *)tm_start(workload.shared);
+
+    bench_header("threads/cpu");
+    for (size_t run = 0; run < options.runs; run++)
+    {
+        bench_result_t result = bench_run(options.threads[run], options.seconds, wait_body, &workload);
+
+        char columns[32];
+        snprintf(columns, sizeof(columns), "%.2f", (double)options.threads[run] / (double)cpus);
+        bench_report("wait", BENCH_VARIANT, options.threads[run], &result, columns);
+    }
+
+    tm_destroy(workload.shared);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file   tm_engine.cpp
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Exports the tm.h interface from one instantiation of the policy-based engine of stm.hpp (make engine).
+ * The default policies mirror tm.c; change the Engine alias to build another variant.
+ **/
+
+#include <stm.hpp>
+
+using Engine = stm::Stm<stm::GlobalClock, stm::ModuloLockMap<VWSL_NUM>, stm::ArraySets, stm::AbortOnConflict, stm::LazyLocking>;
+
+static Engine *engine_of(shared_t shared)
+{
+    return static_cast<Engine *>(shared);
+}
+
+shared_t tm_create(size_t size, size_t align)
+{
+    Engine *engine = Engine::create(size, align);
+
+    return engine ? static_cast<shared_t>(engine) : invalid_shared;
+}
+
+void tm_destroy(shared_t shared)
+{
+    delete engine_of(shared);
+}
+
+void *tm_start(shared_t shared)
+{
+    return engine_of(shared)->start();
+}
+
+size_t tm_size(shared_t shared)
+{
+    return engine_of(shared)->size();
+}
+
+size_t tm_align(shared_t shared)
+{
+    return engine_of(shared)->align();
+}
+
+tx_t tm_begin(shared_t shared, bool is_ro)
+{
+    Engine::Tx *tx = engine_of(shared)->begin(is_ro);
+
+    return tx ? reinterpret_cast<tx_t>(tx) : invalid_tx;
+}
+
+bool tm_end(shared_t shared, tx_t tx)
+{
+    return engine_of(shared)->end(reinterpret_cast<Engine::Tx *>(tx));
+}
+
+bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
+{
+    return engine_of(shared)->read(reinterpret_cast<Engine::Tx *>(tx), source, size, target);
+}
+
+bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
+{
+    return engine_of(shared)->write(reinterpret_cast<Engine::Tx *>(tx), source, size, target);
+}
+
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target)
+{
+    return engine_of(shared)->alloc(reinterpret_cast<Engine::Tx *>(tx), size, target);
+}
+
+bool tm_free(shared_t shared, tx_t tx, void *target)
+{
+    return engine_of(shared)->free(reinterpret_cast<Engine::Tx *>(tx), target);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "globals.h"
+#include "tm_types.h"
+
+#define CHECKPOINT_MAGIC 0x32544e504b43544cULL // "LTCKPNT2"
+
+/**
+ * @brief Header of a checkpoint file. The data of each segment starts at a page boundary, so that the file can be mapped
+ * in place, and the file ends with 'count' segment entries, the first one being the first segment of the region.
+ *
+ */
+typedef struct checkpoint_file_header
+{
+    uint64_t magic;
+    uint64_t size;    // Size of the first segment of the region
+    uint64_t align;   // Alignment of the region
+    uint64_t count;   // Number of segments (including the first one)
+    uint64_t entries; // Offset of the segment entries in the file
+} checkpoint_file_header_t;
+
+/**
+ * @brief Entry describing a segment stored in a checkpoint file.
+ *
+ */
+typedef struct checkpoint_segment_entry
+{
+    uint64_t offset; // Offset of the segment data in the file
+    uint64_t size;   // Size of the segment data
+    uint64_t addr;   // Address of the segment when the checkpoint was taken
+} checkpoint_segment_entry_t;
+
+/**
+ * @brief Write a consistent snapshot of the region to a file. The segments are copied by chunks, each one validated
+ * against the clock as a read-only txn would, and the chunks written meanwhile are copied again until a validation pass
+ * finds none. After CHECKPOINT_OPTIMISTIC_ROUNDS rounds, the stripes of the chunks still written are locked instead: only
+ * the writers of these stripes (and tm_alloc) are blocked, until the snapshot is complete.
+ *
+ * @param region The shared memory region.
+ * @param path The path of the checkpoint file. It is replaced atomically once the snapshot is complete.
+ * @return true If the checkpoint was written.
+ * @return false If the checkpoint could not be written (I/O error or out of memory).
+ */
+bool checkpoint_t_write(region_t *region, const char *path);
+
+/**
+ * @brief Read the size and alignment of the region stored in a checkpoint file.
+ *
+ * @param path The path of the checkpoint file.
+ * @param size Pointer receiving the size of the first segment.
+ * @param align Pointer receiving the alignment of the region.
+ * @return true If the file is a valid checkpoint.
+ * @return false Otherwise.
+ */
+bool checkpoint_t_read_geometry(const char *path, size_t *size, size_t *align);
+
+/**
+ * @brief Map a checkpoint file (copy-on-write) as the segments of a region. Nothing is copied: pages are loaded on first access.
+ * The segments are linked in region->allocs and listed in region->recovered with their addresses at checkpoint time.
+ *
+ * @param region A region created with the geometry of the checkpoint and without a first segment.
+ * @param path The path of the checkpoint file.
+ * @return true If the checkpoint was mapped.
+ * @return false Otherwise.
+ */
+bool checkpoint_t_map(region_t *region, const char *path);
+
+/**
+ * @brief Check whether an address belongs to the checkpoint mapping of a region (and must not be freed).
+ *
+ * @param region The shared memory region.
+ * @param addr The address to check.
+ * @return true If the address is inside the mapping.
+ * @return false Otherwise.
+ */
+bool checkpoint_t_contains(region_t *region, void *addr);
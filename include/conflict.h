@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <tm_ext.h>
+
+#include "globals.h"
+#include "tm_types.h"
+
+/**
+ * @brief Sample an abort caused by a word (one abort in CONFLICT_SAMPLE_PERIOD of the calling thread is kept),
+ * in the ring of the calling thread. Lock-free: only the calling thread writes its ring.
+ *
+ * @param addr The (physical) address of the word whose lock made the txn abort.
+ */
+void conflict_t_record(const void *addr);
+
+/**
+ * @brief Aggregate the sampled aborts of every thread on the stripes of a region, while the threads keep sampling.
+ * The samples on other regions are skipped.
+ *
+ * @param region The shared memory region.
+ * @param hotspots Array receiving the most conflicting stripes, by decreasing number of aborts.
+ * @param max Size of the array.
+ * @return size_t The number of hotspots written.
+ */
+size_t conflict_t_report(region_t *region, tm_conflict_hotspot_t *hotspots, size_t max);
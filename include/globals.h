@@ -3,15 +3,141 @@
 #define DEBUG_PRINT false
 #define ENABLE_WARNINGS true
 
+// Debug builds: check the contracts of the API that cannot be enforced cheaply (e.g. borrowed write buffers left unchanged)
+#ifndef DEBUG_CHECKS
+#define DEBUG_CHECKS false
+#endif
+
 #define VWSL_NUM 104857600
 //#define VWSL_NUM 10050000
 
+#define CACHE_LINE_SIZE 64
+
+// Padding of the hot fields: the clock, the groups of fields of region_t and the txn descriptors start on their own
+// cache lines (see cache_aligned), so that the threads do not write to the lines they read from each other
+#ifndef PAD_HOT_FIELDS
+#define PAD_HOT_FIELDS true
+#endif
+
 #define LOCKED true
 #define UNLOCKED false
 
 #define COMMIT true
 #define ABORT false
 
+// Durability: the regions created by tm_create_durable log the write set of each commit to their redo log, and replay it
+// when they are created again from the same log
+#ifndef DURABLE_REDO_LOG
+#define DURABLE_REDO_LOG false
+#endif
+#ifndef REDO_LOG_GROUP_COMMIT
+#define REDO_LOG_GROUP_COMMIT true // false: every committer syncs the log itself
+#endif
+#define REDO_LOG_BUFFER_SIZE (1 << 20)
+
+// Back the first segment and the lock table with huge pages (reserved ones, else transparent ones, else the heap)
+#ifndef USE_HUGE_PAGES
+#define USE_HUGE_PAGES false
+#endif
+// Leave freshly mapped region memory untouched on tm_create, so that its pages are placed on the NUMA node of the first thread using them
+#ifndef FIRST_TOUCH_PLACEMENT
+#define FIRST_TOUCH_PLACEMENT false
+#endif
+
+// Co-located layout: each cache-line-sized block of a segment starts with the versioned lock of the words it holds
+// Addresses returned by tm_start/tm_alloc are then logical ([segment id | offset]), and translated on each access
+#ifndef COLOCATED_LOCKS
+#define COLOCATED_LOCKS false
+#endif
+#define COLOCATED_SEGMENT_SHIFT 40 // Logical offsets within a segment use the low 40 bits
+#define COLOCATED_CHUNK_SHIFT 16   // The segment table is a directory of chunks of 2^16 segments
+#define COLOCATED_DIRECTORY_SIZE 256
+#define COLOCATED_MAX_SEGMENTS ((size_t)COLOCATED_DIRECTORY_SIZE << COLOCATED_CHUNK_SHIFT)
+
+// Sharded clock domains: each shard has its own clock and its own part of the lock table
+// Shard 0 holds the first segment and the segments of tm_alloc, the other shards the segments of tm_alloc_in_shard
+#ifndef REGION_SHARDS
+#define REGION_SHARDS 1
+#endif
+#define SHARD_ARENA_SHIFT 34 // Each shard > 0 reserves 2^34 bytes of address space for its segments
+
+// Object-granularity locks: every word of an object of the segments of tm_alloc_objects (and of the first segment of
+// tm_create_objects) maps to one lock. Objects are locked by blocks of 2^OBJECT_MIN_SHIFT to 2^(OBJECT_MIN_SHIFT + OBJECT_CLASSES - 1) bytes.
+// Off by default: the fields of an object then conflict with each other (see the records benchmark)
+#ifndef OBJECT_LOCKS
+#define OBJECT_LOCKS false
+#endif
+#define OBJECT_MIN_SHIFT 4
+#define OBJECT_CLASSES 9
+#define OBJECT_ARENA_SHIFT 32 // Each block size reserves 2^32 bytes of address space for its segments
+
+// Read sets are arrays of stripes. With VECTOR_VALIDATION, they are validated with AVX2/AVX-512 gathers when the CPU
+// has them (checked at runtime). Off by default: compare with the validation benchmark on the target CPU
+#define READ_SET_INITIAL_CAPACITY 64
+#ifndef VECTOR_VALIDATION
+#define VECTOR_VALIDATION false
+#endif
+
+// Memory accounting: count the bytes of the read and write sets of the running txns (see tm_memory_stats). Each set
+// charges the region by chunks of MEMORY_ACCOUNTING_CHUNK bytes, so the sets smaller than a chunk are not counted.
+// Off by default: the charges are atomic adds on counters shared by all the threads of the region
+#ifndef MEMORY_ACCOUNTING
+#define MEMORY_ACCOUNTING false
+#endif
+#define MEMORY_ACCOUNTING_CHUNK (16 << 10)
+
+// Thread contexts: regions a thread may be registered in at once (see tm_thread_enter)
+#define THREAD_CONTEXT_SLOTS 8
+
+// Checkpoints: size of the chunks copied (and validated) at once, and number of rounds re-copying the chunks written meanwhile
+// before the stripes of the chunks still written are locked (blocking their writers until the snapshot is complete)
+#ifndef CHECKPOINT_CHUNK_SIZE
+#define CHECKPOINT_CHUNK_SIZE (1 << 16)
+#endif
+#ifndef CHECKPOINT_OPTIMISTIC_ROUNDS
+#define CHECKPOINT_OPTIMISTIC_ROUNDS 4
+#endif
+
+// Batched commits: attempts of each logical txn once the combined txn of a batch aborted, and cap of the randomized
+// exponential backoff between two attempts (up to 2^BATCH_BACKOFF_MAX_SHIFT pauses)
+#ifndef BATCH_MAX_ATTEMPTS
+#define BATCH_MAX_ATTEMPTS 64
+#endif
+#define BATCH_BACKOFF_MAX_SHIFT 12
+
+// Wait mode: a txn that finds a stripe locked sleeps (futex) until the owner releases it, instead of aborting right away
+#ifndef WAIT_ON_LOCKED_STRIPES
+#define WAIT_ON_LOCKED_STRIPES false
+#endif
+#define WAIT_BUCKETS 1024     // Waiters sleep on a hashed bucket of the lock, so that the lock word stays 32 bits
+#define WAIT_TIMEOUT_US 1000  // A waiter gives up (and aborts) after this delay
+
+// Latency histograms: record per thread the duration of the txns and of the commit phases (see tm_latency_snapshot)
+#ifndef LATENCY_HISTOGRAMS
+#define LATENCY_HISTOGRAMS false
+#endif
+#ifndef LATENCY_USE_RDTSC
+#define LATENCY_USE_RDTSC false // Time with the TSC (x86 only, in ticks) instead of clock_gettime (in nanoseconds)
+#endif
+
+// Conflict profiler: sample the words that make txns abort in per-thread rings (see tm_conflict_report)
+#ifndef CONFLICT_PROFILER
+#define CONFLICT_PROFILER false
+#endif
+#define CONFLICT_RING_SIZE 4096   // Samples kept per thread (a power of two): the oldest ones are overwritten
+#define CONFLICT_SAMPLE_PERIOD 1  // Keep one abort in every CONFLICT_SAMPLE_PERIOD of each thread
+
+// Event trace: log the steps of the txns (begin, aborts, commit phases...) in per-thread rings (see tm_trace_dump)
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS false
+#endif
+#define TRACE_RING_SIZE 16384 // Events kept per thread (a power of two): the oldest ones are overwritten
+
+// Hardware counters: count cycles, LLC and dTLB misses in each STM phase with perf_event_open (see tm_perf_counters)
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS false
+#endif
+
 #define COLOR_RED "\x1b[31m"
 #define COLOR_GREEN "\x1b[32m"
 #define COLOR_CYAN "\x1b[36m"
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <tm_ext.h>
+
+#include "globals.h"
+
+#if LATENCY_USE_RDTSC
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Read the clock used by the latency histograms: TSC ticks with LATENCY_USE_RDTSC, nanoseconds otherwise.
+ *
+ * @return uint64_t The current time.
+ */
+static inline uint64_t latency_t_now(void)
+{
+#if LATENCY_USE_RDTSC
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Map a value to its histogram bucket: values below 2^TM_LATENCY_SUB_BITS have their own bucket,
+ * larger ones share a bucket with the values having the same magnitude and the same TM_LATENCY_SUB_BITS leading bits.
+ *
+ * @param value The recorded value.
+ * @return size_t The bucket of the value (less than TM_LATENCY_BUCKETS).
+ */
+size_t latency_t_bucket_of(uint64_t value);
+
+/**
+ * @brief Record a value in the histogram of the calling thread. Lock-free: only the calling thread writes its histograms.
+ *
+ * @param kind The histogram to record in.
+ * @param value The value (a duration, or a number of retries).
+ */
+void latency_t_record(tm_latency_kind_t kind, uint64_t value);
+
+/**
+ * @brief Record the end of a txn of the calling thread: its duration as a commit or an abort and, on commit,
+ * the number of aborts of the thread since its previous commit (the retries of the logical transaction).
+ *
+ * @param begin The time at which the txn began (see latency_t_now).
+ * @param committed Whether the txn committed.
+ */
+void latency_t_record_txn(uint64_t begin, bool committed);
+
+/**
+ * @brief Merge the histograms of every thread (running or exited) into 'out', while the threads keep recording.
+ * Each counter is read atomically, but the counters of a histogram are not read at the same instant.
+ *
+ * @param out Array of tm_latency_kinds histograms receiving the merged ones.
+ */
+void latency_t_snapshot(tm_latency_histogram_t *out);
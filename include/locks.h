@@ -55,7 +55,10 @@ void versioned_write_spinlock_t_unlock(versioned_write_spinlock_t *lock);
  * @param lock The lock to load the version from.
  * @return int The 32-bit integer holding the lock state and version.
  */
-int versioned_write_spinlock_t_load(versioned_write_spinlock_t *lock);
+static inline int versioned_write_spinlock_t_load(versioned_write_spinlock_t *lock)
+{
+    return atomic_load(&lock->lock_and_version);
+}
 
 /**
  * @brief Store a new version to a versioned write spinlock and unlock it. Must be called only by the thread that locked the lock. 
@@ -66,13 +69,26 @@ int versioned_write_spinlock_t_load(versioned_write_spinlock_t *lock);
  */
 void versioned_write_spinlock_t_update_version(versioned_write_spinlock_t *lock, int new_version);
 
+/**
+ * @brief Sleep until a versioned write spinlock is released, or until WAIT_TIMEOUT_US elapsed.
+ * The waiter parks on the futex of a bucket shared by the locks hashed to it, woken by the unlock functions.
+ * 
+ * @param lock The lock to wait for.
+ * @return int The 32-bit integer holding the lock state and version, loaded after the wait.
+ */
+int versioned_write_spinlock_t_wait_unlocked(versioned_write_spinlock_t *lock);
+
 /**
  * @brief Atomic integer representing the global versioned clock. 
+ * It is incremented by every committer, thus it is padded to be alone on its cache line.
  * 
  */
 typedef struct global_versioned_clock
 {
-    _Atomic int clock;
+    cache_aligned _Atomic int clock;
+#if PAD_HOT_FIELDS
+    char padding[CACHE_LINE_SIZE - sizeof(int)];
+#endif
 } global_versioned_clock_t;
 
 /**
@@ -108,11 +124,11 @@ int global_versioned_clock_t_increment_and_fetch(global_versioned_clock_t *globa
 
 /**
  * @brief A default pthread lock. This is used only to add segments to the segment list.
- * It is not used by any other part in TL2.
+ * It is not used by any other part in TL2. It starts on its own cache line, so that it does not share one with hot data.
  */
 typedef struct def_lock
 {
-    pthread_mutex_t mutex;
+    cache_aligned pthread_mutex_t mutex;
 } def_lock_t;
 
 /**
@@ -123,6 +139,15 @@ typedef struct def_lock
  */
 int def_lock_t_init(def_lock_t *lock);
 
+/**
+ * @brief Initialize a default lock that can be shared by several processes (in a shared-memory object).
+ * The lock is robust: if its owner dies, the next locker takes it over.
+ * 
+ * @param lock The lock to initialize.
+ * @return int Whether the initialization was successful.
+ */
+int def_lock_t_init_shared(def_lock_t *lock);
+
 /**
  * @brief Destroy a default lock.
  * 
@@ -34,3 +34,15 @@
     #define unused(variable)
     #warning This compiler has no support for GCC attributes
 #endif
+
+/** Align a variable or field on its own cache line(s).
+ * The cache line size is CACHE_LINE_SIZE (see globals.h). Without PAD_HOT_FIELDS, it has no effect (an alignment of 0).
+**/
+#undef cache_aligned
+#ifdef __cplusplus
+    #define cache_aligned \
+        alignas(PAD_HOT_FIELDS ? CACHE_LINE_SIZE : 0)
+#else
+    #define cache_aligned \
+        _Alignas(PAD_HOT_FIELDS ? CACHE_LINE_SIZE : 0)
+#endif
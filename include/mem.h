@@ -0,0 +1,179 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "globals.h"
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+/**
+ * @brief How a block of region memory was obtained, which decides how it is released.
+ *
+ */
+typedef enum mem_kind
+{
+    MEM_KIND_HEAP,    // posix_memalign
+    MEM_KIND_HUGETLB, // mmap with MAP_HUGETLB (explicitly reserved huge pages)
+    MEM_KIND_THP,     // mmap aligned to a huge page, with madvise(MADV_HUGEPAGE)
+    MEM_KIND_MMAP,    // mmap of regular pages (see mem_alloc_zeroed)
+    MEM_KIND_SHM      // Part of the mapping of a shared-memory object, released when the object is detached
+} mem_kind_t;
+
+/**
+ * @brief Allocate a large block of region memory. With USE_HUGE_PAGES, the block is backed by huge pages when possible:
+ * first with reserved huge pages, then with transparent huge pages, and finally with regular heap memory.
+ *
+ * @param size The size of the block.
+ * @param align The alignment of the block (a power of 2).
+ * @param kind Pointer receiving how the block was allocated.
+ * @return void* The block, NULL on failure.
+ */
+void *mem_alloc(size_t size, size_t align, mem_kind_t *kind);
+
+/**
+ * @brief Allocate a large block of region memory known to be zeroed (and not touched yet): as mem_alloc, but with a fresh
+ * anonymous mapping instead of the heap as a last resort, so that the pages are only faulted in when first used.
+ *
+ * @param size The size of the block.
+ * @param align The alignment of the block (a power of 2, at most a page).
+ * @param kind Pointer receiving how the block was allocated.
+ * @return void* The block, NULL on failure.
+ */
+void *mem_alloc_zeroed(size_t size, size_t align, mem_kind_t *kind);
+
+/**
+ * @brief Check whether the memory of a block is known to be zeroed (and not touched yet).
+ *
+ * @param kind How the block was allocated.
+ * @return true If the block comes from a fresh anonymous mapping.
+ * @return false If the block must be initialized.
+ */
+bool mem_is_zeroed(mem_kind_t kind);
+
+/**
+ * @brief Release a block allocated with mem_alloc.
+ *
+ * @param ptr The block.
+ * @param size The size of the block (as passed to mem_alloc).
+ * @param kind How the block was allocated.
+ */
+void mem_free(void *ptr, size_t size, mem_kind_t kind);
+
+
+/**
+ * @brief Bytes held by a kind of region memory (the segments, or the sets of the running txns), with a soft limit.
+ * Crossing the limit calls on_exceeded once, and again only after the bytes went back under the limit.
+ *
+ */
+typedef struct mem_account
+{
+    _Atomic size_t bytes;
+    _Atomic size_t peak;
+    _Atomic size_t limit; // Soft limit (0: none)
+    _Atomic bool exceeded;
+
+    void (*on_exceeded)(struct mem_account *account, void *arg);
+    void *arg;
+} mem_account_t;
+
+/**
+ * @brief Bytes held by one set, charged to an account by chunks of MEMORY_ACCOUNTING_CHUNK bytes: the sets of the
+ * small txns (the common case) never write the shared account.
+ *
+ */
+typedef struct mem_charge
+{
+    mem_account_t *account; // NULL: not accounted
+    size_t bytes;           // Bytes held by the set
+    size_t charged;         // Bytes charged to the account
+} mem_charge_t;
+
+/**
+ * @brief Initialize an empty account, without a limit.
+ *
+ * @param account The account.
+ */
+void mem_account_t_init(mem_account_t *account);
+
+/**
+ * @brief Add bytes to an account (thread-safe), calling on_exceeded if they cross its limit.
+ *
+ * @param account The account.
+ * @param bytes The bytes.
+ */
+void mem_account_t_add(mem_account_t *account, size_t bytes);
+
+/**
+ * @brief Remove bytes from an account (thread-safe), re-arming its limit if they go back under it.
+ *
+ * @param account The account.
+ * @param bytes The bytes.
+ */
+void mem_account_t_sub(mem_account_t *account, size_t bytes);
+
+/**
+ * @brief Set the soft limit of an account, calling on_exceeded right away if the account is already over it.
+ *
+ * @param account The account.
+ * @param limit The limit (0: none).
+ */
+void mem_account_t_set_limit(mem_account_t *account, size_t limit);
+
+/**
+ * @brief Start the charge of a set.
+ *
+ * @param charge The charge.
+ * @param account The account to charge (NULL: none).
+ * @param bytes The bytes held by the empty set.
+ */
+void mem_charge_t_init(mem_charge_t *charge, mem_account_t *account, size_t bytes);
+
+/**
+ * @brief Charge the bytes of a set not charged yet to its account (the slow path of mem_charge_t_add).
+ *
+ * @param charge The charge.
+ */
+void mem_charge_t_flush(mem_charge_t *charge);
+
+/**
+ * @brief Give back the bytes charged by a set (when it is destroyed).
+ *
+ * @param charge The charge.
+ */
+void mem_charge_t_release(mem_charge_t *charge);
+
+/**
+ * @brief Count the bytes allocated by a set.
+ *
+ * @param charge The charge of the set.
+ * @param bytes The bytes.
+ */
+static inline void mem_charge_t_add(mem_charge_t *charge, size_t bytes)
+{
+    if (!MEMORY_ACCOUNTING)
+    {
+        return;
+    }
+
+    charge->bytes += bytes;
+    if (unlikely(charge->bytes >= charge->charged + MEMORY_ACCOUNTING_CHUNK))
+    {
+        mem_charge_t_flush(charge);
+    }
+}
+
+/**
+ * @brief Count the bytes freed by a set (still charged to the account until the set is destroyed).
+ *
+ * @param charge The charge of the set.
+ * @param bytes The bytes.
+ */
+static inline void mem_charge_t_sub(mem_charge_t *charge, size_t bytes)
+{
+    if (MEMORY_ACCOUNTING)
+    {
+        charge->bytes -= bytes;
+    }
+}
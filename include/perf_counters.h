@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <tm_ext.h>
+
+#include "globals.h"
+
+/**
+ * @brief Start counting a phase of the calling thread. The counters of the thread are opened on its first phase.
+ * Phases of a thread do not nest: starting a phase restarts the current one.
+ */
+void perf_t_start(void);
+
+/**
+ * @brief Stop counting the phase started last by the calling thread, and add what was counted to the given phase.
+ * Reads the counters with rdpmc when the kernel allows it, else with read().
+ *
+ * @param phase The phase to add the counts to.
+ */
+void perf_t_stop(tm_perf_phase_t phase);
+
+/**
+ * @brief Get the counters of the phases of the calling thread.
+ *
+ * @param out Array of tm_perf_phases counters.
+ * @return true If the thread could open at least one hardware counter.
+ * @return false Otherwise (the counters are 0).
+ */
+bool perf_t_thread_counters(tm_perf_counters_t *out);
+
+/**
+ * @brief Sum the counters of the phases of every thread (running or exited), while they keep counting.
+ *
+ * @param out Array of tm_perf_phases counters.
+ * @return true If a thread could open at least one hardware counter.
+ * @return false Otherwise.
+ */
+bool perf_t_counters(tm_perf_counters_t *out);
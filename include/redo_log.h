@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "globals.h"
+#include "tm_types.h"
+#include "rw_sets.h"
+
+#define REDO_LOG_MAGIC 0x314f44455232544cULL // "TL2REDO1"
+
+#define REDO_LOG_RECORD_ALLOC 1
+#define REDO_LOG_RECORD_COMMIT 2
+
+/**
+ * @brief Header of the redo log file. Written once, when the log is created (or compacted).
+ *
+ */
+typedef struct redo_log_file_header
+{
+    uint64_t magic;
+    uint64_t size;  // Size of the first segment of the region
+    uint64_t align; // Alignment of the region
+    uint64_t start; // Address of the first segment at the time the log was created
+} redo_log_file_header_t;
+
+/**
+ * @brief Header of a record of the redo log.
+ *
+ * Alloc records describe a segment created by tm_alloc (addr = segment address, size = segment size).
+ * Commit records carry the write set of a committed txn as a payload of 'size' bytes,
+ * holding 'count' entries of the form [addr (8 bytes), size (8 bytes), data (size bytes)].
+ */
+typedef struct redo_log_record
+{
+    uint32_t type;
+    uint32_t count;
+    uint64_t version;
+    uint64_t addr;
+    uint64_t size;
+    uint64_t checksum; // Checksum of the record header (with checksum=0) and the payload
+} redo_log_record_t;
+
+/**
+ * @brief Append-only redo log of a region. Committers append their write sets in a memory buffer,
+ * and a flusher thread writes and syncs the buffer to the file in batches (group commit).
+ *
+ */
+typedef struct redo_log
+{
+    int fd;
+    int lock_fd; // Holds an exclusive lock on <path>.lock, so that no other region uses the log meanwhile
+
+    pthread_mutex_t mutex;       // Protects the buffers, the LSNs and the flags
+    pthread_mutex_t flush_mutex; // Serializes the writes to the file
+    pthread_cond_t flushed_cond; // Committers wait here until their record is durable
+    pthread_cond_t work_cond;    // The flusher waits here for new records
+
+    char *buffer; // Records appended but not yet handed to the flusher
+    size_t used;
+    size_t capacity;
+
+    char *flush_buffer; // Records being written by the flusher
+    size_t flush_capacity;
+
+    uint64_t appended_lsn; // Log sequence numbers are byte offsets in the record stream
+    uint64_t flushed_lsn;
+
+    bool failed; // Sticky: once a record could not be written or synced, no record is appended anymore
+    int error;   // errno of the failure
+    bool stop;
+    pthread_t flusher;
+} redo_log_t;
+
+/**
+ * @brief Open the redo log of a region. If the file exists and matches the region geometry,
+ * its records are replayed into the region (recreating the allocated segments, see region->recovered), and the log is
+ * compacted to a snapshot of the recovered region. Otherwise a new log is created.
+ * Fails if the log is used by another region (of any process).
+ *
+ * @param region The freshly initialized region (no running transaction).
+ * @param path The path of the log file.
+ * @return redo_log_t* The opened log, NULL on failure.
+ */
+redo_log_t *redo_log_t_open(region_t *region, const char *path);
+
+/**
+ * @brief Flush every pending record, stop the flusher thread and close the log.
+ *
+ * @param log The log to close.
+ */
+void redo_log_t_close(redo_log_t *log);
+
+/**
+ * @brief Append an alloc record for a newly created segment.
+ *
+ * @param log The log to append to.
+ * @param segment The address of the first word of the segment.
+ * @param size The size of the segment.
+ * @return uint64_t The LSN of the record, 0 on failure (in particular once the log failed, see redo_log_t_error).
+ */
+uint64_t redo_log_t_append_alloc(redo_log_t *log, void *segment, size_t size);
+
+/**
+ * @brief Append a commit record holding the (addr, value) pairs of a write set.
+ * Must be called while the locks of the write set are held, so that the log order follows the commit order.
+ *
+ * @param log The log to append to.
+ * @param set The write set of the committing txn.
+ * @param wv The write version of the committing txn.
+ * @return uint64_t The LSN of the record, 0 on failure (in particular once the log failed, see redo_log_t_error).
+ */
+uint64_t redo_log_t_append_write_set(redo_log_t *log, write_set_t *set, int wv);
+
+/**
+ * @brief Block until the record with the given LSN (and every record before it) is durable.
+ *
+ * @param log The log to wait on.
+ * @param lsn The LSN returned by an append.
+ * @return true If the record is durable.
+ * @return false If the log failed to write or sync the record.
+ */
+bool redo_log_t_wait_durable(redo_log_t *log, uint64_t lsn);
+
+/**
+ * @brief Get the error of a failed log: once a record could not be written or synced, the log refuses every append.
+ *
+ * @param log The log to query.
+ * @return int The errno of the failure, 0 if the log did not fail.
+ */
+int redo_log_t_error(redo_log_t *log);
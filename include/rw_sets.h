@@ -6,21 +6,26 @@
 #include <stdint.h>
 
 #include "globals.h"
+#include "locks.h"
+#include "mem.h"
 
 /**
- * @brief Struct representing a node in a set.
- * 
- * Some fields are only used for write sets.
+ * @brief Struct representing a node in a set (write sets, see read_set_t for the read sets).
  * 
  */
 typedef struct set_node
 {
-    void *val;   // unused for read sets
-    size_t size; // unused for read sets
+    void *val;     // The value to write
+    size_t size;   // Bytes covered by the node: a word, or a range (borrowed, or owned: see set_t_add_owned)
+    bool borrowed; // val points to a buffer of the caller (not owned by the set), see set_t_add_borrowed
 
     void *addr;
 
     struct set_node *next;
+
+#if DEBUG_CHECKS
+    uint64_t checksum; // Checksum of a borrowed buffer when it was added
+#endif
 } set_node_t;
 
 /**
@@ -31,17 +36,110 @@ typedef struct set
 {
     set_node_t *head;
     set_node_t *tail;
+    set_node_t *free;    // Nodes of the cleared elements, reused with their values (see set_t_clear)
+    mem_charge_t charge; // Bytes of the nodes and of the owned values
 } set_t;
 
-typedef set_t read_set_t;
 typedef set_t write_set_t;
 
+#if COLOCATED_LOCKS
+typedef versioned_write_spinlock_t *read_set_entry_t; // The lock of the block holding the word
+#else
+typedef uint32_t read_set_entry_t; // The index of the stripe of the word in the lock table of the region
+#endif
+
+/**
+ * @brief Read set: the stripes read by a txn, in reading order. A stripe read twice in a row is only stored once,
+ * other duplicates are kept (validating a stripe twice is cheaper than looking it up on every read).
+ * 
+ */
+typedef struct read_set
+{
+    read_set_entry_t *entries;
+    void **addrs; // With CONFLICT_PROFILER: the word of each entry, to report the words failing validation
+    size_t count;
+    size_t capacity;
+    mem_charge_t charge;
+} read_set_t;
+
+/**
+ * @brief Initialize a new (empty) read set.
+ * 
+ * @param account Account charged with the memory of the set (NULL: none)
+ * @return read_set_t* Pointer to the newly initialized read set, NULL on failure
+ */
+read_set_t *read_set_t_init(mem_account_t *account);
+
+/**
+ * @brief Destroy a read set.
+ * 
+ * @param set Pointer to the read set to destroy
+ */
+void read_set_t_destroy(read_set_t *set);
+
+/**
+ * @brief Remove every stripe of a read set, keeping its arrays for the next txn.
+ * 
+ * @param set Pointer to the read set
+ */
+void read_set_t_clear(read_set_t *set);
+
+/**
+ * @brief Double the capacity of a read set (the slow path of read_set_t_add).
+ * 
+ * @param set Pointer to the read set
+ * @return true If the arrays grew
+ * @return false If the arrays could not grow
+ */
+bool read_set_t_grow(read_set_t *set);
+
+/**
+ * @brief Remove every occurrence of some stripes from a read set, keeping the reading order of the others. The stripes
+ * are sorted once, then the read set is filtered in a single pass (with a binary search per entry).
+ * 
+ * @param set Pointer to the read set
+ * @param entries The stripes to remove (sorted in place)
+ * @param count The number of stripes to remove
+ */
+void read_set_t_remove(read_set_t *set, read_set_entry_t *entries, size_t count);
+
+/**
+ * @brief Add the stripe of a word to a read set.
+ * 
+ * @param set Pointer to the read set
+ * @param entry The stripe of the word
+ * @param addr The word (only kept with CONFLICT_PROFILER)
+ * @return true If the stripe was added
+ * @return false If the array could not grow
+ */
+static inline bool read_set_t_add(read_set_t *set, read_set_entry_t entry, void *addr)
+{
+    if (set->count > 0 && set->entries[set->count - 1] == entry)
+    {
+        return true;
+    }
+
+    if (unlikely(set->count == set->capacity) && unlikely(!read_set_t_grow(set)))
+    {
+        return false;
+    }
+
+    if (CONFLICT_PROFILER)
+    {
+        set->addrs[set->count] = addr;
+    }
+    set->entries[set->count++] = entry;
+
+    return true;
+}
+
 /**
  * @brief Initialize a new set.
  * 
+ * @param account Account charged with the memory of the set (NULL: none)
  * @return set_t* Pointer to the newly initialized set
  */
-set_t *set_t_init();
+set_t *set_t_init(mem_account_t *account);
 
 /**
  * @brief Destroy a set.
@@ -50,6 +148,13 @@ set_t *set_t_init();
  */
 void set_t_destroy(set_t *set/*, bool is_write_set*/);
 
+/**
+ * @brief Remove every element of a set, keeping the nodes (and their word values) to reuse them for the next txn.
+ * 
+ * @param set Pointer to the set to clear
+ */
+void set_t_clear(set_t *set);
+
 /**
  * @brief Add an element to a set.
  * 
@@ -62,13 +167,60 @@ void set_t_destroy(set_t *set/*, bool is_write_set*/);
  */
 bool set_t_add(set_t *set, void *addr, void *val, size_t size);
 
+/**
+ * @brief Add a range to a write set, borrowing the caller's buffer instead of copying it.
+ * The range must not overlap the elements of the set (see set_t_overlaps). A later add_or_update of a word of the range
+ * copies the range word by word first, so the borrowed buffer is never written.
+ * 
+ * @param set Pointer to the set to add to
+ * @param addr Address of the first word of the range
+ * @param val Buffer holding the values of the range, which must stay unchanged until the set is destroyed
+ * @param size Size of the range
+ * @return true If the element was added successfully
+ * @return false If the element was not added successfully (in case of an error)
+ */
+bool set_t_add_borrowed(set_t *set, void *addr, const void *val, size_t size);
+
+/**
+ * @brief Add a range to a set, taking the ownership of its (malloc'ed) values. Same contract as set_t_add_borrowed, except
+ * that a later add_or_update of a word of the range updates the value in place.
+ * 
+ * @param set Pointer to the set
+ * @param addr Address of the first word of the range
+ * @param val Values of the range (freed with the set)
+ * @param size Size of the range
+ * @return true If the range was added successfully
+ * @return false If the range was not added successfully (in case of an error), val is not freed
+ */
+bool set_t_add_owned(set_t *set, void *addr, void *val, size_t size);
+
+/**
+ * @brief Check whether a range overlaps an element of a set.
+ * 
+ * @param set Pointer to the set
+ * @param addr Start of the range
+ * @param size Size of the range
+ * @return true If an element covers a byte of the range
+ * @return false Otherwise
+ */
+bool set_t_overlaps(set_t *set, void *addr, size_t size);
+
+/**
+ * @brief Check that the borrowed buffers of a set were not modified since they were added (only with DEBUG_CHECKS).
+ * 
+ * @param set Pointer to the set
+ * @return true If every borrowed buffer is unchanged (always true without DEBUG_CHECKS)
+ * @return false If a borrowed buffer was modified
+ */
+bool set_t_check_borrowed(set_t *set);
+
 /**
  * @brief Add or update an element in a set.
  * 
  * @param set Pointer to the set to add to
  * @param addr Address of the element to add
- * @param val Value of the element to add (NULL if the set is a read set)
- * @param size Size of the element to add (0 if the set is a read set)
+ * @param val Value of the element to add
+ * @param size Size of the element to add
  * @return true If the element was added successfully
  * @return false If the element was not added successfully (in case of an error)
  */
@@ -80,7 +232,7 @@ bool set_t_add_or_update(set_t *set, void *addr, void *val, size_t size);
  * This is used only for write sets in the implementation.
  * 
  * @param set Pointer to the set to get the value from
- * @param addr Address of the element to get the value of
+ * @param addr Address of the element to get the value of (a word, possibly inside a range)
  * @return void* Pointer to the value of the element (NULL when not found)
  */
 void *set_t_get_val_or_null(set_t *set, void *addr);
\ No newline at end of file
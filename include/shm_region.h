@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "globals.h"
+
+#define SHM_REGION_MAGIC 0x314d48535432544cULL // "LT2TSHM1"
+
+#define SHM_REGION_HEADER_SIZE 4096 // The region struct starts on the page after the header
+
+/**
+ * @brief Header of a shared-memory object holding a region. It is followed by the region struct (clock, lock table and
+ * segment list), then by a heap from which the first segment and the segments of tm_alloc are carved.
+ *
+ * Every process maps the object at the same address (base), so that the pointers stored in the region (segment list,
+ * addresses returned by tm_alloc and stored in the data) are valid in all of them.
+ */
+typedef struct shm_region_header
+{
+    _Atomic uint64_t magic; // Stored last by the creator: attaching fails until the region is initialized
+    uint64_t base;          // Address of the mapping in every process
+    uint64_t length;        // Size of the object
+    uint64_t heap_start;    // Offset of the heap
+    _Atomic uint64_t heap_used;
+} shm_region_header_t;
+
+/**
+ * @brief Create a named shared-memory object and map it. The caller initializes the region, then publishes it.
+ *
+ * @param name The name of the object (as for shm_open, e.g. "/my_region"). Fails if it already exists.
+ * @param region_size The size of the region struct, placed after the header.
+ * @param heap_size The size of the heap, placed after the region struct.
+ * @return shm_region_header_t* The mapped object, NULL on failure.
+ */
+shm_region_header_t *shm_region_t_create(const char *name, size_t region_size, size_t heap_size);
+
+/**
+ * @brief Make a created object visible to shm_region_t_attach.
+ *
+ * @param shm The mapped object.
+ */
+void shm_region_t_publish(shm_region_header_t *shm);
+
+/**
+ * @brief Map an existing object, at the address it has in the process that created it.
+ *
+ * @param name The name of the object.
+ * @return shm_region_header_t* The mapped object, NULL on failure (missing, not published yet, or the address is taken).
+ */
+shm_region_header_t *shm_region_t_attach(const char *name);
+
+/**
+ * @brief Get the region struct held by an object.
+ *
+ * @param shm The mapped object.
+ * @return void* The region struct.
+ */
+void *shm_region_t_region(shm_region_header_t *shm);
+
+/**
+ * @brief Carve a block from the heap of an object (lock-free). Blocks are only released with the object.
+ *
+ * @param shm The mapped object.
+ * @param size The size of the block.
+ * @param align The alignment of the block (a power of 2).
+ * @return void* The block (zeroed), NULL if the heap is exhausted.
+ */
+void *shm_region_t_alloc(shm_region_header_t *shm, size_t size, size_t align);
+
+/**
+ * @brief Unmap an object from the calling process. The object lives on until it is unlinked and every process detached.
+ *
+ * @param shm The mapped object.
+ */
+void shm_region_t_detach(shm_region_header_t *shm);
+
+/**
+ * @brief Remove the name of an object.
+ *
+ * @param name The name of the object.
+ * @return true If the name was removed.
+ * @return false Otherwise.
+ */
+bool shm_region_t_unlink(const char *name);
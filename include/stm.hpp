@@ -0,0 +1,919 @@
+/**
+ * @file   stm.hpp
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Policy-based C++17 reimplementation of the TL2 engine of tm.c/utils.c, as a header.
+ * Each combination of policies is a separate type, fully inlined by the compiler: choosing a variant costs no branch
+ * on the access paths. The tm.h API can be exported from any instantiation (see engine/tm_engine.cpp).
+ *
+ * Stm<ClockPolicy, LockMapPolicy, SetPolicy, CmPolicy, LockingPolicy>:
+ *  - ClockPolicy:   GlobalClock (one increment per commit, as in tm.c), PassOnFailureClock (commits racing on the clock share a version)
+ *  - LockMapPolicy: ModuloLockMap<N> (address modulo N, as in tm.c), HashedLockMap<LogN, Shift> (one stripe per 2^Shift bytes)
+ *  - SetPolicy:     ListSets (sorted linked lists), ArraySets (arrays, as the read sets of utils.c)
+ *  - CmPolicy:      AbortOnConflict (as in tm.c), SpinThenAbort<N>, BackoffOnAbort<MaxShift>
+ *  - LockingPolicy: LazyLocking (locks taken at commit, as in tm.c), EagerLocking (locks taken by tm_write)
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+extern "C"
+{
+#include <tm.h>
+}
+
+#include "globals.h"
+
+namespace stm
+{
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * @brief Versioned write spinlock, as in locks.h: [version (31 bits) | lock bit].
+ */
+struct VersionedLock
+{
+    std::atomic<int> word;
+};
+
+inline bool is_locked(int word)
+{
+    return word & 0x1;
+}
+
+inline int version_of(int word)
+{
+    return word >> 1;
+}
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// -------------------------------------------------------------------------- //
+// Clock policies
+
+/**
+ * @brief Global versioned clock incremented by every committer (TL2 GV1, as in tm.c).
+ */
+class GlobalClock
+{
+public:
+    int sample() const
+    {
+        return clock_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Get the write version of a committer (which holds its locks).
+     *
+     * @param rv The read version of the committer.
+     * @param skip_validation Set when no other txn committed since rv (the read set is then valid).
+     * @return int The write version.
+     */
+    int tick(int rv, bool &skip_validation)
+    {
+        int wv = clock_.fetch_add(1) + 1;
+        skip_validation = (wv == rv + 1);
+        return wv;
+    }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<int> clock_{0};
+};
+
+/**
+ * @brief Clock incremented once by a burst of concurrent committers (TL2 GV4): a committer losing the race on the clock
+ * takes the version installed by the winner. Fewer writes to the clock line, but the read set is always validated.
+ */
+class PassOnFailureClock
+{
+public:
+    int sample() const
+    {
+        return clock_.load(std::memory_order_acquire);
+    }
+
+    int tick(int rv, bool &skip_validation)
+    {
+        int now = clock_.load(std::memory_order_acquire);
+        if (clock_.compare_exchange_strong(now, now + 1))
+        {
+            skip_validation = (now + 1 == rv + 1);
+            return now + 1;
+        }
+
+        skip_validation = false;
+        return now;
+    }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<int> clock_{0};
+};
+
+// -------------------------------------------------------------------------- //
+// Lock map policies
+
+/**
+ * @brief Table of Stripes locks, zeroed lazily by the kernel (calloc of a large table maps fresh pages).
+ */
+template <size_t Stripes>
+class LockTable
+{
+public:
+    bool valid() const
+    {
+        return locks_ != nullptr;
+    }
+
+protected:
+    struct Free
+    {
+        void operator()(VersionedLock *locks) const
+        {
+            std::free(locks);
+        }
+    };
+
+    std::unique_ptr<VersionedLock[], Free> locks_{static_cast<VersionedLock *>(std::calloc(Stripes, sizeof(VersionedLock)))};
+};
+
+/**
+ * @brief Stripe of an address: the address modulo Stripes (as utils_get_mapped_lock).
+ */
+template <size_t Stripes>
+class ModuloLockMap : public LockTable<Stripes>
+{
+public:
+    VersionedLock *lock_of(const void *addr)
+    {
+        return &this->locks_[reinterpret_cast<uintptr_t>(addr) % Stripes];
+    }
+};
+
+/**
+ * @brief Stripe of an address: the block of 2^Shift bytes holding it, hashed into a table of 2^LogStripes locks.
+ */
+template <unsigned LogStripes, unsigned Shift>
+class HashedLockMap : public LockTable<(size_t)1 << LogStripes>
+{
+public:
+    VersionedLock *lock_of(const void *addr)
+    {
+        uint64_t block = reinterpret_cast<uintptr_t>(addr) >> Shift;
+        return &this->locks_[(block * 0x9e3779b97f4a7c15ull) >> (64 - LogStripes)];
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Set policies
+//
+// ReadSet:  add(lock), all_of(f) -> whether f(lock) holds for every lock added
+// WriteSet: put(addr, value, size) -> false on allocation failure, find(addr) -> value or nullptr,
+//           for_each(f) calls f(addr, value, size), empty()
+
+/**
+ * @brief Sorted (by address) singly linked lists, as the sets of rw_sets.c.
+ */
+struct ListSets
+{
+    class ReadSet
+    {
+    public:
+        ~ReadSet()
+        {
+            while (head_)
+            {
+                Node *next = head_->next;
+                delete head_;
+                head_ = next;
+            }
+        }
+
+        bool add(VersionedLock *lock)
+        {
+            Node **link = &head_;
+            while (*link && (*link)->lock < lock)
+            {
+                link = &(*link)->next;
+            }
+            if (*link && (*link)->lock == lock)
+            {
+                return true;
+            }
+
+            Node *node = new (std::nothrow) Node{lock, *link};
+            if (!node)
+            {
+                return false;
+            }
+            *link = node;
+
+            return true;
+        }
+
+        template <class F>
+        bool all_of(F f) const
+        {
+            for (Node *curr = head_; curr; curr = curr->next)
+            {
+                if (!f(curr->lock))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        struct Node
+        {
+            VersionedLock *lock;
+            Node *next;
+        };
+
+        Node *head_ = nullptr;
+    };
+
+    class WriteSet
+    {
+    public:
+        ~WriteSet()
+        {
+            while (head_)
+            {
+                Node *next = head_->next;
+                delete head_;
+                head_ = next;
+            }
+        }
+
+        bool put(void *addr, const void *value, size_t size)
+        {
+            Node **link = &head_;
+            while (*link && (*link)->addr < addr)
+            {
+                link = &(*link)->next;
+            }
+            if (*link && (*link)->addr == addr)
+            {
+                std::memcpy((*link)->value.get(), value, size);
+                return true;
+            }
+
+            Node *node = new (std::nothrow) Node{addr, size, *link, std::unique_ptr<unsigned char[]>(new (std::nothrow) unsigned char[size])};
+            if (!node || !node->value)
+            {
+                delete node;
+                return false;
+            }
+            std::memcpy(node->value.get(), value, size);
+            *link = node;
+
+            return true;
+        }
+
+        const void *find(const void *addr) const
+        {
+            for (Node *curr = head_; curr && curr->addr <= addr; curr = curr->next)
+            {
+                if (curr->addr == addr)
+                {
+                    return curr->value.get();
+                }
+            }
+
+            return nullptr;
+        }
+
+        template <class F>
+        void for_each(F f) const
+        {
+            for (Node *curr = head_; curr; curr = curr->next)
+            {
+                f(curr->addr, curr->value.get(), curr->size);
+            }
+        }
+
+        bool empty() const
+        {
+            return head_ == nullptr;
+        }
+
+    private:
+        struct Node
+        {
+            void *addr;
+            size_t size;
+            Node *next;
+            std::unique_ptr<unsigned char[]> value;
+        };
+
+        Node *head_ = nullptr;
+    };
+};
+
+/**
+ * @brief Arrays: appends are O(1), and the write set answers most failed lookups with a 64-bit Bloom filter.
+ */
+struct ArraySets
+{
+    class ReadSet
+    {
+    public:
+        bool add(VersionedLock *lock)
+        {
+            if (!locks_.empty() && locks_.back() == lock)
+            {
+                return true;
+            }
+
+            try
+            {
+                locks_.push_back(lock);
+            }
+            catch (const std::bad_alloc &)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        template <class F>
+        bool all_of(F f) const
+        {
+            for (VersionedLock *lock : locks_)
+            {
+                if (!f(lock))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        std::vector<VersionedLock *> locks_;
+    };
+
+    class WriteSet
+    {
+    public:
+        bool put(void *addr, const void *value, size_t size)
+        {
+            if (void *existing = const_cast<void *>(find(addr)))
+            {
+                std::memcpy(existing, value, size);
+                return true;
+            }
+
+            try
+            {
+                entries_.push_back(Entry{addr, values_.size(), size});
+                values_.insert(values_.end(), static_cast<const unsigned char *>(value), static_cast<const unsigned char *>(value) + size);
+            }
+            catch (const std::bad_alloc &)
+            {
+                return false;
+            }
+            filter_ |= bit_of(addr);
+
+            return true;
+        }
+
+        const void *find(const void *addr) const
+        {
+            if (!(filter_ & bit_of(addr)))
+            {
+                return nullptr;
+            }
+
+            for (const Entry &entry : entries_)
+            {
+                if (entry.addr == addr)
+                {
+                    return values_.data() + entry.offset;
+                }
+            }
+
+            return nullptr;
+        }
+
+        template <class F>
+        void for_each(F f) const
+        {
+            for (const Entry &entry : entries_)
+            {
+                f(entry.addr, values_.data() + entry.offset, entry.size);
+            }
+        }
+
+        bool empty() const
+        {
+            return entries_.empty();
+        }
+
+    private:
+        struct Entry
+        {
+            void *addr;
+            size_t offset; // Of the value in values_
+            size_t size;
+        };
+
+        static uint64_t bit_of(const void *addr)
+        {
+            return (uint64_t)1 << ((reinterpret_cast<uintptr_t>(addr) * 0x9e3779b97f4a7c15ull) >> 58);
+        }
+
+        std::vector<Entry> entries_;
+        std::vector<unsigned char> values_;
+        uint64_t filter_ = 0;
+    };
+};
+
+// -------------------------------------------------------------------------- //
+// Contention manager policies
+//
+// on_begin(), on_commit(), on_abort(): called on the thread of the txn
+// wait_unlocked(lock, word): called when a stripe is found locked, returns the word to go on with (aborts if still locked)
+
+/**
+ * @brief Abort as soon as a stripe is found locked (as tm.c).
+ */
+struct AbortOnConflict
+{
+    static void on_begin() {}
+    static void on_commit() {}
+    static void on_abort() {}
+
+    static int wait_unlocked(const VersionedLock &, int word)
+    {
+        return word;
+    }
+};
+
+/**
+ * @brief Spin on a locked stripe (up to Spins loads), hoping that its owner is committing, before aborting.
+ */
+template <unsigned Spins>
+struct SpinThenAbort
+{
+    static void on_begin() {}
+    static void on_commit() {}
+    static void on_abort() {}
+
+    static int wait_unlocked(const VersionedLock &lock, int word)
+    {
+        for (unsigned spin = 0; spin < Spins && is_locked(word); spin++)
+        {
+            cpu_relax();
+            word = lock.word.load(std::memory_order_acquire);
+        }
+
+        return word;
+    }
+};
+
+/**
+ * @brief Abort as soon as a stripe is found locked, but delay the next txn of the thread by an exponential (randomized)
+ * backoff, of up to 2^MaxShift pauses, after consecutive aborts.
+ */
+template <unsigned MaxShift>
+struct BackoffOnAbort
+{
+    static void on_begin()
+    {
+        unsigned aborts = state().aborts;
+        if (aborts == 0)
+        {
+            return;
+        }
+
+        uint64_t &seed = state().seed;
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        unsigned shift = aborts < MaxShift ? aborts : MaxShift;
+        for (uint64_t pause = (seed >> 33) & (((uint64_t)1 << shift) - 1); pause > 0; pause--)
+        {
+            cpu_relax();
+        }
+    }
+
+    static void on_commit()
+    {
+        state().aborts = 0;
+    }
+
+    static void on_abort()
+    {
+        state().aborts++;
+    }
+
+    static int wait_unlocked(const VersionedLock &, int word)
+    {
+        return word;
+    }
+
+private:
+    struct State
+    {
+        unsigned aborts = 0;
+        uint64_t seed = 0x853c49e6748fea9bull;
+    };
+
+    static State &state()
+    {
+        thread_local State state;
+        return state;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Locking policies
+
+/**
+ * @brief Locks taken at commit time, for the whole write set (TL2, as in tm.c).
+ */
+struct LazyLocking
+{
+    static constexpr bool eager = false;
+};
+
+/**
+ * @brief Locks taken by the writes (encounter time): conflicts between writers are found before the commit.
+ * The values are still buffered in the write set until the commit.
+ */
+struct EagerLocking
+{
+    static constexpr bool eager = true;
+};
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * @brief TL2 engine composed of policies. Same contract as tm.h: a txn whose read/write/end fails is destroyed.
+ */
+template <class ClockPolicy, class LockMapPolicy, class SetPolicy, class CmPolicy, class LockingPolicy = LazyLocking>
+class Stm
+{
+public:
+    /**
+     * @brief A transaction.
+     */
+    struct Tx
+    {
+        bool is_ro;
+        int rv;
+        typename SetPolicy::ReadSet reads;
+        typename SetPolicy::WriteSet writes;
+        std::vector<std::pair<VersionedLock *, int>> held; // Locks held, with their words before locking (sorted by lock)
+    };
+
+    /**
+     * @brief Create a region.
+     *
+     * @param size Size of the first segment (a positive multiple of align).
+     * @param align Alignment (a power of 2), i.e. the size of a word.
+     * @return Stm* The region, nullptr on failure.
+     */
+    static Stm *create(size_t size, size_t align)
+    {
+        Stm *stm = new (std::nothrow) Stm(size, align);
+        if (stm && (!stm->start_ || !stm->locks_.valid()))
+        {
+            delete stm;
+            return nullptr;
+        }
+
+        return stm;
+    }
+
+    ~Stm()
+    {
+        for (void *segment : segments_)
+        {
+            std::free(segment);
+        }
+        std::free(start_);
+    }
+
+    void *start() const
+    {
+        return start_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t align() const
+    {
+        return align_;
+    }
+
+    Tx *begin(bool is_ro)
+    {
+        CmPolicy::on_begin();
+
+        return new (std::nothrow) Tx{is_ro, clock_.sample(), {}, {}, {}};
+    }
+
+    bool end(Tx *tx)
+    {
+        if (tx->is_ro || tx->writes.empty())
+        {
+            // The reads were validated one by one (and a txn that wrote nothing holds no lock)
+            CmPolicy::on_commit();
+            delete tx;
+            return true;
+        }
+
+        if (!LockingPolicy::eager && !lock_write_set(tx))
+        {
+            return abort(tx);
+        }
+
+        bool skip_validation;
+        int wv = clock_.tick(tx->rv, skip_validation);
+
+        // A stripe locked by the txn itself is valid if its version before the lock is
+        if (!skip_validation && !tx->reads.all_of([&](VersionedLock *lock) {
+                int word = lock->word.load(std::memory_order_acquire);
+                if (is_locked(word))
+                {
+                    const std::pair<VersionedLock *, int> *own = find_held(tx, lock);
+                    if (!own)
+                    {
+                        return false;
+                    }
+                    word = own->second;
+                }
+                return version_of(word) <= tx->rv;
+            }))
+        {
+            return abort(tx);
+        }
+
+        tx->writes.for_each([](void *addr, const void *value, size_t size) {
+            std::memcpy(addr, value, size);
+        });
+        for (const std::pair<VersionedLock *, int> &own : tx->held)
+        {
+            own.first->word.store(wv << 1, std::memory_order_release);
+        }
+
+        CmPolicy::on_commit();
+        delete tx;
+
+        return true;
+    }
+
+    bool read(Tx *tx, const void *source, size_t size, void *target)
+    {
+        for (size_t i = 0; i < size; i += align_)
+        {
+            const char *word = static_cast<const char *>(source) + i;
+            char *out = static_cast<char *>(target) + i;
+
+            if (!tx->is_ro)
+            {
+                if (const void *value = tx->writes.find(word))
+                {
+                    std::memcpy(out, value, align_);
+                    continue;
+                }
+            }
+
+            // Pre-validate the stripe
+            VersionedLock *lock = locks_.lock_of(word);
+            int before = lock->word.load(std::memory_order_acquire);
+            bool own = false;
+            if (is_locked(before))
+            {
+                const std::pair<VersionedLock *, int> *held = LockingPolicy::eager ? find_held(tx, lock) : nullptr;
+                if (held)
+                {
+                    // Another word of a stripe locked by the txn: nobody else can write it
+                    before = held->second;
+                    own = true;
+                }
+                else
+                {
+                    before = CmPolicy::wait_unlocked(*lock, before);
+                    if (is_locked(before))
+                    {
+                        return abort(tx);
+                    }
+                }
+            }
+            if (version_of(before) > tx->rv)
+            {
+                return abort(tx);
+            }
+
+            std::memcpy(out, word, align_);
+
+            // Post-validate the stripe
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!own && lock->word.load(std::memory_order_relaxed) != before)
+            {
+                return abort(tx);
+            }
+
+            if (!tx->is_ro && !tx->reads.add(lock))
+            {
+                return abort(tx);
+            }
+        }
+
+        return true;
+    }
+
+    bool write(Tx *tx, const void *source, size_t size, void *target)
+    {
+        for (size_t i = 0; i < size; i += align_)
+        {
+            char *word = static_cast<char *>(target) + i;
+
+            if (LockingPolicy::eager && !acquire(tx, locks_.lock_of(word)))
+            {
+                return abort(tx);
+            }
+
+            if (!tx->writes.put(word, static_cast<const char *>(source) + i, align_))
+            {
+                return abort(tx);
+            }
+        }
+
+        return true;
+    }
+
+    alloc_t alloc(Tx *, size_t size, void **target)
+    {
+        void *segment = allocate(size);
+        if (!segment)
+        {
+            return nomem_alloc;
+        }
+
+        try
+        {
+            std::lock_guard<std::mutex> guard(segments_lock_);
+            segments_.push_back(segment);
+        }
+        catch (const std::bad_alloc &)
+        {
+            std::free(segment);
+            return nomem_alloc;
+        }
+
+        *target = segment;
+
+        return success_alloc;
+    }
+
+    bool free(Tx *, void *)
+    {
+        // As in tm.c, the segments are only freed with the region
+        return true;
+    }
+
+private:
+    Stm(size_t size, size_t align) : size_(size), align_(align), start_(allocate(size)) {}
+
+    void *allocate(size_t size)
+    {
+        size_t align = align_ < sizeof(void *) ? sizeof(void *) : align_;
+        void *segment = std::aligned_alloc(align, (size + align - 1) / align * align);
+        if (segment)
+        {
+            std::memset(segment, 0, size);
+        }
+
+        return segment;
+    }
+
+    static const std::pair<VersionedLock *, int> *find_held(const Tx *tx, VersionedLock *lock)
+    {
+        auto it = std::lower_bound(tx->held.begin(), tx->held.end(), lock,
+                                   [](const std::pair<VersionedLock *, int> &own, VersionedLock *key) { return own.first < key; });
+
+        return (it != tx->held.end() && it->first == lock) ? &*it : nullptr;
+    }
+
+    /**
+     * @brief Take a lock for the txn (unless it already holds it), waiting as the contention manager decides.
+     */
+    bool acquire(Tx *tx, VersionedLock *lock)
+    {
+        auto it = std::lower_bound(tx->held.begin(), tx->held.end(), lock,
+                                   [](const std::pair<VersionedLock *, int> &own, VersionedLock *key) { return own.first < key; });
+        if (it != tx->held.end() && it->first == lock)
+        {
+            return true;
+        }
+
+        int word = lock->word.load(std::memory_order_acquire);
+        if (is_locked(word))
+        {
+            word = CmPolicy::wait_unlocked(*lock, word);
+        }
+        if (is_locked(word) || !lock->word.compare_exchange_strong(word, word | 0x1))
+        {
+            return false;
+        }
+
+        try
+        {
+            tx->held.insert(it, {lock, word});
+        }
+        catch (const std::bad_alloc &)
+        {
+            lock->word.store(word, std::memory_order_release);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Lock the stripes of the write set (each one once), in address order.
+     */
+    bool lock_write_set(Tx *tx)
+    {
+        std::vector<VersionedLock *> stripes;
+        try
+        {
+            tx->writes.for_each([&](void *addr, const void *, size_t) {
+                stripes.push_back(locks_.lock_of(addr));
+            });
+        }
+        catch (const std::bad_alloc &)
+        {
+            return false;
+        }
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+        for (VersionedLock *lock : stripes)
+        {
+            if (!acquire(tx, lock))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Abort a txn: release its locks (with their versions from before the lock), and destroy it.
+     */
+    bool abort(Tx *tx)
+    {
+        for (const std::pair<VersionedLock *, int> &own : tx->held)
+        {
+            own.first->word.store(own.second, std::memory_order_release);
+        }
+
+        CmPolicy::on_abort();
+        delete tx;
+
+        return false;
+    }
+
+    size_t size_;
+    size_t align_;
+    void *start_;
+
+    ClockPolicy clock_;
+    LockMapPolicy locks_;
+
+    std::mutex segments_lock_;
+    std::vector<void *> segments_;
+};
+
+} // namespace stm
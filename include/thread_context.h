@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <tm_ext.h>
+
+#include "globals.h"
+#include "thread_records.h"
+#include "utils.h"
+
+/**
+ * @brief Context of a thread registered in a region (see tm_thread_enter), in the registry of the region. The txns
+ * the thread begins on the region run in the context: the txn and its sets are reused instead of being allocated.
+ * Only its thread writes it: the counters are updated with plain (relaxed) stores, and only read atomically by the
+ * other threads enumerating the registry.
+ *
+ */
+typedef struct thread_context
+{
+    thread_record_t record;
+    region_t *region;
+    _Atomic bool in_txn; // Whether the txn of the context is running
+
+    _Atomic uint64_t commits;
+    _Atomic uint64_t aborts;
+
+    read_set_t *read_set; // Kept (cleared) between the txns, and with the record once the thread exits
+    write_set_t *write_set;
+
+    cache_aligned txn_t txn;
+} thread_context_t;
+
+/**
+ * @brief Register the calling thread in a region: claim a context in the registry of the region, and bind it to the
+ * thread (in one of its THREAD_CONTEXT_SLOTS slots). Registering a registered thread again does nothing.
+ *
+ * @param region The shared memory region.
+ * @return true If the thread is registered.
+ * @return false If the thread has no slot left, or on allocation failure.
+ */
+bool thread_context_t_enter(region_t *region);
+
+/**
+ * @brief Unregister the calling thread from a region, releasing its context for the next thread to register.
+ *
+ * @param region The shared memory region.
+ */
+void thread_context_t_exit(region_t *region);
+
+/**
+ * @brief Get the context of the calling thread in a region, to begin a txn in it.
+ *
+ * @param region The shared memory region.
+ * @return thread_context_t* The context, NULL if the thread is not registered, or if its txn is already running.
+ */
+thread_context_t *thread_context_t_idle(region_t *region);
+
+/**
+ * @brief Mark the txn of a context as ended, clearing its sets for the next one.
+ *
+ * @param context The context.
+ * @param committed Whether the txn committed.
+ */
+void thread_context_t_end_txn(thread_context_t *context, bool committed);
+
+/**
+ * @brief Get the statistics of the threads registered in a region, while they keep running txns.
+ *
+ * @param region The shared memory region.
+ * @param stats Array receiving the statistics of each thread (may be NULL when max is 0).
+ * @param max Size of the array.
+ * @return size_t The number of registered threads (possibly more than max).
+ */
+size_t thread_context_t_report(region_t *region, tm_thread_stats_t *stats, size_t max);
+
+/**
+ * @brief Free the contexts of a region (with their sets), once no thread is registered in it.
+ *
+ * @param region The shared memory region.
+ */
+void thread_context_t_destroy_all(region_t *region);
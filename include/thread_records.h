@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "globals.h"
+
+#define THREAD_RECORDS_MAX_LISTS 8 // Lists a thread may hold a record of (one per diagnostics facility)
+
+/**
+ * @brief Header of a per-thread record (histograms, rings...), placed at the start of the record.
+ * Records are never freed (unless their list is, see thread_record_list_t_destroy): the record of an exited thread is
+ * reused by the next thread needing one, so that readers can walk the list at any time, and what it recorded stays visible.
+ *
+ */
+typedef struct thread_record
+{
+    struct thread_record *next;
+    _Atomic bool in_use;
+} thread_record_t;
+
+/**
+ * @brief Lock-free list of the records of a facility, e.g. a static one initialized with THREAD_RECORD_LIST_INIT.
+ *
+ */
+typedef struct thread_record_list
+{
+    _Atomic(thread_record_t *) head;
+    size_t record_size; // Size of the records, including the header
+} thread_record_list_t;
+
+#define THREAD_RECORD_LIST_INIT(type) {NULL, sizeof(type)}
+
+/**
+ * @brief Get a record for the calling thread: a released one is reused, else a zeroed one is pushed to the list.
+ * The record is released when the thread exits. Callers cache it in a thread-local variable.
+ *
+ * @param list The list to take the record from.
+ * @return thread_record_t* The record (cache aligned), NULL on allocation failure.
+ */
+thread_record_t *thread_record_list_t_acquire(thread_record_list_t *list);
+
+/**
+ * @brief Get the first record of a list, to walk it with the next fields (while records are being pushed).
+ *
+ * @param list The list.
+ * @return thread_record_t* The first record, NULL if the list is empty.
+ */
+thread_record_t *thread_record_list_t_first(thread_record_list_t *list);
+
+/**
+ * @brief Claim a record of a list for the calling thread, until it releases it explicitly (see thread_record_t_release):
+ * a released one is reused, else a zeroed one is pushed to the list.
+ *
+ * @param list The list to take the record from.
+ * @return thread_record_t* The record (cache aligned), NULL on allocation failure.
+ */
+thread_record_t *thread_record_list_t_claim(thread_record_list_t *list);
+
+/**
+ * @brief Release a claimed record, so that another thread may reuse it.
+ *
+ * @param record The record.
+ */
+void thread_record_t_release(thread_record_t *record);
+
+/**
+ * @brief Free the records of a list owned by an object (e.g. a region), once no thread uses them.
+ *
+ * @param list The list, left empty.
+ */
+void thread_record_list_t_destroy(thread_record_list_t *list);
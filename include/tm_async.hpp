@@ -0,0 +1,467 @@
+/**
+ * @file   tm_async.hpp
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * C++20 coroutine API on top of tm_begin/tm_read/tm_write/tm_end (requires -std=c++20, header-only).
+ * A read of a stripe locked by a committer suspends the coroutine until the stripe is released (or a timeout passes)
+ * instead of aborting, and the retries of aborted transactions are delayed by the scheduler (exponential backoff)
+ * instead of a busy loop, so that a worker thread runs its other coroutines in the meantime.
+ *
+ *   tm_async::Scheduler scheduler;  // One per worker thread
+ *   scheduler.spawn(tm_async::atomically(scheduler, shared, false, [&](tm_async::Tx &tx) -> tm_async::Task<bool> {
+ *       long value;
+ *       if (!co_await tx.read(addr, sizeof(value), &value)) co_return false; // Aborted: retried by atomically
+ *       value++;
+ *       co_return tx.write(&value, sizeof(value), addr);
+ *   }));
+ *   scheduler.run();
+ **/
+
+#pragma once
+
+#if __cplusplus < 202002L
+#error "tm_async.hpp requires C++20 (coroutines)"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+extern "C"
+{
+#include <tm.h>
+#include <tm_ext.h>
+}
+
+namespace tm_async
+{
+
+using Clock = std::chrono::steady_clock;
+
+// -------------------------------------------------------------------------- //
+
+namespace detail
+{
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            // Resume the awaiting coroutine (nothing, for a task spawned on the scheduler)
+            return handle.promise().continuation;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        // As the C interface, the transactions report their failures by their results
+        std::terminate();
+    }
+};
+
+template <class T>
+struct Promise : PromiseBase
+{
+    T value{};
+
+    void return_value(T result)
+    {
+        value = std::move(result);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+    void return_void() {}
+};
+
+} // namespace detail
+
+/**
+ * @brief Lazily started coroutine, run when awaited (or when spawned on a scheduler).
+ */
+template <class T = void>
+class Task
+{
+public:
+    struct promise_type : detail::Promise<T>
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void_v<T>)
+        {
+            return std::move(handle_.promise().value);
+        }
+    }
+
+    /**
+     * @brief Give up the ownership of the coroutine (to a scheduler).
+     */
+    std::coroutine_handle<promise_type> release()
+    {
+        return std::exchange(handle_, {});
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * @brief Single-threaded scheduler of the coroutines of a worker thread: runs the ready coroutines, and wakes the
+ * suspended ones when the stripe they wait on is released, or when their deadline passes.
+ */
+class Scheduler
+{
+public:
+    /**
+     * @param stripe_timeout Longest suspension on a locked stripe (the read then proceeds, and aborts if still locked).
+     * @param max_backoff Longest delay before retrying an aborted transaction.
+     */
+    explicit Scheduler(std::chrono::nanoseconds stripe_timeout = std::chrono::microseconds(100),
+                       std::chrono::nanoseconds max_backoff = std::chrono::microseconds(500))
+        : stripe_timeout_(stripe_timeout), max_backoff_(max_backoff) {}
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    ~Scheduler()
+    {
+        for (std::coroutine_handle<> root : roots_)
+        {
+            root.destroy();
+        }
+    }
+
+    /**
+     * @brief Start a coroutine (at the next run), owned by the scheduler until it completes.
+     */
+    void spawn(Task<void> task)
+    {
+        std::coroutine_handle<> handle = task.release();
+        roots_.push_back(handle);
+        ready_.push_back(handle);
+    }
+
+    /**
+     * @brief Run the coroutines until they all complete.
+     */
+    void run()
+    {
+        while (!roots_.empty())
+        {
+            // Only the coroutines ready at the start of the round: the ones yielding meanwhile wait for the next one,
+            // after the waiters are woken
+            for (size_t round = ready_.size(); round > 0; round--)
+            {
+                std::coroutine_handle<> handle = ready_.front();
+                ready_.pop_front();
+                handle.resume();
+            }
+
+            wake_waiters();
+
+            roots_.erase(std::remove_if(roots_.begin(), roots_.end(), [](std::coroutine_handle<> root) {
+                             if (!root.done())
+                             {
+                                 return false;
+                             }
+                             root.destroy();
+                             return true;
+                         }),
+                         roots_.end());
+
+            if (ready_.empty() && !waiters_.empty())
+            {
+                // Every coroutine waits: let the committers holding the stripes run
+                relax();
+            }
+        }
+    }
+
+    /**
+     * @brief Awaitable suspending the coroutine until the stripe of a word is released (or until the stripe timeout).
+     */
+    auto until_unlocked(shared_t shared, const void *word)
+    {
+        return Suspend{*this, shared, word, Clock::now() + stripe_timeout_};
+    }
+
+    /**
+     * @brief Awaitable suspending the coroutine behind the coroutines ready to run (e.g. inside a long transaction, so
+     * that the transactions of the other coroutines make progress meanwhile).
+     */
+    auto yield()
+    {
+        struct Yield
+        {
+            Scheduler &scheduler;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                scheduler.ready_.push_back(handle);
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        return Yield{*this};
+    }
+
+    /**
+     * @brief Awaitable suspending the coroutine for the (randomized) backoff of its attempt-th retry.
+     */
+    auto backoff(unsigned attempt)
+    {
+        int64_t limit = std::chrono::nanoseconds(std::chrono::microseconds(1)).count() << std::min(attempt, 20u);
+        limit = std::min<int64_t>(limit, max_backoff_.count());
+
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 7;
+        seed_ ^= seed_ << 17;
+
+        return Suspend{*this, invalid_shared, nullptr, Clock::now() + std::chrono::nanoseconds(seed_ % (uint64_t)limit + 1)};
+    }
+
+private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        shared_t shared;
+        const void *word; // Woken when its stripe is released, or at the deadline (nullptr: only at the deadline)
+        Clock::time_point deadline;
+    };
+
+    struct Suspend
+    {
+        Scheduler &scheduler;
+        shared_t shared;
+        const void *word;
+        Clock::time_point deadline;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            scheduler.waiters_.push_back(Waiter{handle, shared, word, deadline});
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    void wake_waiters()
+    {
+        if (waiters_.empty())
+        {
+            return;
+        }
+
+        Clock::time_point now = Clock::now();
+        size_t kept = 0;
+        for (const Waiter &waiter : waiters_)
+        {
+            bool released = waiter.word && !tm_locked_word(waiter.shared, waiter.word, tm_align(waiter.shared));
+            if (released || now >= waiter.deadline)
+            {
+                ready_.push_back(waiter.handle);
+            }
+            else
+            {
+                waiters_[kept++] = waiter;
+            }
+        }
+        waiters_.resize(kept);
+    }
+
+    static void relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    std::chrono::nanoseconds stripe_timeout_;
+    std::chrono::nanoseconds max_backoff_;
+    uint64_t seed_ = 0x9e3779b97f4a7c15ull;
+
+    std::deque<std::coroutine_handle<>> ready_;
+    std::vector<Waiter> waiters_;
+    std::vector<std::coroutine_handle<>> roots_;
+};
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * @brief A running transaction, as seen by the body of atomically. Same contract as tm.h: once an access returns
+ * false, the transaction was aborted (and destroyed), and the body must return false.
+ */
+class Tx
+{
+public:
+    Tx(Scheduler &scheduler, shared_t shared, tx_t tx) : scheduler_(scheduler), shared_(shared), tx_(tx) {}
+
+    /**
+     * @brief Awaitable tm_read, suspending the coroutine while a stripe of the range is locked.
+     */
+    auto read(const void *source, size_t size, void *target)
+    {
+        struct Read
+        {
+            Tx &tx;
+            const void *source;
+            size_t size;
+            void *target;
+            const void *locked = nullptr;
+
+            bool await_ready()
+            {
+                locked = tm_locked_word(tx.shared_, source, size);
+                return locked == nullptr;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                tx.scheduler_.until_unlocked(tx.shared_, locked).await_suspend(handle);
+            }
+
+            bool await_resume()
+            {
+                // A stripe locked since the check (or still locked after the timeout) aborts the txn, as tm_read does
+                return tm_read(tx.shared_, tx.tx_, source, size, target);
+            }
+        };
+
+        return Read{*this, source, size, target};
+    }
+
+    /**
+     * @brief tm_write (which never waits: the writes are buffered until the commit).
+     */
+    bool write(const void *source, size_t size, void *target)
+    {
+        return tm_write(shared_, tx_, source, size, target);
+    }
+
+    alloc_t alloc(size_t size, void **target)
+    {
+        return tm_alloc(shared_, tx_, size, target);
+    }
+
+    bool free(void *target)
+    {
+        return tm_free(shared_, tx_, target);
+    }
+
+    shared_t shared() const
+    {
+        return shared_;
+    }
+
+    tx_t id() const
+    {
+        return tx_;
+    }
+
+private:
+    Scheduler &scheduler_;
+    shared_t shared_;
+    tx_t tx_;
+};
+
+/**
+ * @brief Run a transaction until it commits: body(Tx&) is a coroutine returning Task<bool>, false iff one of its
+ * accesses aborted the transaction (it may run several times, like any retried transaction body). The retries are
+ * delayed by the backoff of the scheduler, which runs its other coroutines meanwhile.
+ */
+template <class Body>
+Task<void> atomically(Scheduler &scheduler, shared_t shared, bool is_ro, Body body)
+{
+    for (unsigned attempt = 0;; attempt++)
+    {
+        tx_t tx = tm_begin(shared, is_ro);
+        if (tx != invalid_tx)
+        {
+            Tx transaction(scheduler, shared, tx);
+            if (co_await body(transaction) && tm_end(shared, tx))
+            {
+                co_return;
+            }
+        }
+
+        co_await scheduler.backoff(attempt);
+    }
+}
+
+} // namespace tm_async
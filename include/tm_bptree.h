@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "tm_ds.h"
+
+#define TM_BPTREE_ORDER 16 // Children per inner node (and values per leaf, minus one)
+
+/**
+ * @brief Transactional B+-tree from words to words, ordered by (unsigned) key.
+ *
+ * Layout (in words):
+ *  - header: [root]
+ *  - node: [is leaf, key count, next leaf, keys[TM_BPTREE_ORDER - 1], slots[TM_BPTREE_ORDER]]
+ *    (slots hold the values of a leaf, or the children of an inner node)
+ *
+ * A lookup reads the header and the keys of each node on the path, plus a single slot per node.
+ * Full nodes are split on the way down, so an insertion never walks back up the tree.
+ * The tree only ever grows: removal does not merge or rebalance underfull nodes (leaves may become empty and stay in
+ * the chain of leaves), so the height and the nodes of a tree never shrink, and its memory is only reclaimed with the
+ * region. Trees whose keys churn keep the size of their largest key set.
+ *
+ * Operations returning false (or abort_alloc) have aborted the transaction, like tm_read/tm_write.
+ */
+typedef void *tm_bptree_t;
+
+/**
+ * @brief Create an empty B+-tree.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param tree Pointer receiving the tree.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_bptree_create(shared_t shared, tx_t tx, tm_bptree_t *tree);
+
+/**
+ * @brief Look a key up.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param tree The tree.
+ * @param key The key to look up.
+ * @param value Pointer receiving the value (when found).
+ * @param found Pointer receiving whether the key is in the tree.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_bptree_get(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, tm_ds_word_t *value, bool *found);
+
+/**
+ * @brief Insert a key, or update its value if it is already in the tree.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param tree The tree.
+ * @param key The key to insert.
+ * @param value The value of the key.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_bptree_put(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, tm_ds_word_t value);
+
+/**
+ * @brief Remove a key (its leaf is not merged, even if it becomes empty).
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param tree The tree.
+ * @param key The key to remove.
+ * @param removed Pointer receiving whether the key was in the tree.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_bptree_remove(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, bool *removed);
+
+/**
+ * @brief Read the entries with a key greater or equal to a given key, in order, following the chain of leaves.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param tree The tree.
+ * @param from The smallest key to return.
+ * @param max The maximum number of entries to return.
+ * @param keys Buffer receiving the keys (max words).
+ * @param values Buffer receiving the values (max words).
+ * @param count Pointer receiving the number of entries returned.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_bptree_scan(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t from, size_t max, tm_ds_word_t *keys, tm_ds_word_t *values, size_t *count);
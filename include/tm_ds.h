@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tm.h>
+
+/**
+ * @brief Word of a transactional data structure. Every field of the containers (keys, values, pointers, counters)
+ * is one word, so that nodes are read and written with a single tm_read/tm_write of consecutive words.
+ *
+ */
+typedef uintptr_t tm_ds_word_t;
+
+#define TM_DS_WORD_SIZE sizeof(tm_ds_word_t)
+
+/**
+ * @brief Check whether a region can hold the transactional data structures (its alignment must divide the word size).
+ *
+ * @param shared The shared memory region.
+ * @return true If the containers can be used on the region.
+ * @return false Otherwise.
+ */
+bool tm_ds_supported(shared_t shared);
+
+/**
+ * @brief Read consecutive words of the shared memory region.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param addr The address of the first word.
+ * @param words The number of words to read.
+ * @param out The (private) buffer receiving the words.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_ds_read(shared_t shared, tx_t tx, const void *addr, size_t words, tm_ds_word_t *out);
+
+/**
+ * @brief Write consecutive words of the shared memory region.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param addr The address of the first word.
+ * @param words The number of words to write.
+ * @param in The (private) buffer holding the words.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_ds_write(shared_t shared, tx_t tx, void *addr, size_t words, const tm_ds_word_t *in);
+
+/**
+ * @brief Get the address of a word of a node.
+ *
+ * @param node The address of the node.
+ * @param index The index of the word in the node.
+ * @return void* The address of the word.
+ */
+static inline void *tm_ds_field(const void *node, size_t index)
+{
+    return (char *)node + index * TM_DS_WORD_SIZE;
+}
+
+/**
+ * @brief Allocate a node, reusing a node from a free list when there is one.
+ * A reused node keeps its previous content: the caller must initialize every word of the node.
+ * tm_free does not give memory back before the region is destroyed, so the containers keep their freed nodes
+ * in per-size free lists instead. A freed node may still be read by concurrent transactions holding a stale pointer:
+ * this is safe, since the node is only modified through transactional writes (its memory is type-stable).
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param free_list The address of the word holding the head of the free list of nodes of this size.
+ * @param words The size of the node, in words (all the nodes of a free list must have the same size).
+ * @param node Pointer receiving the address of the node.
+ * @return alloc_t success_alloc, abort_alloc (the transaction was aborted) or nomem_alloc.
+ */
+alloc_t tm_ds_alloc_node(shared_t shared, tx_t tx, void *free_list, size_t words, void **node);
+
+/**
+ * @brief Push a node to a free list. The first word of the node is used as the link of the list.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param free_list The address of the word holding the head of the free list.
+ * @param node The node to free.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_ds_free_node(shared_t shared, tx_t tx, void *free_list, void *node);
+
+/**
+ * @brief Hash a key (splitmix64 finalizer).
+ *
+ * @param key The key to hash.
+ * @return tm_ds_word_t The hash of the key.
+ */
+tm_ds_word_t tm_ds_hash(tm_ds_word_t key);
@@ -0,0 +1,148 @@
+/**
+ * @file   tm_ext.h
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Extensions of the transaction manager interface declared in tm.h (which is kept unmodified).
+ **/
+
+#pragma once
+
+#include <tm.h>
+
+// -------------------------------------------------------------------------- //
+
+/** A logical transaction of a batch: runs the accesses of the transaction in the given (running) txn.
+ * Returns false iff one of its tm_* calls aborted the txn. May run several times, like any retried txn body.
+ **/
+typedef bool (*tm_batch_op_t)(shared_t, tx_t, void*);
+
+typedef struct tm_batch_entry {
+    tm_batch_op_t op;
+    void*         arg;
+} tm_batch_entry_t;
+
+/** Latency histograms, recorded per thread when LATENCY_HISTOGRAMS is set (see globals.h). The durations are in nanoseconds
+ * (TSC ticks with LATENCY_USE_RDTSC). Bucket b counts the values in [tm_latency_bucket_value(b), tm_latency_bucket_value(b + 1)).
+ **/
+#define TM_LATENCY_SUB_BITS 3 // Each power of two is split in 2^3 buckets (12.5% relative precision)
+#define TM_LATENCY_BUCKETS  ((64 - TM_LATENCY_SUB_BITS + 1) << TM_LATENCY_SUB_BITS)
+
+typedef enum tm_latency_kind {
+    tm_latency_commit,    // tm_begin to tm_end, committed txns
+    tm_latency_abort,     // tm_begin to the abort, aborted txns
+    tm_latency_lock,      // Commit phase: locking the write set
+    tm_latency_validate,  // Commit phase: validating the read set
+    tm_latency_writeback, // Commit phase: writing back the write set and releasing the locks
+    tm_latency_retries,   // Aborts of the thread before each commit (retries of a logical transaction)
+    tm_latency_kinds
+} tm_latency_kind_t;
+
+typedef struct tm_latency_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[TM_LATENCY_BUCKETS];
+} tm_latency_histogram_t;
+
+/** Stripe on which sampled aborts happened, from the conflict profiler (compiled in with CONFLICT_PROFILER, see globals.h).
+ **/
+typedef struct tm_conflict_hotspot {
+    size_t   stripe;  // Lock stripe of the region (index in the lock table, or block with co-located locks)
+    uint64_t aborts;  // Sampled aborts on the stripe
+    void*    address; // A sampled word of the stripe
+    void*    segment; // Segment holding the word (as returned by tm_start or tm_alloc)
+    size_t   offset;  // Offset of the word in the segment
+} tm_conflict_hotspot_t;
+
+/** Hardware counters of the STM phases, per thread (compiled in with PERF_COUNTERS, see globals.h).
+ * A counter the kernel or the CPU does not provide stays at 0.
+ **/
+typedef enum tm_perf_phase {
+    tm_perf_read,      // tm_read and tm_read_in_place (with the pre/post validations)
+    tm_perf_write,     // tm_write (write-set inserts)
+    tm_perf_lock,      // Commit: locking the write set
+    tm_perf_validate,  // Commit: validating the read set
+    tm_perf_writeback, // Commit: writing back the write set and releasing the locks
+    tm_perf_phases
+} tm_perf_phase_t;
+
+typedef enum tm_perf_event {
+    tm_perf_cycles,
+    tm_perf_llc_misses,  // Last-level cache read misses
+    tm_perf_dtlb_misses, // Data TLB read misses
+    tm_perf_events
+} tm_perf_event_t;
+
+typedef struct tm_perf_counters {
+    uint64_t calls;                  // Times the phase ran
+    uint64_t counts[tm_perf_events]; // Events counted during the phase
+} tm_perf_counters_t;
+
+/** Memory held by a shared memory region, in bytes (see tm_memory_stats).
+ **/
+typedef struct tm_memory_stats {
+    size_t region;        // Metadata of the region (without its lock table)
+    size_t lock_table;    // Lock table (reserved: its pages are only resident once their stripes are used)
+    size_t first_segment; // First segment (with its co-located locks, if any)
+    size_t segments;      // Live segments of tm_alloc and its variants (and of a checkpoint), with their headers
+    size_t segment_count; // Number of such segments
+    size_t sets;          // Read and write sets of the running txns and of the thread contexts (with MEMORY_ACCOUNTING, by chunks of MEMORY_ACCOUNTING_CHUNK bytes per set)
+    size_t sets_peak;     // Highest value of sets since the region was created
+} tm_memory_stats_t;
+
+typedef enum tm_memory_kind {
+    tm_memory_segments, // Segments (limit on tm_memory_stats_t.segments)
+    tm_memory_sets      // Read and write sets (limit on tm_memory_stats_t.sets)
+} tm_memory_kind_t;
+
+/** Called when the memory of a kind crosses its soft limit (see tm_memory_limits), by the thread whose allocation crossed it,
+ * during its tm_* call: it must not run transactions on the region. Called again only once the memory went back under the limit.
+ **/
+typedef void (*tm_memory_callback_t)(shared_t, tm_memory_kind_t, tm_memory_stats_t const*, void*);
+
+/** Statistics of a thread registered in a region with tm_thread_enter (see tm_thread_contexts).
+ **/
+typedef struct tm_thread_stats {
+    uint64_t commits; // Txns committed in the context of the thread since it registered
+    uint64_t aborts;  // Txns aborted in the context of the thread since it registered
+    bool     in_txn;  // Whether the thread is running a txn in its context
+} tm_thread_stats_t;
+
+// -------------------------------------------------------------------------- //
+
+shared_t tm_create_durable(char const*, size_t, size_t);
+int      tm_durability_error(shared_t);
+shared_t tm_create_from_checkpoint(char const*);
+bool     tm_checkpoint(shared_t, char const*);
+void*    tm_recovered_address(shared_t, void const*);
+bool     tm_batch(shared_t, tm_batch_entry_t const*, size_t, size_t*);
+bool     tm_read_in_place(shared_t, tx_t, void const*, size_t, void const**);
+bool     tm_validate(shared_t, tx_t);
+bool     tm_read_unvalidated(shared_t, tx_t, void const*, size_t, void*);
+void     tm_release(shared_t, tx_t, void const*, size_t);
+bool     tm_write_borrowed(shared_t, tx_t, void const*, size_t, void*);
+bool     tm_copy_buffered(shared_t, tx_t, void*, void const*, size_t);
+bool     tm_fill(shared_t, tx_t, void*, uint8_t, size_t);
+void*    tm_locked_word(shared_t, void const*, size_t);
+shared_t tm_create_shared(char const*, size_t, size_t, size_t);
+shared_t tm_attach_shared(char const*);
+bool     tm_unlink_shared(char const*);
+tx_t     tm_begin_in_shard(shared_t, bool, size_t);
+alloc_t  tm_alloc_in_shard(shared_t, tx_t, size_t, size_t, void**);
+shared_t tm_create_objects(size_t, size_t, size_t);
+alloc_t  tm_alloc_objects(shared_t, tx_t, size_t, size_t, void**);
+bool     tm_latency_snapshot(tm_latency_histogram_t*);
+uint64_t tm_latency_bucket_value(size_t);
+uint64_t tm_latency_percentile(tm_latency_histogram_t const*, double);
+size_t   tm_conflict_report(shared_t, tm_conflict_hotspot_t*, size_t);
+bool     tm_trace_dump(char const*);
+bool     tm_perf_thread_counters(tm_perf_counters_t*);
+bool     tm_perf_counters(tm_perf_counters_t*);
+void     tm_perf_print(tm_perf_counters_t const*);
+bool     tm_memory_stats(shared_t, tm_memory_stats_t*);
+bool     tm_memory_limits(shared_t, size_t, size_t, tm_memory_callback_t, void*);
+bool     tm_thread_enter(shared_t);
+void     tm_thread_exit(shared_t);
+size_t   tm_thread_contexts(shared_t, tm_thread_stats_t*, size_t);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "tm_ds.h"
+
+#define TM_HASHMAP_COUNTERS 8          // Element counters, striped by key hash so that inserts do not all conflict
+#define TM_HASHMAP_STRIDE 8            // Words between two counters (a cache line), so that they never share a lock
+#define TM_HASHMAP_LOAD_FACTOR 2       // Average chain length that triggers a resize
+#define TM_HASHMAP_MIN_BUCKETS 16
+
+/**
+ * @brief Transactional hash map from words to words, with separate chaining.
+ *
+ * Layout (in words):
+ *  - header: [buckets, bucket count, free list, padding...] then TM_HASHMAP_COUNTERS counters, one per cache line
+ *  - buckets: array of node pointers
+ *  - node: [next, key, value]
+ *
+ * A lookup reads the bucket pointer, the bucket count, one bucket and the nodes of one chain.
+ * An insertion additionally writes one bucket (or one value) and one striped counter. The table doubles in size
+ * when the counter of a stripe shows that the average chain is longer than TM_HASHMAP_LOAD_FACTOR.
+ *
+ * Every operation takes a running transaction. Operations returning false (or abort_alloc) have aborted the
+ * transaction, exactly like tm_read/tm_write, and the caller must retry with a new transaction.
+ */
+typedef void *tm_hashmap_t;
+
+/**
+ * @brief Create an empty hash map.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param buckets The initial number of buckets (rounded up to a power of 2).
+ * @param map Pointer receiving the hash map.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_hashmap_create(shared_t shared, tx_t tx, size_t buckets, tm_hashmap_t *map);
+
+/**
+ * @brief Look a key up.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param map The hash map.
+ * @param key The key to look up.
+ * @param value Pointer receiving the value (when found).
+ * @param found Pointer receiving whether the key is in the map.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_hashmap_get(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, tm_ds_word_t *value, bool *found);
+
+/**
+ * @brief Insert a key, or update its value if it is already in the map.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param map The hash map.
+ * @param key The key to insert.
+ * @param value The value of the key.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_hashmap_put(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, tm_ds_word_t value);
+
+/**
+ * @brief Remove a key. Its node is kept for reuse by later insertions.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param map The hash map.
+ * @param key The key to remove.
+ * @param removed Pointer receiving whether the key was in the map.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_hashmap_remove(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, bool *removed);
@@ -0,0 +1,134 @@
+/**
+ * @file   tm_inline.h
+ * @author Emmanouil (Manos) Chatzakis
+ *
+ * @section DESCRIPTION
+ *
+ * Inlinable fast paths of tm_read and tm_write, for the applications linked with the static library (make static or
+ * make lto). The per-word loop runs in the caller; the rare cases (locked stripe, newer version, diagnostics) are left
+ * to tm_read and tm_write. The application must be compiled with the flags of globals.h the library was built with.
+ * bench/inline.c measures both paths against the shared, static and LTO libraries.
+ **/
+
+#pragma once
+
+#include <string.h>
+
+#include <tm.h>
+
+#include "utils.h"
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * @brief Read a word without waiting nor aborting.
+ *
+ * @return true If the word was read (and added to the read set of a write txn).
+ * @return false If the word needs the slow path of tm_read (which may wait, abort or exit).
+ */
+static inline bool tm_inline_read_word(region_t *region, txn_t *txn, void *word_addr, void *targ_addr)
+{
+    if (!txn->is_ro && txn->write_set->head != NULL)
+    {
+        void *val = set_t_get_val_or_null(txn->write_set, word_addr);
+        if (val != NULL)
+        {
+            memcpy(targ_addr, val, region->align);
+            return true;
+        }
+    }
+
+    versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, word_addr);
+    size_t shard = utils_shard_of(region, word_addr);
+
+    // Pre-validate the lock: free, and not newer than rv
+    int l = versioned_write_spinlock_t_load(vws);
+    if (unlikely((l & 0x1) || (l >> 1) > txn->rv[shard]))
+    {
+        return false;
+    }
+
+    memcpy(targ_addr, word_addr, region->align);
+
+    // Post-validate the lock: unchanged
+    if (unlikely(versioned_write_spinlock_t_load(vws) != l))
+    {
+        return false;
+    }
+
+    if (!txn->is_ro)
+    {
+        if (unlikely(!read_set_t_add(txn->read_set, utils_read_set_entry(region, vws), word_addr)))
+        {
+            return false;
+        }
+        txn->read_shards |= 1u << shard;
+    }
+
+    return true;
+}
+
+/** [thread-safe] Same as tm_read, inlined in the caller.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue
+ **/
+static inline bool tm_read_inline(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    if (PERF_COUNTERS)
+    {
+        // The counters measure whole calls of tm_read
+        return tm_read(shared, tx, source, size, target);
+    }
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        void *word_addr = utils_translate(region, (char const *)source + i);
+
+        if (unlikely(!tm_inline_read_word(region, txn, word_addr, (char *)target + i)))
+        {
+            // The words before were read: tm_read goes on from this one
+            return tm_read(shared, tx, (char const *)source + i, size - i, (char *)target + i);
+        }
+    }
+
+    return true;
+}
+
+/** [thread-safe] Same as tm_write, inlined in the caller.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+ **/
+static inline bool tm_write_inline(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    if (PERF_COUNTERS)
+    {
+        return tm_write(shared, tx, source, size, target);
+    }
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        void *word_addr = utils_translate(region, (char *)target + i);
+
+        if (unlikely(!set_t_add_or_update(txn->write_set, word_addr, (char *)source + i, region->align)))
+        {
+            // Out of memory: tm_write reports it
+            return tm_write(shared, tx, (char const *)source + i, size - i, (char *)target + i);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "tm_ds.h"
+
+#define TM_QUEUE_STRIDE 8 // Words between the head and the tail (a cache line), so that they never share a lock
+
+/**
+ * @brief Transactional FIFO queue of words.
+ *
+ * Layout (in words):
+ *  - header: [head, dequeuers' free list, padding..., tail, enqueuers' free list, padding...]
+ *  - node: [next, value]
+ *
+ * The head always points to a sentinel node, whose successor holds the first value. A dequeue frees the old sentinel
+ * to the dequeuers' free list, and an enqueue reuses a node of the enqueuers' free list: when it is empty, the
+ * enqueuer takes the whole dequeuers' list at once. Enqueuers thus only write the tail, the last node and their free
+ * list, and dequeuers only write the head and their free list, so the two ends only conflict when the queue is empty
+ * and once per batch of nodes handed over from the dequeuers to the enqueuers.
+ *
+ * Operations returning false (or abort_alloc) have aborted the transaction, like tm_read/tm_write.
+ */
+typedef void *tm_queue_t;
+
+/**
+ * @brief Create an empty queue.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param queue Pointer receiving the queue.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_queue_create(shared_t shared, tx_t tx, tm_queue_t *queue);
+
+/**
+ * @brief Append a value at the tail of the queue.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param queue The queue.
+ * @param value The value to append.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_queue_enqueue(shared_t shared, tx_t tx, tm_queue_t queue, tm_ds_word_t value);
+
+/**
+ * @brief Remove the value at the head of the queue.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param queue The queue.
+ * @param value Pointer receiving the value (when the queue was not empty).
+ * @param found Pointer receiving whether the queue was not empty.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_queue_dequeue(shared_t shared, tx_t tx, tm_queue_t queue, tm_ds_word_t *value, bool *found);
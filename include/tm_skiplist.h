@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "tm_ds.h"
+
+#define TM_SKIPLIST_MAX_HEIGHT 16
+
+/**
+ * @brief Transactional skiplist from words to words, ordered by (unsigned) key.
+ *
+ * Layout (in words):
+ *  - header: [head tower (TM_SKIPLIST_MAX_HEIGHT next pointers), one free list per height]
+ *  - node: [key, value, height, next[height]]
+ *
+ * Nodes are sized to their height, so a traversal reads the key and a single next pointer per visited node
+ * and an insertion only writes the new node and its predecessors at each of its levels.
+ * Heights are drawn from a thread-local generator, so concurrent insertions do not share any state.
+ *
+ * Operations returning false (or abort_alloc) have aborted the transaction, like tm_read/tm_write.
+ */
+typedef void *tm_skiplist_t;
+
+/**
+ * @brief Create an empty skiplist.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param list Pointer receiving the skiplist.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_skiplist_create(shared_t shared, tx_t tx, tm_skiplist_t *list);
+
+/**
+ * @brief Look a key up.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param list The skiplist.
+ * @param key The key to look up.
+ * @param value Pointer receiving the value (when found).
+ * @param found Pointer receiving whether the key is in the skiplist.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_skiplist_get(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, tm_ds_word_t *value, bool *found);
+
+/**
+ * @brief Insert a key, or update its value if it is already in the skiplist.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param list The skiplist.
+ * @param key The key to insert.
+ * @param value The value of the key.
+ * @return alloc_t success_alloc, abort_alloc or nomem_alloc.
+ */
+alloc_t tm_skiplist_put(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, tm_ds_word_t value);
+
+/**
+ * @brief Remove a key. Its node is kept for reuse by later insertions of the same height.
+ *
+ * @param shared The shared memory region.
+ * @param tx The transaction to use.
+ * @param list The skiplist.
+ * @param key The key to remove.
+ * @param removed Pointer receiving whether the key was in the skiplist.
+ * @return true If the transaction can continue.
+ * @return false If the transaction was aborted.
+ */
+bool tm_skiplist_remove(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, bool *removed);
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <tm.h>
+#include <tm_ext.h>
 #include "macros.h"
 
 #include "globals.h"
 #include "locks.h"
+#include "mem.h"
+#include "thread_records.h"
 
 /**
  * @brief Segment of dynamically allocated memory.
@@ -14,25 +17,98 @@ typedef struct segment
 {
     struct segment *prev;
     struct segment *next;
+
+    size_t size; // Size of the segment data, which starts at the next multiple of the alignment after this header
 } segment_t;
 
 typedef segment_t *segment_list;
 
+/**
+ * @brief Range of a segment that was restored (from a redo log or a checkpoint) at a new address.
+ *
+ */
+typedef struct segment_range
+{
+    uintptr_t old_start;
+    size_t size;
+    char *new_start;
+} segment_range_t;
+
+struct redo_log;
+struct shm_region_header;
+
+#if COLOCATED_LOCKS && DURABLE_REDO_LOG
+#error The redo log does not support the co-located lock layout
+#endif
+
+#if REGION_SHARDS > 1 && COLOCATED_LOCKS
+#error Sharded clock domains do not support the co-located lock layout
+#endif
+
+#if REGION_SHARDS < 1 || REGION_SHARDS > 32
+#error REGION_SHARDS must be between 1 and 32 (shards are tracked in 32-bit masks)
+#endif
+
+// With co-located locks, the locks live in the segments and the table of the region is not used
+#define REGION_LOCK_TABLE_SIZE (COLOCATED_LOCKS ? 1 : VWSL_NUM)
+
 
 /**
  * @brief Struct representing a transactional shared-memory region.
  *
+ * Fields are grouped by access pattern, each group starting on its own cache line:
+ * the read-mostly fields used by every access, the clocks written by the committers (padded by their type),
+ * the segment list written by tm_alloc, the memory accounts and thread registry, the cold fields, and finally the lock table.
  */
 typedef struct region
 {
-    global_versioned_clock_t global_versioned_clock;
-    versioned_write_spinlock_t versioned_write_spinlock[VWSL_NUM];
-    def_lock_t segment_list_lock;
-
-    void *start;
+    // Read-mostly: read by every tm_read/tm_write, written only by tm_create
+    cache_aligned void *start;
 
     size_t size;
     size_t align;
 
+    // Co-located layout (only used when COLOCATED_LOCKS is enabled)
+    size_t colocated_block_size;      // Bytes per block: one lock slot followed by data words
+    size_t colocated_lock_slot;       // Bytes reserved for the lock at the start of each block
+    size_t colocated_words_per_block; // Data words per block
+    void **segment_directory[COLOCATED_DIRECTORY_SIZE]; // Segment id -> (block-aligned) segment base
+
+    struct redo_log *redo_log; // NULL unless the region was created by tm_create_durable
+
+    char *shard_arena; // Address space of the shards > 0, each SHARD_ARENA_SHIFT bits wide (NULL with a single shard)
+    char *object_arena;        // Address space of the object segments, OBJECT_ARENA_SHIFT bits wide per block size (NULL if none)
+    size_t object_arena_size;  // Bytes reserved for the object segments (0 if none)
+
+    // Written by the committers (of each shard): each clock is alone on its cache line
+    global_versioned_clock_t global_versioned_clock[REGION_SHARDS];
+
+    // Written by tm_alloc
+    def_lock_t segment_list_lock;
     segment_list allocs;
+    size_t segment_count; // Number of segment ids handed out (id 0 is invalid, id 1 is the first segment)
+    _Atomic size_t shard_arena_used[REGION_SHARDS]; // Bytes handed out in the arena of each shard > 0
+    _Atomic size_t object_arena_used[OBJECT_CLASSES]; // Bytes handed out in the arena of each object block size
+
+    // Memory accounting (see tm_memory_stats): written by tm_alloc, and by the txns whose sets grow by a chunk
+    cache_aligned mem_account_t segment_account;
+    mem_account_t set_account;
+    tm_memory_callback_t memory_callback; // Called when an account crosses its soft limit (NULL: none)
+    void *memory_callback_arg;
+
+    thread_record_list_t thread_contexts; // Registry of the contexts of the threads (see thread_context.h)
+
+    // Cold: only used when the region is created or destroyed
+    cache_aligned segment_range_t *recovered; // Segments restored at new addresses, with their addresses before the restart
+    size_t recovered_count;
+
+    void *checkpoint_map; // Mapping of the checkpoint the region was created from (NULL if none)
+    size_t checkpoint_map_size;
+
+    struct shm_region_header *shm; // Shared-memory object holding the region (NULL for a process-private region)
+
+    mem_kind_t region_mem_kind; // How this struct (and thus the lock table) was allocated
+    mem_kind_t start_mem_kind;  // How the first segment was allocated
+
+    cache_aligned versioned_write_spinlock_t versioned_write_spinlock[REGION_LOCK_TABLE_SIZE];
 } region_t;
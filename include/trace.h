@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "globals.h"
+
+/**
+ * @brief Events of the trace. Each one carries the txn and an argument (see the comments).
+ *
+ */
+typedef enum trace_event_type
+{
+    TRACE_BEGIN,             // Txn began (arg: is_ro)
+    TRACE_READ_ABORT,        // A read aborted the txn (arg: address of the word)
+    TRACE_COMMIT_START,      // Commit of a write txn started
+    TRACE_LOCK_ACQUIRED,     // The write set is locked
+    TRACE_LOCK_FAILED,       // A lock of the write set was taken by another txn
+    TRACE_VALIDATED,         // The read set is valid
+    TRACE_VALIDATION_FAILED, // The read set is not valid
+    TRACE_WRITEBACK_DONE,    // The write set is written back and unlocked
+    TRACE_COMMIT_END,        // Commit of a write txn ended (arg: whether it committed)
+    TRACE_END,               // Txn ended (arg: whether it committed)
+    TRACE_EVENT_TYPES
+} trace_event_type_t;
+
+/**
+ * @brief Log an event in the ring of the calling thread (the oldest events are overwritten). Lock-free and without stdio.
+ *
+ * @param type The type of the event.
+ * @param tx The txn of the event.
+ * @param arg The argument of the event.
+ */
+void trace_t_event(trace_event_type_t type, const void *tx, uint64_t arg);
+
+/**
+ * @brief Write the events of the rings of every thread to a file, as a Chrome trace (JSON, for chrome://tracing or Perfetto).
+ * Txns are async spans (by txn), commits are spans on the thread, the other events are instants.
+ * The threads keep logging: the events overwritten while they are copied are dropped.
+ *
+ * @param path The path of the file.
+ * @return true If the file was written.
+ * @return false Otherwise.
+ */
+bool trace_t_dump(const char *path);
@@ -12,28 +12,39 @@
 
 /**
  * @brief Structure representing a transaction.
+ * Descriptors are cache-line aligned, so that the descriptors of different threads never share a cache line.
  * 
  */
 typedef struct txn
 {
-    bool is_ro;
+    cache_aligned bool is_ro;
+    bool read_in_place; // Ranges were read in place: they must be validated at the end, even by read-only txns
 
     read_set_t *read_set;
     write_set_t *write_set;
 
-    int rv;
-    int wv;
+    int shard;             // The only shard the txn may access, -1 for all of them
+    unsigned read_shards;  // Mask of the shards read by the txn (write txns only)
+    int rv[REGION_SHARDS]; // Read version of each shard (-1 for the shards the txn may not access)
+    int wv[REGION_SHARDS]; // Write version of each shard written by the txn
+
+    uint64_t begin_time; // With LATENCY_HISTOGRAMS: when the txn began
+    bool committed;      // Whether the txn is destroyed after committing, or after aborting (for the diagnostics)
+
+    struct thread_context *context; // Context of the thread the txn runs in (NULL: the txn and its sets are allocated)
+    void *block;                    // Block the txn is allocated in (unless it runs in a context)
 } txn_t;
 
 /**
- * @brief Initialize a transaction.
+ * @brief Initialize a transaction, sampling the clocks of the shards it may access as its read versions.
+ * The transaction runs in the context of the calling thread when it is registered in the region (see thread_context.h).
  * 
+ * @param region The shared memory region.
  * @param is_ro Whether the transaction is read-only.
- * @param rv Read version of the transaction.
- * @param wv Write version of the transaction. (Only used on commit)
+ * @param shard The only shard the transaction may access, -1 for all of them.
  * @return txn_t* Pointer to the initialized transaction.
  */
-txn_t *txn_t_init(bool is_ro, int rv, int wv);
+txn_t *txn_t_init(region_t *region, bool is_ro, int shard);
 
 /**
  * @brief Destroy a transaction.
@@ -43,13 +54,199 @@ txn_t *txn_t_init(bool is_ro, int rv, int wv);
 void txn_t_destroy(txn_t *txn);
 
 /**
- * @brief Get the mapped lock for a given address.
+ * @brief Get the shard holding a given address: shards > 0 hold the segments carved from their arena.
+ * 
+ * @param region The shared memory region.
+ * @param addr The (physical) address.
+ * @return size_t The shard of the address (0 outside of the arenas).
+ */
+static inline size_t utils_shard_of(region_t *region, const void *addr)
+{
+    if (REGION_SHARDS == 1 || (const char *)addr < region->shard_arena)
+    {
+        return 0;
+    }
+
+    size_t shard = 1 + (((uintptr_t)addr - (uintptr_t)region->shard_arena) >> SHARD_ARENA_SHIFT);
+
+    return shard < REGION_SHARDS ? shard : 0;
+}
+
+/**
+ * @brief Get the lock granularity of an address: the log2 of the size of the blocks of its objects (see tm_alloc_objects).
+ * 
+ * @param region The shared memory region.
+ * @param addr The (physical) address.
+ * @return size_t The log2 of the block size, 0 outside of the object segments (one lock per word).
+ */
+static inline size_t utils_object_shift(region_t *region, const void *addr)
+{
+    uintptr_t offset = (uintptr_t)addr - (uintptr_t)region->object_arena;
+    if (!OBJECT_LOCKS || offset >= region->object_arena_size)
+    {
+        return 0;
+    }
+
+    return OBJECT_MIN_SHIFT + (offset >> OBJECT_ARENA_SHIFT);
+}
+
+/**
+ * @brief Get the block size (as a log2) locking the objects of a given size: the largest power of 2 dividing the size,
+ * so that a block never spans two objects (up to the largest block size).
+ * 
+ * @param region The shared memory region.
+ * @param object_size The size of the objects.
+ * @return size_t The log2 of the block size, 0 if word granularity is as coarse (or the region has no object segments).
+ */
+size_t utils_object_shift_of(region_t *region, size_t object_size);
+
+/**
+ * @brief Carve a block from the arena of a block size, so that the address at the given offset in the block is aligned
+ * to the block size (lock-free). The arena is never reused: the block is still zeroed.
  * 
- * @param locks The array of locks.
- * @param addr The address to get the lock for.
+ * @param region The shared memory region.
+ * @param shift The log2 of the block size (see utils_object_shift_of).
+ * @param size The size of the block.
+ * @param offset The offset of the first object in the block.
+ * @return void* The block, NULL if the arena is full.
+ */
+void *utils_object_arena_alloc(region_t *region, size_t shift, size_t size, size_t offset);
+
+/**
+ * @brief Allocate a new segment of objects and insert it in the segment list of the region (thread-safe).
+ * 
+ * @param region The shared memory region.
+ * @param shift The log2 of the block size locking the objects (see utils_object_shift_of).
+ * @param size The size of the segment (a multiple of the object size).
+ * @param segment Pointer receiving the address of the first (zeroed) word of the segment (aligned to the block size).
+ * @return true If the segment was allocated.
+ * @return false If the arena of the block size is full.
+ */
+bool utils_alloc_segment_of_objects(region_t *region, size_t shift, size_t size, void **segment);
+
+/**
+ * @brief Get the mapped lock for a given address (in the part of the lock table of its shard).
+ * 
+ * @param region The shared memory region.
+ * @param addr The (physical) address to get the lock for.
  * @return versioned_write_spinlock_t* The lock for the given address.
  */
-versioned_write_spinlock_t *utils_get_mapped_lock(versioned_write_spinlock_t *locks, void *addr);
+static inline versioned_write_spinlock_t *utils_get_mapped_lock(region_t *region, void *addr)
+{
+    uintptr_t x = (uintptr_t)addr;
+
+    if (COLOCATED_LOCKS)
+    {
+        // The lock is at the start of the block holding the word
+        return (versioned_write_spinlock_t *)(x & ~(uintptr_t)(region->colocated_block_size - 1));
+    }
+
+    // Every word of an object maps to the lock of the first word of the object (of its block, for large objects)
+    x &= ~(((uintptr_t)1 << utils_object_shift(region, addr)) - 1);
+
+    // Each shard has its own part of the table, so that a lock only ever holds versions of one clock
+    size_t shard_locks = VWSL_NUM / REGION_SHARDS;
+    return &region->versioned_write_spinlock[utils_shard_of(region, addr) * shard_locks + x % shard_locks];
+}
+
+/**
+ * @brief Translate an address handed to the user (by tm_start/tm_alloc) to the address of the word in memory.
+ * This is the identity, unless the co-located lock layout is used.
+ * 
+ * @param region The shared memory region.
+ * @param addr The user address of the word.
+ * @return void* The physical address of the word.
+ */
+static inline void *utils_translate(region_t *region, const void *addr)
+{
+    if (!COLOCATED_LOCKS)
+    {
+        return (void *)addr;
+    }
+
+    uintptr_t x = (uintptr_t)addr;
+    size_t id = x >> COLOCATED_SEGMENT_SHIFT;
+    size_t word = (x & (((uintptr_t)1 << COLOCATED_SEGMENT_SHIFT) - 1)) / region->align;
+
+    size_t block = word / region->colocated_words_per_block;
+    size_t slot = word - block * region->colocated_words_per_block;
+
+    char *base = (char *)region->segment_directory[id >> COLOCATED_CHUNK_SHIFT][id & ((1 << COLOCATED_CHUNK_SHIFT) - 1)];
+
+    return base + block * region->colocated_block_size + region->colocated_lock_slot + slot * region->align;
+}
+
+/**
+ * @brief Get the number of bytes of memory holding a segment of the given (user) size.
+ * 
+ * @param region The shared memory region.
+ * @param size The size of the segment, as seen by the user.
+ * @return size_t The size of the memory to allocate for the segment.
+ */
+size_t utils_physical_size(region_t *region, size_t size);
+
+/**
+ * @brief Compute the co-located layout of a region from its alignment, and empty its segment table.
+ * 
+ * @param region The shared memory region.
+ */
+void utils_colocated_init(region_t *region);
+
+/**
+ * @brief Give a segment id to a (block-aligned) segment of the co-located layout.
+ * Must be called with the segment list lock held, or before the region is shared.
+ * 
+ * @param region The shared memory region.
+ * @param base The address of the memory holding the segment.
+ * @param addr Pointer receiving the user address of the first word of the segment.
+ * @return true If the segment was registered.
+ * @return false If there are too many segments, or the segment table could not grow.
+ */
+bool utils_register_segment(region_t *region, void *base, void **addr);
+
+/**
+ * @brief Allocate a new segment and insert it in the segment list of the region (thread-safe).
+ * 
+ * @param region The shared memory region.
+ * @param size The size of the segment, must be a positive multiple of the alignment.
+ * @param segment Pointer receiving the (user) address of the first (zeroed) word of the segment.
+ * @return true If the segment was allocated.
+ * @return false If there was no memory for the segment.
+ */
+bool utils_alloc_segment(region_t *region, size_t size, void **segment);
+
+/**
+ * @brief Allocate a new segment in the given shard (see utils_alloc_segment). The segments of the shards > 0 are carved
+ * from the arena of the shard, and only released with the region.
+ * 
+ * @param region The shared memory region.
+ * @param shard The shard of the segment.
+ * @param size The size of the segment, must be a positive multiple of the alignment.
+ * @param segment Pointer receiving the (user) address of the first (zeroed) word of the segment.
+ * @return true If the segment was allocated.
+ * @return false If there was no memory for the segment.
+ */
+bool utils_alloc_segment_in_shard(region_t *region, size_t shard, size_t size, void **segment);
+
+/**
+ * @brief Get the address of the first word of a segment.
+ * 
+ * @param region The shared memory region.
+ * @param sn The segment.
+ * @return void* The first word of the segment (aligned to the alignment of the region).
+ */
+void *utils_segment_data(region_t *region, segment_t *sn);
+
+/**
+ * @brief Find the restored range that contains the old addresses [addr, addr + size).
+ * 
+ * @param ranges The ranges to search.
+ * @param count The number of ranges.
+ * @param addr The old address to look for.
+ * @param size The number of bytes that must be in the range.
+ * @return segment_range_t* The range containing the addresses, NULL if none.
+ */
+segment_range_t *utils_find_range(segment_range_t *ranges, size_t count, uintptr_t addr, size_t size);
 
 /**
  * @brief Try to lock a set. Used for the write-set.
@@ -82,15 +279,35 @@ void utils_unlock_set(region_t *region, set_t *set, set_node_t *start, set_node_
 bool utils_check_commit(region_t *region, txn_t *txn);
 
 /**
- * @brief Validate a read-set.
+ * @brief Get the read-set entry of the stripe of a word.
+ * 
+ * @param region The shared memory region.
+ * @param vws The versioned-write-spinlock of the word (see utils_get_mapped_lock).
+ * @return read_set_entry_t The entry of the stripe.
+ */
+static inline read_set_entry_t utils_read_set_entry(region_t *region, versioned_write_spinlock_t *vws)
+{
+#if COLOCATED_LOCKS
+    (void)region;
+    return vws;
+#else
+    return (read_set_entry_t)(vws - region->versioned_write_spinlock);
+#endif
+}
+
+/**
+ * @brief Validate a read-set. With a single shard and the lock table, the stripes are checked 16 (AVX-512) or 8 (AVX2)
+ * at a time with gathers, when the CPU supports it (checked once, at runtime), else one at a time.
+ * A stripe locked by the transaction itself (read, then written) is valid if its version before the lock is.
  * 
  * @param region The shared memory region.
  * @param set The read-set to validate.
- * @param rv The read-version of the transaction.
+ * @param rv The read-versions of the transaction (one per shard).
+ * @param held The write-set whose locks the transaction holds, NULL if it holds none.
  * @return true If the read-set is valid.
  * @return false If the read-set is invalid.
  */
-bool utils_validate_read_set(region_t *region, read_set_t *set, int rv);
+bool utils_validate_read_set(region_t *region, read_set_t *set, const int *rv, write_set_t *held);
 
 /**
  * @brief Validate a versioned-write-spinlock.
@@ -107,9 +324,9 @@ bool utils_validate_versioned_write_spinlock(versioned_write_spinlock_t *vws, in
  * 
  * @param region The shared memory region.
  * @param set The write-set to update.
- * @param wv The write-version of the transaction.
+ * @param wv The write-versions of the transaction (one per shard).
 */
-void utils_update_and_unlock_write_set(region_t *region, write_set_t *set, int wv);
+void utils_update_and_unlock_write_set(region_t *region, write_set_t *set, const int *wv);
 
 /**
  * @brief Log a message.
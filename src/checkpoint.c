@@ -0,0 +1,627 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tm.h>
+
+#include "utils.h"
+
+static size_t checkpoint_t_round_up(size_t x, size_t to)
+{
+    return (x + to - 1) / to * to;
+}
+
+static bool checkpoint_t_pwrite_all(int fd, const void *data, size_t size, size_t offset)
+{
+    const char *curr = (const char *)data;
+
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, curr, size, (off_t)offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        curr += written;
+        offset += (size_t)written;
+        size -= (size_t)written;
+    }
+
+    return true;
+}
+
+static bool checkpoint_t_sync_parent_dir(const char *path)
+{
+    char *copy = strdup(path);
+    if (unlikely(!copy))
+    {
+        return false;
+    }
+
+    int dir = open(dirname(copy), O_RDONLY);
+    free(copy);
+    if (dir < 0)
+    {
+        return false;
+    }
+
+    bool ok = (fsync(dir) == 0);
+    close(dir);
+
+    return ok;
+}
+
+/**
+ * @brief A chunk of a segment, copied to the file as a unit.
+ *
+ */
+typedef struct checkpoint_chunk
+{
+    size_t entry;  // Segment entry of the chunk
+    size_t offset; // Offset of the chunk in its segment
+    size_t size;
+    int rv;        // Clock of the shard of the segment when the chunk was copied, -1 if it must be copied (again)
+    bool locked;   // Its stripes are held by the checkpoint
+} checkpoint_chunk_t;
+
+/**
+ * @brief State of a checkpoint being written.
+ *
+ */
+typedef struct checkpoint_writer
+{
+    region_t *region;
+    int fd;
+    size_t gap;  // Bytes left before each segment, for its header once mapped
+    size_t page;
+
+    checkpoint_segment_entry_t *entries;
+    size_t count;
+    size_t capacity;
+    size_t end; // End of the data of the segments in the file (where the entries are written)
+
+    checkpoint_chunk_t *chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    size_t chunk_size;
+    char *buffer; // Copy of a chunk
+
+    versioned_write_spinlock_t **held; // Stripes locked by the checkpoint (open addressing set, NULL for a free slot)
+    size_t held_count;
+    size_t held_capacity; // Power of 2 (or 0)
+} checkpoint_writer_t;
+
+static bool checkpoint_t_reserve(void **array, size_t *capacity, size_t needed, size_t item_size)
+{
+    if (needed <= *capacity)
+    {
+        return true;
+    }
+
+    size_t capacity_new = *capacity ? *capacity : 16;
+    while (capacity_new < needed)
+    {
+        capacity_new *= 2;
+    }
+
+    void *grown = realloc(*array, capacity_new * item_size);
+    if (unlikely(!grown))
+    {
+        return false;
+    }
+
+    *array = grown;
+    *capacity = capacity_new;
+
+    return true;
+}
+
+/**
+ * @brief Add a segment to the checkpoint: its data is placed after the data of the previous one, and its chunks are
+ * to be copied.
+ */
+static bool checkpoint_t_add_segment(checkpoint_writer_t *writer, void *data, size_t size)
+{
+    size_t chunks = (size + writer->chunk_size - 1) / writer->chunk_size;
+    if (unlikely(!checkpoint_t_reserve((void **)&writer->entries, &writer->capacity, writer->count + 1, sizeof(checkpoint_segment_entry_t)) ||
+                 !checkpoint_t_reserve((void **)&writer->chunks, &writer->chunk_capacity, writer->chunk_count + chunks, sizeof(checkpoint_chunk_t))))
+    {
+        return false;
+    }
+
+    checkpoint_segment_entry_t *entry = &writer->entries[writer->count];
+    entry->offset = writer->end;
+    entry->size = size;
+    entry->addr = (uint64_t)(uintptr_t)data;
+    writer->end = checkpoint_t_round_up(entry->offset + size + writer->gap, writer->page);
+
+    for (size_t offset = 0; offset < size; offset += writer->chunk_size)
+    {
+        checkpoint_chunk_t *chunk = &writer->chunks[writer->chunk_count++];
+        chunk->entry = writer->count;
+        chunk->offset = offset;
+        chunk->size = size - offset < writer->chunk_size ? size - offset : writer->chunk_size;
+        chunk->rv = -1;
+        chunk->locked = false;
+    }
+
+    writer->count++;
+
+    return true;
+}
+
+/**
+ * @brief Add the segments allocated since the last call (must be called with the segment list lock held). Segments are
+ * never freed and are inserted at the head of the list: the new ones are the first ones.
+ */
+static bool checkpoint_t_add_new_segments(checkpoint_writer_t *writer)
+{
+    region_t *region = writer->region;
+
+    size_t total = 0;
+    for (segment_t *sn = region->allocs; sn; sn = sn->next)
+    {
+        total++;
+    }
+
+    // Entry 0 is the first segment of the region
+    size_t added = total - (writer->count - 1);
+    segment_t *sn = region->allocs;
+    for (size_t i = 0; i < added; i++, sn = sn->next)
+    {
+        if (unlikely(!checkpoint_t_add_segment(writer, utils_segment_data(region, sn), sn->size)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static char *checkpoint_t_chunk_data(checkpoint_writer_t *writer, checkpoint_chunk_t *chunk)
+{
+    return (char *)(uintptr_t)writer->entries[chunk->entry].addr + chunk->offset;
+}
+
+/**
+ * @brief Check that no word of a chunk was written after a version of the clock (nor is being written), as a
+ * read-only txn validates its reads.
+ */
+static bool checkpoint_t_chunk_valid(region_t *region, char *data, size_t size, int rv)
+{
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        if (!utils_validate_versioned_write_spinlock(utils_get_mapped_lock(region, data + i), rv))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copy a chunk to the file: the words it holds at the current version of the clock, or at any time if its stripes
+ * are held by the checkpoint.
+ *
+ * @return int 1 if the chunk was copied, 0 if it is being written (and must be copied again), -1 on I/O error.
+ */
+static int checkpoint_t_copy_chunk(checkpoint_writer_t *writer, checkpoint_chunk_t *chunk)
+{
+    region_t *region = writer->region;
+    char *data = checkpoint_t_chunk_data(writer, chunk);
+
+    int rv = 0;
+    if (!chunk->locked)
+    {
+        rv = global_versioned_clock_t_get_clock(&region->global_versioned_clock[utils_shard_of(region, data)]);
+        if (!checkpoint_t_chunk_valid(region, data, chunk->size, rv))
+        {
+            return 0;
+        }
+    }
+
+    memcpy(writer->buffer, data, chunk->size);
+
+    // A word written during the copy has a newer version (or is still locked)
+    if (!chunk->locked && !checkpoint_t_chunk_valid(region, data, chunk->size, rv))
+    {
+        return 0;
+    }
+
+    if (!checkpoint_t_pwrite_all(writer->fd, writer->buffer, chunk->size, writer->entries[chunk->entry].offset + chunk->offset))
+    {
+        return -1;
+    }
+
+    chunk->rv = rv;
+    return 1;
+}
+
+static size_t checkpoint_t_held_slot(versioned_write_spinlock_t **held, size_t capacity, versioned_write_spinlock_t *vws)
+{
+    size_t slot = ((uintptr_t)vws / sizeof(versioned_write_spinlock_t)) & (capacity - 1);
+    while (held[slot] && held[slot] != vws)
+    {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Add a stripe to the set of the stripes held by the checkpoint (growing it to keep it at most half full).
+ *
+ * @return int 1 if it was added, 0 if it is held already, -1 out of memory.
+ */
+static int checkpoint_t_hold(checkpoint_writer_t *writer, versioned_write_spinlock_t *vws)
+{
+    if (2 * (writer->held_count + 1) > writer->held_capacity)
+    {
+        size_t capacity_new = writer->held_capacity ? 2 * writer->held_capacity : 1024;
+        versioned_write_spinlock_t **grown = (versioned_write_spinlock_t **)calloc(capacity_new, sizeof(versioned_write_spinlock_t *));
+        if (unlikely(!grown))
+        {
+            return -1;
+        }
+
+        for (size_t i = 0; i < writer->held_capacity; i++)
+        {
+            if (writer->held[i])
+            {
+                grown[checkpoint_t_held_slot(grown, capacity_new, writer->held[i])] = writer->held[i];
+            }
+        }
+
+        free(writer->held);
+        writer->held = grown;
+        writer->held_capacity = capacity_new;
+    }
+
+    size_t slot = checkpoint_t_held_slot(writer->held, writer->held_capacity, vws);
+    if (writer->held[slot])
+    {
+        return 0;
+    }
+
+    writer->held[slot] = vws;
+    writer->held_count++;
+
+    return 1;
+}
+
+/**
+ * @brief Lock the stripes of a chunk (the ones the checkpoint does not hold yet), waiting for their committers. The
+ * committers never wait on a stripe while holding another one, thus they cannot wait on the checkpoint forever.
+ */
+static bool checkpoint_t_lock_chunk(checkpoint_writer_t *writer, checkpoint_chunk_t *chunk)
+{
+    region_t *region = writer->region;
+    char *data = checkpoint_t_chunk_data(writer, chunk);
+
+    versioned_write_spinlock_t *prev = NULL;
+    for (size_t i = 0; i < chunk->size; i += region->align)
+    {
+        // The words sharing a stripe in a chunk are neighbours: other chunks may share it too (and hold it already)
+        versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, data + i);
+        if (vws == prev)
+        {
+            continue;
+        }
+        prev = vws;
+
+        int added = checkpoint_t_hold(writer, vws);
+        if (unlikely(added < 0))
+        {
+            return false;
+        }
+
+        while (added && !versioned_write_spinlock_t_lock(vws))
+        {
+            sched_yield();
+        }
+    }
+
+    chunk->locked = true;
+    chunk->rv = -1;
+
+    return true;
+}
+
+/**
+ * @brief Copy the segments to the file, until they form a consistent snapshot.
+ *
+ * @return true If the snapshot is complete.
+ * @return false On I/O error or out of memory.
+ */
+static bool checkpoint_t_snapshot(checkpoint_writer_t *writer)
+{
+    region_t *region = writer->region;
+    bool list_locked = false;
+    bool ok = true;
+
+    for (size_t round = 0; ok; round++)
+    {
+        // Copy the chunks written since their last copy (all of them, the first time)
+        bool dirty = false;
+        for (size_t c = 0; ok && c < writer->chunk_count; c++)
+        {
+            if (writer->chunks[c].rv < 0)
+            {
+                int copied = checkpoint_t_copy_chunk(writer, &writer->chunks[c]);
+                ok = (copied >= 0);
+                dirty = dirty || (copied == 0);
+            }
+        }
+
+        // The segments allocated meanwhile may be referenced by the copied words: they are part of the snapshot
+        if (ok)
+        {
+            if (!list_locked)
+            {
+                def_lock_t_lock(&region->segment_list_lock);
+            }
+            size_t known = writer->count;
+            ok = checkpoint_t_add_new_segments(writer);
+            if (!list_locked)
+            {
+                def_lock_t_unlock(&region->segment_list_lock);
+            }
+            dirty = dirty || (writer->count != known);
+        }
+
+        //
+        // Validation pass: it starts after every copy, thus the chunks it finds unchanged since their copy all held
+        // their copied values when it started, which is the time of the snapshot. The other ones are copied again.
+        //
+        if (ok && !dirty)
+        {
+            for (size_t c = 0; c < writer->chunk_count; c++)
+            {
+                checkpoint_chunk_t *chunk = &writer->chunks[c];
+                if (!chunk->locked && !checkpoint_t_chunk_valid(region, checkpoint_t_chunk_data(writer, chunk), chunk->size, chunk->rv))
+                {
+                    chunk->rv = -1;
+                    dirty = true;
+                }
+            }
+
+            if (!dirty)
+            {
+                break;
+            }
+        }
+
+        // The chunks still written after a few rounds are locked: they are copied once more, and never change again
+        if (ok && round + 1 >= CHECKPOINT_OPTIMISTIC_ROUNDS)
+        {
+            if (!list_locked)
+            {
+                def_lock_t_lock(&region->segment_list_lock);
+                list_locked = true;
+            }
+
+            for (size_t c = 0; ok && c < writer->chunk_count; c++)
+            {
+                if (writer->chunks[c].rv < 0 && !writer->chunks[c].locked)
+                {
+                    ok = checkpoint_t_lock_chunk(writer, &writer->chunks[c]);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < writer->held_capacity; i++)
+    {
+        if (writer->held[i])
+        {
+            versioned_write_spinlock_t_unlock(writer->held[i]);
+        }
+    }
+    if (list_locked)
+    {
+        def_lock_t_unlock(&region->segment_list_lock);
+    }
+
+    return ok;
+}
+
+/*
+    =======
+    Checkpoint implementations
+    =======
+*/
+
+bool checkpoint_t_write(region_t *region, const char *path)
+{
+    if (COLOCATED_LOCKS)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "checkpoint: The co-located lock layout is not supported!\n");
+        return false;
+    }
+
+    if (region->align > (size_t)sysconf(_SC_PAGESIZE))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "checkpoint: Alignments larger than a page are not supported!\n");
+        return false;
+    }
+
+    checkpoint_writer_t writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.region = region;
+    writer.page = (size_t)sysconf(_SC_PAGESIZE);
+    writer.gap = checkpoint_t_round_up(sizeof(segment_t), region->align < sizeof(void *) ? sizeof(void *) : region->align);
+    writer.chunk_size = CHECKPOINT_CHUNK_SIZE < region->align ? region->align : CHECKPOINT_CHUNK_SIZE / region->align * region->align;
+    writer.end = checkpoint_t_round_up(sizeof(checkpoint_file_header_t) + writer.gap, writer.page);
+
+    size_t path_len = strlen(path);
+    char *tmp_path = (char *)malloc(path_len + 5);
+    writer.buffer = (char *)malloc(writer.chunk_size);
+    if (unlikely(!tmp_path || !writer.buffer))
+    {
+        free(tmp_path);
+        free(writer.buffer);
+        return false;
+    }
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+
+    writer.fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer.fd < 0)
+    {
+        free(tmp_path);
+        free(writer.buffer);
+        return false;
+    }
+
+    //
+    // Layout: [header] then the data of each segment, at page boundaries, then the segment entries. At least one segment
+    // header worth of bytes is left before each segment, so that the mapped segments can be linked in place.
+    //
+
+    bool ok = checkpoint_t_add_segment(&writer, region->start, region->size) && checkpoint_t_snapshot(&writer);
+
+    checkpoint_file_header_t header = {CHECKPOINT_MAGIC, region->size, region->align, writer.count, writer.end};
+    ok = ok && checkpoint_t_pwrite_all(writer.fd, writer.entries, writer.count * sizeof(checkpoint_segment_entry_t), writer.end) &&
+         checkpoint_t_pwrite_all(writer.fd, &header, sizeof(header), 0) && (fdatasync(writer.fd) == 0);
+    close(writer.fd);
+
+    ok = ok && (rename(tmp_path, path) == 0) && checkpoint_t_sync_parent_dir(path);
+    if (!ok)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "checkpoint: Could not write %s!\n", path);
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    free(writer.buffer);
+    free(writer.entries);
+    free(writer.chunks);
+    free(writer.held);
+
+    return ok;
+}
+
+bool checkpoint_t_read_geometry(const char *path, size_t *size, size_t *align)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    checkpoint_file_header_t header;
+    bool ok = (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)) && header.magic == CHECKPOINT_MAGIC;
+    close(fd);
+
+    if (ok)
+    {
+        *size = header.size;
+        *align = header.align;
+    }
+
+    return ok;
+}
+
+bool checkpoint_t_map(region_t *region, const char *path)
+{
+    if (COLOCATED_LOCKS)
+    {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(checkpoint_file_header_t))
+    {
+        close(fd);
+        return false;
+    }
+
+    // Private mapping: the region writes to its own copies of the pages, the file stays untouched
+    size_t length = (size_t)st.st_size;
+    char *map = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    checkpoint_file_header_t *header = (checkpoint_file_header_t *)map;
+    checkpoint_segment_entry_t *entries = (checkpoint_segment_entry_t *)(map + header->entries);
+    size_t gap = checkpoint_t_round_up(sizeof(segment_t), region->align < sizeof(void *) ? sizeof(void *) : region->align);
+
+    bool valid = header->magic == CHECKPOINT_MAGIC && header->count > 0 &&
+                 header->size == region->size && header->align == region->align &&
+                 header->entries % sizeof(uint64_t) == 0 && header->entries <= length &&
+                 header->count <= (length - header->entries) / sizeof(checkpoint_segment_entry_t);
+    for (size_t i = 0; valid && i < header->count; i++)
+    {
+        valid = entries[i].offset >= gap && entries[i].offset + entries[i].size <= length && entries[i].offset % region->align == 0;
+    }
+
+    segment_range_t *ranges = valid ? (segment_range_t *)malloc(header->count * sizeof(segment_range_t)) : NULL;
+    if (!ranges)
+    {
+        munmap(map, length);
+        return false;
+    }
+
+    for (size_t i = 0; i < header->count; i++)
+    {
+        ranges[i].old_start = (uintptr_t)entries[i].addr;
+        ranges[i].size = entries[i].size;
+        ranges[i].new_start = map + entries[i].offset;
+
+        if (i == 0)
+        {
+            region->start = ranges[i].new_start;
+            continue;
+        }
+
+        // The segment header lives in the gap right before the segment data
+        segment_t *sn = (segment_t *)(ranges[i].new_start - gap);
+        sn->size = entries[i].size;
+        sn->prev = NULL;
+        sn->next = region->allocs;
+        if (sn->next)
+            sn->next->prev = sn;
+        region->allocs = sn;
+        mem_account_t_add(&region->segment_account, gap + sn->size);
+    }
+
+    region->recovered = ranges;
+    region->recovered_count = header->count;
+    region->checkpoint_map = map;
+    region->checkpoint_map_size = length;
+
+    return true;
+}
+
+bool checkpoint_t_contains(region_t *region, void *addr)
+{
+    char *map = (char *)region->checkpoint_map;
+
+    return map != NULL && (char *)addr >= map && (char *)addr < map + region->checkpoint_map_size;
+}
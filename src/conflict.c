@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "conflict.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "thread_records.h"
+#include "utils.h"
+
+/**
+ * @brief Ring of the words sampled by a thread. Only its thread writes it; the reports read it while it is written.
+ *
+ */
+typedef struct conflict_ring
+{
+    thread_record_t record;
+    uint64_t aborts;       // Aborts of the thread, sampled or not
+    _Atomic uint64_t head; // Number of samples written so far
+    _Atomic uintptr_t samples[CONFLICT_RING_SIZE];
+} conflict_ring_t;
+
+/**
+ * @brief A segment of the region, at the time of the report.
+ *
+ */
+typedef struct conflict_segment
+{
+    uintptr_t start; // Physical start of the data
+    size_t size;     // Physical size of the data
+    void *user;      // Address of the segment returned by tm_start/tm_alloc
+} conflict_segment_t;
+
+/**
+ * @brief A sample of a ring, attributed to a stripe of the region.
+ *
+ */
+typedef struct conflict_sample
+{
+    size_t stripe;
+    uint64_t count; // Number of samples on the stripe, once aggregated
+    uintptr_t addr;
+    void *segment;
+    size_t offset;
+} conflict_sample_t;
+
+static thread_record_list_t conflict_rings = THREAD_RECORD_LIST_INIT(conflict_ring_t);
+static _Thread_local conflict_ring_t *conflict_self = NULL;
+
+/**
+ * @brief List the segments of the region, sorted by physical address.
+ */
+static conflict_segment_t *conflict_t_list_segments(region_t *region, size_t *count)
+{
+    def_lock_t_lock(&region->segment_list_lock);
+
+    *count = 1;
+    for (segment_t *sn = region->allocs; sn; sn = sn->next)
+    {
+        (*count)++;
+    }
+
+    conflict_segment_t *segments = (conflict_segment_t *)malloc(*count * sizeof(conflict_segment_t));
+    if (likely(segments != NULL))
+    {
+        segments[0] = (conflict_segment_t){(uintptr_t)region->start, utils_physical_size(region, region->size), tm_start(region)};
+
+        size_t i = 1;
+        for (segment_t *sn = region->allocs; sn; sn = sn->next, i++)
+        {
+            void *data = utils_segment_data(region, sn);
+            segments[i] = (conflict_segment_t){(uintptr_t)data, utils_physical_size(region, sn->size), data};
+
+            // With co-located locks, the user address is the (logical) address of the segment id of the data
+            for (size_t id = 1; COLOCATED_LOCKS && id < region->segment_count; id++)
+            {
+                if (region->segment_directory[id >> COLOCATED_CHUNK_SHIFT][id & ((1 << COLOCATED_CHUNK_SHIFT) - 1)] == data)
+                {
+                    segments[i].user = (void *)((uintptr_t)id << COLOCATED_SEGMENT_SHIFT);
+                    break;
+                }
+            }
+        }
+    }
+
+    def_lock_t_unlock(&region->segment_list_lock);
+
+    return segments;
+}
+
+static int conflict_t_compare_segments(const void *a, const void *b)
+{
+    uintptr_t x = ((const conflict_segment_t *)a)->start, y = ((const conflict_segment_t *)b)->start;
+    return (x > y) - (x < y);
+}
+
+static int conflict_t_compare_stripes(const void *a, const void *b)
+{
+    size_t x = ((const conflict_sample_t *)a)->stripe, y = ((const conflict_sample_t *)b)->stripe;
+    return (x > y) - (x < y);
+}
+
+static int conflict_t_compare_counts(const void *a, const void *b)
+{
+    uint64_t x = ((const conflict_sample_t *)a)->count, y = ((const conflict_sample_t *)b)->count;
+    return (x < y) - (x > y);
+}
+
+/**
+ * @brief Attribute a sampled word to its segment and stripe.
+ *
+ * @return bool Whether the word belongs to one of the segments (i.e. to the region).
+ */
+static bool conflict_t_locate(region_t *region, conflict_segment_t *segments, size_t count, uintptr_t addr, conflict_sample_t *sample)
+{
+    // Last segment starting at or before the address
+    size_t low = 0, high = count;
+    while (high - low > 1)
+    {
+        size_t mid = (low + high) / 2;
+        if (segments[mid].start <= addr)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    conflict_segment_t *segment = &segments[low];
+    if (addr < segment->start || addr >= segment->start + segment->size)
+    {
+        return false;
+    }
+
+    size_t offset = addr - segment->start;
+    versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, (void *)addr);
+    if (COLOCATED_LOCKS)
+    {
+        // Skip the lock slots of the blocks before the word
+        size_t block = offset / region->colocated_block_size;
+        size_t slot = (offset % region->colocated_block_size - region->colocated_lock_slot) / region->align;
+        offset = (block * region->colocated_words_per_block + slot) * region->align;
+        sample->stripe = (uintptr_t)vws / region->colocated_block_size;
+    }
+    else
+    {
+        sample->stripe = (size_t)(vws - region->versioned_write_spinlock);
+    }
+
+    sample->count = 1;
+    sample->addr = COLOCATED_LOCKS ? (uintptr_t)segment->user + offset : addr;
+    sample->segment = segment->user;
+    sample->offset = offset;
+
+    return true;
+}
+
+/*
+    =======
+    Conflict profiler implementations
+    =======
+*/
+
+void conflict_t_record(const void *addr)
+{
+    if (unlikely(!conflict_self))
+    {
+        conflict_self = (conflict_ring_t *)thread_record_list_t_acquire(&conflict_rings);
+    }
+
+    conflict_ring_t *ring = conflict_self;
+    if (unlikely(!ring) || ring->aborts++ % CONFLICT_SAMPLE_PERIOD != 0)
+    {
+        return;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->samples[head & (CONFLICT_RING_SIZE - 1)], (uintptr_t)addr, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+size_t conflict_t_report(region_t *region, tm_conflict_hotspot_t *hotspots, size_t max)
+{
+    size_t rings = 0;
+    for (thread_record_t *record = thread_record_list_t_first(&conflict_rings); record; record = record->next)
+    {
+        rings++;
+    }
+
+    size_t segment_count;
+    conflict_segment_t *segments = conflict_t_list_segments(region, &segment_count);
+    conflict_sample_t *samples = (conflict_sample_t *)malloc((rings ? rings : 1) * CONFLICT_RING_SIZE * sizeof(conflict_sample_t));
+    if (unlikely(!segments || !samples))
+    {
+        free(segments);
+        free(samples);
+        return 0;
+    }
+    qsort(segments, segment_count, sizeof(conflict_segment_t), conflict_t_compare_segments);
+
+    // Attribute the samples of the rings to the stripes of the region (the rings pushed after the count are skipped)
+    size_t count = 0;
+    thread_record_t *record = thread_record_list_t_first(&conflict_rings);
+    for (size_t r = 0; r < rings; r++, record = record->next)
+    {
+        conflict_ring_t *ring = (conflict_ring_t *)record;
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t n = head < CONFLICT_RING_SIZE ? (size_t)head : CONFLICT_RING_SIZE;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            uintptr_t addr = atomic_load_explicit(&ring->samples[i], memory_order_relaxed);
+            if (conflict_t_locate(region, segments, segment_count, addr, &samples[count]))
+            {
+                count++;
+            }
+        }
+    }
+
+    // Count the samples of each stripe, then keep the most conflicting stripes
+    qsort(samples, count, sizeof(conflict_sample_t), conflict_t_compare_stripes);
+
+    size_t stripes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (stripes > 0 && samples[stripes - 1].stripe == samples[i].stripe)
+        {
+            samples[stripes - 1].count++;
+        }
+        else
+        {
+            samples[stripes++] = samples[i];
+        }
+    }
+
+    qsort(samples, stripes, sizeof(conflict_sample_t), conflict_t_compare_counts);
+
+    size_t reported = stripes < max ? stripes : max;
+    for (size_t i = 0; i < reported; i++)
+    {
+        hotspots[i] = (tm_conflict_hotspot_t){samples[i].stripe, samples[i].count, (void *)samples[i].addr, samples[i].segment, samples[i].offset};
+    }
+
+    free(segments);
+    free(samples);
+
+    return reported;
+}
@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "latency.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "thread_records.h"
+
+/**
+ * @brief Histogram of a thread. Only its thread writes it, so the counters are updated with plain (relaxed) stores,
+ * and only read atomically by the snapshots.
+ *
+ */
+typedef struct latency_histogram
+{
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[TM_LATENCY_BUCKETS];
+} latency_histogram_t;
+
+/**
+ * @brief Histograms of a thread (see thread_records.h: the record of an exited thread is reused, with its counts).
+ *
+ */
+typedef struct latency_thread
+{
+    thread_record_t record;
+    uint64_t aborts; // Aborts since the last commit of the thread
+    cache_aligned latency_histogram_t histograms[tm_latency_kinds];
+} latency_thread_t;
+
+static thread_record_list_t latency_threads = THREAD_RECORD_LIST_INIT(latency_thread_t);
+static _Thread_local latency_thread_t *latency_self = NULL;
+
+static latency_thread_t *latency_t_self(void)
+{
+    if (unlikely(latency_self == NULL))
+    {
+        latency_self = (latency_thread_t *)thread_record_list_t_acquire(&latency_threads);
+        if (latency_self)
+        {
+            latency_self->aborts = 0;
+        }
+    }
+
+    return latency_self;
+}
+
+static void latency_t_add(_Atomic uint64_t *counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/*
+    =======
+    Latency histogram implementations
+    =======
+*/
+
+size_t latency_t_bucket_of(uint64_t value)
+{
+    if (value < (1ull << TM_LATENCY_SUB_BITS))
+    {
+        return (size_t)value;
+    }
+
+    size_t magnitude = 63 - (size_t)__builtin_clzll(value);
+    size_t sub = (size_t)(value >> (magnitude - TM_LATENCY_SUB_BITS)) & ((1u << TM_LATENCY_SUB_BITS) - 1);
+
+    return ((magnitude - TM_LATENCY_SUB_BITS + 1) << TM_LATENCY_SUB_BITS) | sub;
+}
+
+void latency_t_record(tm_latency_kind_t kind, uint64_t value)
+{
+    latency_thread_t *thread = latency_t_self();
+    if (unlikely(!thread))
+    {
+        return;
+    }
+
+    latency_histogram_t *histogram = &thread->histograms[kind];
+    latency_t_add(&histogram->buckets[latency_t_bucket_of(value)], 1);
+    latency_t_add(&histogram->sum, value);
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed))
+    {
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+    }
+    latency_t_add(&histogram->count, 1);
+}
+
+void latency_t_record_txn(uint64_t begin, bool committed)
+{
+    latency_thread_t *thread = latency_t_self();
+    if (unlikely(!thread))
+    {
+        return;
+    }
+
+    latency_t_record(committed ? tm_latency_commit : tm_latency_abort, latency_t_now() - begin);
+
+    if (committed)
+    {
+        latency_t_record(tm_latency_retries, thread->aborts);
+        thread->aborts = 0;
+    }
+    else
+    {
+        thread->aborts++;
+    }
+}
+
+void latency_t_snapshot(tm_latency_histogram_t *out)
+{
+    memset(out, 0, tm_latency_kinds * sizeof(tm_latency_histogram_t));
+
+    for (thread_record_t *record = thread_record_list_t_first(&latency_threads); record; record = record->next)
+    {
+        latency_thread_t *thread = (latency_thread_t *)record;
+        for (int kind = 0; kind < tm_latency_kinds; kind++)
+        {
+            latency_histogram_t *histogram = &thread->histograms[kind];
+
+            out[kind].count += atomic_load_explicit(&histogram->count, memory_order_relaxed);
+            out[kind].sum += atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+            uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+            out[kind].max = max > out[kind].max ? max : out[kind].max;
+            for (size_t b = 0; b < TM_LATENCY_BUCKETS; b++)
+            {
+                out[kind].buckets[b] += atomic_load_explicit(&histogram->buckets[b], memory_order_relaxed);
+            }
+        }
+    }
+}
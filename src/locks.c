@@ -1,8 +1,48 @@
+#define _GNU_SOURCE
+
 #include "locks.h"
 
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/**
+ * @brief Futex word on which the waiters of the locks hashed to this bucket sleep.
+ * The sequence is bumped by each release that finds waiters in the bucket.
+ */
+typedef struct wait_bucket
+{
+    cache_aligned _Atomic int sequence;
+    _Atomic int waiters;
+} wait_bucket_t;
+
+static wait_bucket_t wait_buckets[WAIT_BUCKETS];
+
+static wait_bucket_t *wait_bucket_t_of(versioned_write_spinlock_t *lock)
+{
+    uintptr_t x = (uintptr_t)lock / sizeof(versioned_write_spinlock_t);
+
+    return &wait_buckets[(x * 0x9e3779b97f4a7c15ULL) >> 32 & (WAIT_BUCKETS - 1)];
+}
+
+static void wait_bucket_t_wake(versioned_write_spinlock_t *lock)
+{
+    wait_bucket_t *bucket = wait_bucket_t_of(lock);
+
+    // Releases without waiters (the common case) only pay this load
+    if (atomic_load(&bucket->waiters) > 0)
+    {
+        atomic_fetch_add(&bucket->sequence, 1);
+        syscall(SYS_futex, &bucket->sequence, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
 
 /*
     =======
@@ -37,16 +77,60 @@ bool versioned_write_spinlock_t_lock(versioned_write_spinlock_t *lock)
 void versioned_write_spinlock_t_unlock(versioned_write_spinlock_t *lock)
 {
     atomic_fetch_sub(&lock->lock_and_version, 1); // Remove one to make sure lock is 0
+
+    if (WAIT_ON_LOCKED_STRIPES)
+    {
+        wait_bucket_t_wake(lock);
+    }
 }
 
 void versioned_write_spinlock_t_update_version(versioned_write_spinlock_t *lock, int new_version)
 {
     atomic_store(&lock->lock_and_version, new_version << 1);
+
+    if (WAIT_ON_LOCKED_STRIPES)
+    {
+        wait_bucket_t_wake(lock);
+    }
 }
 
-int versioned_write_spinlock_t_load(versioned_write_spinlock_t *lock)
+int versioned_write_spinlock_t_wait_unlocked(versioned_write_spinlock_t *lock)
 {
-    return atomic_load(&lock->lock_and_version);
+    wait_bucket_t *bucket = wait_bucket_t_of(lock);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long deadline = now.tv_sec * 1000000000LL + now.tv_nsec + WAIT_TIMEOUT_US * 1000LL;
+
+    // Register before sampling the sequence: a release that happens after the check below sees the waiter and bumps it
+    atomic_fetch_add(&bucket->waiters, 1);
+
+    int l;
+    while (true)
+    {
+        int sequence = atomic_load(&bucket->sequence);
+        l = atomic_load(&lock->lock_and_version);
+        if (!(l & 0x1))
+        {
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long remaining = deadline - (now.tv_sec * 1000000000LL + now.tv_nsec);
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        // Returns right away if the sequence moved since it was sampled. Releases of the other locks of the bucket wake
+        // the waiter too: it then checks its lock again
+        struct timespec timeout = {remaining / 1000000000LL, remaining % 1000000000LL};
+        syscall(SYS_futex, &bucket->sequence, FUTEX_WAIT_PRIVATE, sequence, &timeout, NULL, 0);
+    }
+
+    atomic_fetch_sub(&bucket->waiters, 1);
+
+    return l;
 }
 
 /*
@@ -82,7 +166,14 @@ int global_versioned_clock_t_increment_and_fetch(global_versioned_clock_t *globa
 */
 int def_lock_t_lock(def_lock_t *lock)
 {
-    return (pthread_mutex_lock(&lock->mutex) == 0);
+    int result = pthread_mutex_lock(&lock->mutex);
+    if (result == EOWNERDEAD)
+    {
+        // Shared locks only: a process died while holding it. The data it protects is updated before the unlock
+        result = pthread_mutex_consistent(&lock->mutex);
+    }
+
+    return (result == 0);
 }
 
 int def_lock_t_unlock(def_lock_t *lock)
@@ -95,6 +186,22 @@ int def_lock_t_init(def_lock_t *lock)
     return (pthread_mutex_init(&lock->mutex, NULL) == 0);
 }
 
+int def_lock_t_init_shared(def_lock_t *lock)
+{
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0)
+    {
+        return false;
+    }
+
+    bool ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 &&
+              pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0 &&
+              pthread_mutex_init(&lock->mutex, &attr) == 0;
+    pthread_mutexattr_destroy(&attr);
+
+    return ok;
+}
+
 int def_lock_t_destroy(def_lock_t *lock)
 {
     return (pthread_mutex_destroy(&lock->mutex) == 0);
@@ -0,0 +1,211 @@
+#define _GNU_SOURCE
+
+#include "mem.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "macros.h"
+
+static size_t mem_round_up(size_t x, size_t to)
+{
+    return (x + to - 1) & ~(to - 1);
+}
+
+static void *mem_alloc_hugetlb(size_t size)
+{
+#ifdef MAP_HUGETLB
+    void *ptr = mmap(NULL, mem_round_up(size, HUGE_PAGE_SIZE), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+static void *mem_alloc_thp(size_t size)
+{
+    // Over-map by one huge page, then trim, so that the block starts at a huge page boundary
+    size_t length = mem_round_up(size, HUGE_PAGE_SIZE);
+    char *raw = (char *)mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    char *ptr = (char *)mem_round_up((uintptr_t)raw, HUGE_PAGE_SIZE);
+    if (ptr > raw)
+    {
+        munmap(raw, (size_t)(ptr - raw));
+    }
+    if (ptr + length < raw + length + HUGE_PAGE_SIZE)
+    {
+        munmap(ptr + length, (size_t)(raw + length + HUGE_PAGE_SIZE - (ptr + length)));
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Only a hint: the kernel may not have THP enabled, in which case regular pages are used
+    madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+
+    return ptr;
+}
+
+void *mem_alloc(size_t size, size_t align, mem_kind_t *kind)
+{
+    if (USE_HUGE_PAGES && align <= HUGE_PAGE_SIZE)
+    {
+        void *ptr = mem_alloc_hugetlb(size);
+        if (ptr)
+        {
+            *kind = MEM_KIND_HUGETLB;
+            return ptr;
+        }
+
+        ptr = mem_alloc_thp(size);
+        if (ptr)
+        {
+            *kind = MEM_KIND_THP;
+            return ptr;
+        }
+    }
+
+    void *ptr;
+    if (unlikely(posix_memalign(&ptr, align < sizeof(void *) ? sizeof(void *) : align, size) != 0))
+    {
+        return NULL;
+    }
+
+    *kind = MEM_KIND_HEAP;
+    return ptr;
+}
+
+void *mem_alloc_zeroed(size_t size, size_t align, mem_kind_t *kind)
+{
+    if (USE_HUGE_PAGES && align <= HUGE_PAGE_SIZE)
+    {
+        void *ptr = mem_alloc(size, align, kind);
+        if (ptr && mem_is_zeroed(*kind))
+        {
+            return ptr;
+        }
+        mem_free(ptr, size, *kind);
+    }
+
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    *kind = MEM_KIND_MMAP;
+    return ptr;
+}
+
+bool mem_is_zeroed(mem_kind_t kind)
+{
+    return kind != MEM_KIND_HEAP;
+}
+
+void mem_free(void *ptr, size_t size, mem_kind_t kind)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (kind == MEM_KIND_HEAP)
+    {
+        free(ptr);
+        return;
+    }
+
+    if (kind == MEM_KIND_SHM)
+    {
+        return;
+    }
+
+    munmap(ptr, kind == MEM_KIND_MMAP ? size : mem_round_up(size, HUGE_PAGE_SIZE));
+}
+
+static void mem_account_t_check(mem_account_t *account, size_t bytes)
+{
+    size_t limit = atomic_load(&account->limit);
+    if (limit == 0)
+    {
+        return;
+    }
+
+    if (bytes <= limit)
+    {
+        atomic_store(&account->exceeded, false);
+    }
+    else if (!atomic_exchange(&account->exceeded, true) && account->on_exceeded)
+    {
+        account->on_exceeded(account, account->arg);
+    }
+}
+
+void mem_account_t_init(mem_account_t *account)
+{
+    atomic_init(&account->bytes, 0);
+    atomic_init(&account->peak, 0);
+    atomic_init(&account->limit, 0);
+    atomic_init(&account->exceeded, false);
+    account->on_exceeded = NULL;
+    account->arg = NULL;
+}
+
+void mem_account_t_add(mem_account_t *account, size_t bytes)
+{
+    size_t total = atomic_fetch_add(&account->bytes, bytes) + bytes;
+
+    size_t peak = atomic_load(&account->peak);
+    while (total > peak && !atomic_compare_exchange_weak(&account->peak, &peak, total))
+        ;
+
+    mem_account_t_check(account, total);
+}
+
+void mem_account_t_sub(mem_account_t *account, size_t bytes)
+{
+    size_t total = atomic_fetch_sub(&account->bytes, bytes) - bytes;
+    if (atomic_load(&account->exceeded))
+    {
+        mem_account_t_check(account, total);
+    }
+}
+
+void mem_account_t_set_limit(mem_account_t *account, size_t limit)
+{
+    atomic_store(&account->exceeded, false);
+    atomic_store(&account->limit, limit);
+    mem_account_t_check(account, atomic_load(&account->bytes));
+}
+
+void mem_charge_t_init(mem_charge_t *charge, mem_account_t *account, size_t bytes)
+{
+    charge->account = MEMORY_ACCOUNTING ? account : NULL;
+    charge->bytes = bytes;
+    charge->charged = 0;
+}
+
+void mem_charge_t_flush(mem_charge_t *charge)
+{
+    if (charge->account)
+    {
+        mem_account_t_add(charge->account, charge->bytes - charge->charged);
+        charge->charged = charge->bytes;
+    }
+}
+
+void mem_charge_t_release(mem_charge_t *charge)
+{
+    if (charge->account && charge->charged > 0)
+    {
+        mem_account_t_sub(charge->account, charge->charged);
+        charge->charged = 0;
+    }
+}
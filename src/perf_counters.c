@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "thread_records.h"
+#include "utils.h"
+
+/**
+ * @brief Counters of a thread. Only its thread writes them, the sums read them while they are written.
+ * A record reused by a new thread keeps its counts, but its perf events (bound to the exited thread) are reopened.
+ *
+ */
+typedef struct perf_thread
+{
+    thread_record_t record;
+    bool opened; // Whether events were opened (by a thread, maybe exited)
+    bool counting; // Whether at least one event could be opened
+    int fds[tm_perf_events];
+    struct perf_event_mmap_page *pages[tm_perf_events]; // For rdpmc, NULL if the page could not be mapped
+    uint64_t start[tm_perf_events];
+    _Atomic uint64_t calls[tm_perf_phases];
+    _Atomic uint64_t counts[tm_perf_phases][tm_perf_events];
+} perf_thread_t;
+
+static thread_record_list_t perf_threads = THREAD_RECORD_LIST_INIT(perf_thread_t);
+static _Thread_local perf_thread_t *perf_self = NULL;
+
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} perf_t_configs[tm_perf_events] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+static void perf_t_close(perf_thread_t *thread)
+{
+    for (int event = 0; event < tm_perf_events; event++)
+    {
+        if (thread->pages[event])
+        {
+            munmap(thread->pages[event], (size_t)sysconf(_SC_PAGESIZE));
+            thread->pages[event] = NULL;
+        }
+        if (thread->fds[event] >= 0)
+        {
+            close(thread->fds[event]);
+            thread->fds[event] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Open the events of the calling thread (user space only), and map their pages for rdpmc.
+ */
+static void perf_t_open(perf_thread_t *thread)
+{
+    if (thread->opened)
+    {
+        perf_t_close(thread);
+    }
+    thread->opened = true;
+    thread->counting = false;
+
+    for (int event = 0; event < tm_perf_events; event++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_t_configs[event].type;
+        attr.config = perf_t_configs[event].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        thread->pages[event] = NULL;
+        thread->fds[event] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (thread->fds[event] < 0)
+        {
+            continue;
+        }
+        thread->counting = true;
+
+        void *page = mmap(NULL, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, thread->fds[event], 0);
+        thread->pages[event] = (page == MAP_FAILED) ? NULL : (struct perf_event_mmap_page *)page;
+    }
+
+    if (!thread->counting)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "perf_counters: No hardware counter available (see perf_event_paranoid)!\n");
+    }
+}
+
+static perf_thread_t *perf_t_self(void)
+{
+    if (unlikely(perf_self == NULL))
+    {
+        perf_thread_t *thread = (perf_thread_t *)thread_record_list_t_acquire(&perf_threads);
+        if (unlikely(!thread))
+        {
+            return NULL;
+        }
+
+        if (!thread->opened)
+        {
+            for (int event = 0; event < tm_perf_events; event++)
+            {
+                thread->fds[event] = -1;
+            }
+        }
+        perf_t_open(thread);
+        perf_self = thread;
+    }
+
+    return perf_self;
+}
+
+/**
+ * @brief Read an event: with rdpmc when the page of the event allows it, else with read().
+ */
+static uint64_t perf_t_read(perf_thread_t *thread, int event)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    struct perf_event_mmap_page *page = thread->pages[event];
+    if (page && page->cap_user_rdpmc)
+    {
+        uint32_t seq;
+        uint64_t count;
+        bool done;
+        do
+        {
+            seq = __atomic_load_n(&page->lock, __ATOMIC_ACQUIRE);
+            uint32_t index = page->index;
+            done = (index != 0);
+            count = (uint64_t)page->offset;
+            if (done)
+            {
+                uint32_t low, high;
+                __asm__ volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+                uint64_t pmc = ((uint64_t)high << 32) | low;
+                uint16_t width = page->pmc_width;
+                count += (uint64_t)((int64_t)(pmc << (64 - width)) >> (64 - width));
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while (__atomic_load_n(&page->lock, __ATOMIC_RELAXED) != seq);
+
+        if (done)
+        {
+            return count;
+        }
+    }
+#endif
+
+    uint64_t count = 0;
+    if (read(thread->fds[event], &count, sizeof(count)) != (ssize_t)sizeof(count))
+    {
+        return 0;
+    }
+
+    return count;
+}
+
+/*
+    =======
+    Hardware counter implementations
+    =======
+*/
+
+void perf_t_start(void)
+{
+    perf_thread_t *thread = perf_t_self();
+    if (unlikely(!thread) || !thread->counting)
+    {
+        return;
+    }
+
+    for (int event = 0; event < tm_perf_events; event++)
+    {
+        if (thread->fds[event] >= 0)
+        {
+            thread->start[event] = perf_t_read(thread, event);
+        }
+    }
+}
+
+void perf_t_stop(tm_perf_phase_t phase)
+{
+    perf_thread_t *thread = perf_self;
+    if (unlikely(!thread) || !thread->counting)
+    {
+        return;
+    }
+
+    for (int event = 0; event < tm_perf_events; event++)
+    {
+        if (thread->fds[event] >= 0)
+        {
+            _Atomic uint64_t *count = &thread->counts[phase][event];
+            uint64_t delta = perf_t_read(thread, event) - thread->start[event];
+            atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + delta, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&thread->calls[phase], atomic_load_explicit(&thread->calls[phase], memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Add the counters of a thread to 'out'.
+ */
+static void perf_t_add_thread(perf_thread_t *thread, tm_perf_counters_t *out)
+{
+    for (int phase = 0; phase < tm_perf_phases; phase++)
+    {
+        out[phase].calls += atomic_load_explicit(&thread->calls[phase], memory_order_relaxed);
+        for (int event = 0; event < tm_perf_events; event++)
+        {
+            out[phase].counts[event] += atomic_load_explicit(&thread->counts[phase][event], memory_order_relaxed);
+        }
+    }
+}
+
+bool perf_t_thread_counters(tm_perf_counters_t *out)
+{
+    memset(out, 0, tm_perf_phases * sizeof(tm_perf_counters_t));
+
+    perf_thread_t *thread = perf_t_self();
+    if (unlikely(!thread))
+    {
+        return false;
+    }
+    perf_t_add_thread(thread, out);
+
+    return thread->counting;
+}
+
+bool perf_t_counters(tm_perf_counters_t *out)
+{
+    memset(out, 0, tm_perf_phases * sizeof(tm_perf_counters_t));
+
+    bool counting = false;
+    for (thread_record_t *record = thread_record_list_t_first(&perf_threads); record; record = record->next)
+    {
+        perf_thread_t *thread = (perf_thread_t *)record;
+        perf_t_add_thread(thread, out);
+        counting = counting || thread->counting;
+    }
+
+    return counting;
+}
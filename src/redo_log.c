@@ -0,0 +1,689 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "redo_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+/*
+    =======
+    File helpers
+    =======
+*/
+
+static uint64_t redo_log_t_checksum(uint64_t hash, const void *data, size_t size)
+{
+    // FNV-1a, enough to detect a torn record at the tail of the log
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t redo_log_t_record_checksum(redo_log_record_t *record, const void *payload)
+{
+    uint64_t saved = record->checksum;
+    record->checksum = 0;
+
+    uint64_t hash = redo_log_t_checksum(0xcbf29ce484222325ULL, record, sizeof(redo_log_record_t));
+    if (record->type == REDO_LOG_RECORD_COMMIT)
+    {
+        hash = redo_log_t_checksum(hash, payload, record->size);
+    }
+
+    record->checksum = saved;
+    return hash;
+}
+
+static bool redo_log_t_write_all(int fd, const void *data, size_t size)
+{
+    const char *curr = (const char *)data;
+
+    while (size > 0)
+    {
+        ssize_t written = write(fd, curr, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        curr += written;
+        size -= (size_t)written;
+    }
+
+    return true;
+}
+
+static bool redo_log_t_sync_parent_dir(const char *path)
+{
+    char *copy = strdup(path);
+    if (unlikely(!copy))
+    {
+        return false;
+    }
+
+    int dir = open(dirname(copy), O_RDONLY);
+    free(copy);
+    if (dir < 0)
+    {
+        return false;
+    }
+
+    bool ok = (fsync(dir) == 0);
+    close(dir);
+
+    return ok;
+}
+
+static bool redo_log_t_write_record(int fd, uint32_t type, uint64_t addr, const void *data, size_t size)
+{
+    // Used only for log creation and compaction, where each record holds at most one segment
+    redo_log_record_t record;
+    memset(&record, 0, sizeof(record));
+
+    record.type = type;
+    record.addr = addr;
+
+    if (type == REDO_LOG_RECORD_ALLOC)
+    {
+        record.size = size;
+        record.checksum = redo_log_t_record_checksum(&record, NULL);
+        return redo_log_t_write_all(fd, &record, sizeof(record));
+    }
+
+    uint64_t entry[2] = {addr, size};
+    record.count = 1;
+    record.size = sizeof(entry) + size;
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = redo_log_t_checksum(hash, &record, sizeof(record));
+    hash = redo_log_t_checksum(hash, entry, sizeof(entry));
+    hash = redo_log_t_checksum(hash, data, size);
+    record.checksum = hash;
+
+    return redo_log_t_write_all(fd, &record, sizeof(record)) &&
+           redo_log_t_write_all(fd, entry, sizeof(entry)) &&
+           redo_log_t_write_all(fd, data, size);
+}
+
+static int redo_log_t_lock_path(const char *path)
+{
+    // The lock is taken on a file of its own: compaction replaces the log by renaming a new file over it
+    size_t path_len = strlen(path);
+    char *lock_path = (char *)malloc(path_len + 6);
+    if (unlikely(!lock_path))
+    {
+        return -1;
+    }
+    memcpy(lock_path, path, path_len);
+    memcpy(lock_path + path_len, ".lock", 6);
+
+    int fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    free(lock_path);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "redo_log: %s is used by another region!\n", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+    =======
+    Recovery
+    =======
+*/
+
+static bool redo_log_t_replay(region_t *region, const char *data, size_t length, segment_range_t **ranges, size_t *count)
+{
+    const redo_log_file_header_t *header = (const redo_log_file_header_t *)data;
+    size_t capacity = 8;
+
+    *ranges = (segment_range_t *)malloc(capacity * sizeof(segment_range_t));
+    if (unlikely(!*ranges))
+    {
+        return false;
+    }
+
+    (*ranges)[0].old_start = (uintptr_t)header->start;
+    (*ranges)[0].size = region->size;
+    (*ranges)[0].new_start = (char *)region->start;
+    *count = 1;
+
+    size_t offset = sizeof(redo_log_file_header_t);
+    size_t replayed = 0;
+
+    while (offset + sizeof(redo_log_record_t) <= length)
+    {
+        redo_log_record_t record;
+        memcpy(&record, data + offset, sizeof(record));
+
+        size_t payload_size = (record.type == REDO_LOG_RECORD_COMMIT) ? record.size : 0;
+        if (offset + sizeof(record) + payload_size > length)
+        {
+            break; // Torn record at the tail: it was never acknowledged
+        }
+
+        const char *payload = data + offset + sizeof(record);
+        if (redo_log_t_record_checksum(&record, payload) != record.checksum)
+        {
+            break;
+        }
+
+        if (record.type == REDO_LOG_RECORD_ALLOC)
+        {
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                segment_range_t *grown = (segment_range_t *)realloc(*ranges, capacity * sizeof(segment_range_t));
+                if (unlikely(!grown))
+                {
+                    return false;
+                }
+                *ranges = grown;
+            }
+
+            void *segment;
+            if (unlikely(!utils_alloc_segment(region, record.size, &segment)))
+            {
+                return false;
+            }
+
+            (*ranges)[*count].old_start = (uintptr_t)record.addr;
+            (*ranges)[*count].size = record.size;
+            (*ranges)[*count].new_start = (char *)segment;
+            (*count)++;
+        }
+        else if (record.type == REDO_LOG_RECORD_COMMIT)
+        {
+            const char *curr = payload;
+            for (uint32_t i = 0; i < record.count; i++)
+            {
+                uint64_t entry[2];
+                memcpy(entry, curr, sizeof(entry));
+                curr += sizeof(entry);
+
+                segment_range_t *range = utils_find_range(*ranges, *count, (uintptr_t)entry[0], entry[1]);
+                if (likely(range != NULL))
+                {
+                    memcpy(range->new_start + (entry[0] - range->old_start), curr, entry[1]);
+                }
+                else
+                {
+                    dprint_cwarn(COLOR_RED, stdout, "redo_log: Dropping a write to an unknown segment during recovery!\n");
+                }
+
+                curr += entry[1];
+            }
+        }
+
+        offset += sizeof(record) + payload_size;
+        replayed++;
+    }
+
+    if (offset != length)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "redo_log: Ignoring %lu trailing bytes of an incomplete record.\n", length - offset);
+    }
+
+    dprint_clog(COLOR_GREEN, stdout, "redo_log: Replayed %lu records.\n", replayed);
+
+    return true;
+}
+
+static bool redo_log_t_create_file(region_t *region, const char *path, segment_range_t *ranges, size_t count)
+{
+    //
+    // The log is (re)written as a snapshot of the region: the header, one alloc record per segment, and one
+    // commit record per segment holding its whole content. It is written aside and renamed, so that a crash
+    // during compaction leaves the previous log in place.
+    //
+
+    size_t path_len = strlen(path);
+    char *tmp_path = (char *)malloc(path_len + 5);
+    if (unlikely(!tmp_path))
+    {
+        return false;
+    }
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        free(tmp_path);
+        return false;
+    }
+
+    redo_log_file_header_t header = {REDO_LOG_MAGIC, region->size, region->align, (uint64_t)(uintptr_t)region->start};
+    bool ok = redo_log_t_write_all(fd, &header, sizeof(header));
+
+    for (size_t i = 1; ok && i < count; i++)
+    {
+        ok = redo_log_t_write_record(fd, REDO_LOG_RECORD_ALLOC, (uintptr_t)ranges[i].new_start, NULL, ranges[i].size);
+    }
+
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        ok = redo_log_t_write_record(fd, REDO_LOG_RECORD_COMMIT, (uintptr_t)ranges[i].new_start, ranges[i].new_start, ranges[i].size);
+    }
+
+    ok = ok && (fdatasync(fd) == 0);
+    close(fd);
+
+    ok = ok && (rename(tmp_path, path) == 0) && redo_log_t_sync_parent_dir(path);
+    if (!ok)
+    {
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    return ok;
+}
+
+static bool redo_log_t_recover(region_t *region, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+        {
+            return false;
+        }
+
+        // Nothing to recover: start a new log holding the (zeroed) first segment
+        segment_range_t start = {(uintptr_t)region->start, region->size, (char *)region->start};
+        return redo_log_t_create_file(region, path, &start, 1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(redo_log_file_header_t))
+    {
+        close(fd);
+        dprint_cwarn(COLOR_RED, stdout, "redo_log: %s is not a valid redo log!\n", path);
+        return false;
+    }
+
+    size_t length = (size_t)st.st_size;
+    char *data = (char *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const redo_log_file_header_t *header = (const redo_log_file_header_t *)data;
+    if (header->magic != REDO_LOG_MAGIC || header->size != region->size || header->align != region->align)
+    {
+        munmap(data, length);
+        dprint_cwarn(COLOR_RED, stdout, "redo_log: %s does not match the size/alignment of the region!\n", path);
+        return false;
+    }
+
+    segment_range_t *ranges = NULL;
+    size_t count = 0;
+
+    bool ok = redo_log_t_replay(region, data, length, &ranges, &count);
+    munmap(data, length);
+
+    // The segments now live at new addresses: compact the log so that it refers to them
+    ok = ok && redo_log_t_create_file(region, path, ranges, count);
+
+    if (!ok)
+    {
+        free(ranges);
+        return false;
+    }
+
+    region->recovered = ranges;
+    region->recovered_count = count;
+
+    return true;
+}
+
+/*
+    =======
+    Flushing
+    =======
+*/
+
+static bool redo_log_t_flush(redo_log_t *log)
+{
+    // Must be called with flush_mutex held. Appenders are only blocked while the buffers are swapped.
+    pthread_mutex_lock(&log->mutex);
+
+    char *pending = log->buffer;
+    size_t pending_capacity = log->capacity;
+    size_t length = log->used;
+    uint64_t target = log->appended_lsn;
+    bool failed = log->failed;
+
+    log->buffer = log->flush_buffer;
+    log->capacity = log->flush_capacity;
+    log->used = 0;
+    log->flush_buffer = pending;
+    log->flush_capacity = pending_capacity;
+
+    pthread_mutex_unlock(&log->mutex);
+
+    // After a failure, the records of a later batch would follow records that may be lost: they are dropped
+    bool ok = !failed && ((length == 0) || (redo_log_t_write_all(log->fd, pending, length) && fdatasync(log->fd) == 0));
+    int error = ok ? 0 : errno;
+
+    pthread_mutex_lock(&log->mutex);
+    if (unlikely(!ok) && !log->failed)
+    {
+        // The records of the batch may be partly written: nothing can be appended after them anymore
+        log->failed = true;
+        log->error = error ? error : EIO;
+    }
+    if (target > log->flushed_lsn)
+    {
+        log->flushed_lsn = target;
+    }
+    pthread_cond_broadcast(&log->flushed_cond);
+    pthread_mutex_unlock(&log->mutex);
+
+    return ok;
+}
+
+static void *redo_log_t_flusher(void *arg)
+{
+    redo_log_t *log = (redo_log_t *)arg;
+
+    //
+    // Group commit: every record appended while the previous batch was being synced
+    // is written and synced together in the next batch.
+    //
+
+    pthread_mutex_lock(&log->mutex);
+    while (true)
+    {
+        while (log->used == 0 && !log->stop)
+        {
+            pthread_cond_wait(&log->work_cond, &log->mutex);
+        }
+
+        if (log->used == 0)
+        {
+            break;
+        }
+
+        pthread_mutex_unlock(&log->mutex);
+
+        pthread_mutex_lock(&log->flush_mutex);
+        redo_log_t_flush(log);
+        pthread_mutex_unlock(&log->flush_mutex);
+
+        pthread_mutex_lock(&log->mutex);
+    }
+    pthread_mutex_unlock(&log->mutex);
+
+    return NULL;
+}
+
+/*
+    =======
+    Redo log implementations
+    =======
+*/
+
+redo_log_t *redo_log_t_open(region_t *region, const char *path)
+{
+    redo_log_t *log = (redo_log_t *)calloc(1, sizeof(redo_log_t));
+    if (unlikely(!log))
+    {
+        return NULL;
+    }
+
+    log->lock_fd = redo_log_t_lock_path(path);
+    if (log->lock_fd < 0)
+    {
+        free(log);
+        return NULL;
+    }
+
+    if (unlikely(!redo_log_t_recover(region, path)))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "redo_log: Recovery from %s failed!\n", path);
+        close(log->lock_fd);
+        free(log);
+        return NULL;
+    }
+
+    log->fd = open(path, O_WRONLY | O_APPEND);
+    if (log->fd < 0)
+    {
+        close(log->lock_fd);
+        free(log);
+        return NULL;
+    }
+
+    log->capacity = REDO_LOG_BUFFER_SIZE;
+    log->flush_capacity = REDO_LOG_BUFFER_SIZE;
+    log->buffer = (char *)malloc(log->capacity);
+    log->flush_buffer = (char *)malloc(log->flush_capacity);
+    if (unlikely(!log->buffer || !log->flush_buffer))
+    {
+        free(log->buffer);
+        free(log->flush_buffer);
+        close(log->fd);
+        close(log->lock_fd);
+        free(log);
+        return NULL;
+    }
+
+    pthread_mutex_init(&log->mutex, NULL);
+    pthread_mutex_init(&log->flush_mutex, NULL);
+    pthread_cond_init(&log->flushed_cond, NULL);
+    pthread_cond_init(&log->work_cond, NULL);
+
+    if (REDO_LOG_GROUP_COMMIT && pthread_create(&log->flusher, NULL, redo_log_t_flusher, log) != 0)
+    {
+        log->stop = true; // No flusher to join
+        redo_log_t_close(log);
+        return NULL;
+    }
+
+    return log;
+}
+
+void redo_log_t_close(redo_log_t *log)
+{
+    pthread_mutex_lock(&log->mutex);
+    bool started = !log->stop;
+    log->stop = true;
+    pthread_cond_signal(&log->work_cond);
+    pthread_mutex_unlock(&log->mutex);
+
+    if (REDO_LOG_GROUP_COMMIT && started)
+    {
+        pthread_join(log->flusher, NULL);
+    }
+
+    pthread_mutex_lock(&log->flush_mutex);
+    redo_log_t_flush(log);
+    pthread_mutex_unlock(&log->flush_mutex);
+
+    close(log->fd);
+    close(log->lock_fd);
+
+    pthread_cond_destroy(&log->work_cond);
+    pthread_cond_destroy(&log->flushed_cond);
+    pthread_mutex_destroy(&log->flush_mutex);
+    pthread_mutex_destroy(&log->mutex);
+
+    free(log->buffer);
+    free(log->flush_buffer);
+    free(log);
+}
+
+static bool redo_log_t_reserve(redo_log_t *log, size_t size)
+{
+    // Must be called with mutex held
+    if (log->used + size <= log->capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = log->capacity;
+    while (log->used + size > capacity)
+    {
+        capacity *= 2;
+    }
+
+    char *grown = (char *)realloc(log->buffer, capacity);
+    if (unlikely(!grown))
+    {
+        return false;
+    }
+
+    log->buffer = grown;
+    log->capacity = capacity;
+
+    return true;
+}
+
+static uint64_t redo_log_t_publish(redo_log_t *log, size_t size)
+{
+    // Must be called with mutex held, after the record was written at the end of the buffer
+    log->used += size;
+    log->appended_lsn += size;
+
+    if (REDO_LOG_GROUP_COMMIT)
+    {
+        pthread_cond_signal(&log->work_cond);
+    }
+
+    return log->appended_lsn;
+}
+
+uint64_t redo_log_t_append_alloc(redo_log_t *log, void *segment, size_t size)
+{
+    redo_log_record_t record;
+    memset(&record, 0, sizeof(record));
+
+    record.type = REDO_LOG_RECORD_ALLOC;
+    record.addr = (uint64_t)(uintptr_t)segment;
+    record.size = size;
+    record.checksum = redo_log_t_record_checksum(&record, NULL);
+
+    pthread_mutex_lock(&log->mutex);
+    if (unlikely(log->failed || !redo_log_t_reserve(log, sizeof(record))))
+    {
+        pthread_mutex_unlock(&log->mutex);
+        return 0;
+    }
+
+    memcpy(log->buffer + log->used, &record, sizeof(record));
+    uint64_t lsn = redo_log_t_publish(log, sizeof(record));
+    pthread_mutex_unlock(&log->mutex);
+
+    return lsn;
+}
+
+uint64_t redo_log_t_append_write_set(redo_log_t *log, write_set_t *set, int wv)
+{
+    redo_log_record_t record;
+    memset(&record, 0, sizeof(record));
+
+    record.type = REDO_LOG_RECORD_COMMIT;
+    record.version = (uint64_t)wv;
+
+    // Size the payload before taking the log mutex
+    for (set_node_t *curr = set->head; curr; curr = curr->next)
+    {
+        record.count++;
+        record.size += 2 * sizeof(uint64_t) + curr->size;
+    }
+
+    size_t total = sizeof(record) + record.size;
+
+    pthread_mutex_lock(&log->mutex);
+    if (unlikely(log->failed || !redo_log_t_reserve(log, total)))
+    {
+        pthread_mutex_unlock(&log->mutex);
+        return 0;
+    }
+
+    char *dest = log->buffer + log->used;
+    char *curr_dest = dest + sizeof(record);
+
+    for (set_node_t *curr = set->head; curr; curr = curr->next)
+    {
+        uint64_t entry[2] = {(uint64_t)(uintptr_t)curr->addr, curr->size};
+        memcpy(curr_dest, entry, sizeof(entry));
+        memcpy(curr_dest + sizeof(entry), curr->val, curr->size);
+        curr_dest += sizeof(entry) + curr->size;
+    }
+
+    record.checksum = redo_log_t_record_checksum(&record, dest + sizeof(record));
+    memcpy(dest, &record, sizeof(record));
+
+    uint64_t lsn = redo_log_t_publish(log, total);
+    pthread_mutex_unlock(&log->mutex);
+
+    return lsn;
+}
+
+bool redo_log_t_wait_durable(redo_log_t *log, uint64_t lsn)
+{
+    if (!REDO_LOG_GROUP_COMMIT)
+    {
+        // Single flush per commit: the committer writes and syncs the log itself
+        pthread_mutex_lock(&log->flush_mutex);
+        pthread_mutex_lock(&log->mutex);
+        bool pending = log->flushed_lsn < lsn;
+        pthread_mutex_unlock(&log->mutex);
+
+        if (pending)
+        {
+            redo_log_t_flush(log);
+        }
+        pthread_mutex_unlock(&log->flush_mutex);
+    }
+
+    pthread_mutex_lock(&log->mutex);
+    while (log->flushed_lsn < lsn && !log->failed)
+    {
+        pthread_cond_wait(&log->flushed_cond, &log->mutex);
+    }
+    bool durable = !log->failed;
+    pthread_mutex_unlock(&log->mutex);
+
+    return durable;
+}
+
+int redo_log_t_error(redo_log_t *log)
+{
+    pthread_mutex_lock(&log->mutex);
+    int error = log->error;
+    pthread_mutex_unlock(&log->mutex);
+
+    return error;
+}
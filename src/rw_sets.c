@@ -7,7 +7,7 @@
 #include "rw_sets.h"
 
 
-set_t *set_t_init()
+set_t *set_t_init(mem_account_t *account)
 {
     set_t *set = (set_t *)malloc(sizeof(set_t));
     if (unlikely(!set))
@@ -17,52 +17,104 @@ set_t *set_t_init()
 
     set->head = NULL;
     set->tail = NULL;
+    set->free = NULL;
+    mem_charge_t_init(&set->charge, account, sizeof(set_t));
 
     return set;
 }
 
 void set_t_destroy(set_t *set)
 {
-    set_node_t *curr = set->head;
+    set_t_clear(set);
+
+    set_node_t *curr = set->free;
     set_node_t *next = NULL;
 
     while (curr)
     {
         next = curr->next;
 
-        if (curr->val != NULL)
-        {
-            free(curr->val);
-        }
-        curr->val = NULL;
-
+        free(curr->val);
         free(curr);
         curr = next;
     }
 
+    mem_charge_t_release(&set->charge);
     free(set);
 }
 
-set_node_t *set_t_allocate_node(void *addr, void *val, size_t size)
+void set_t_clear(set_t *set)
 {
-    set_node_t *node = (set_node_t *)malloc(sizeof(set_node_t));
-    if (unlikely(!node))
+    if (!set->head)
     {
-        return NULL;
+        return;
+    }
+
+    for (set_node_t *curr = set->head; curr; curr = curr->next)
+    {
+        if (curr->borrowed)
+        {
+            curr->val = NULL;
+        }
+        else if (curr->val != NULL && curr->size > CACHE_LINE_SIZE)
+        {
+            // The values of large ranges are not worth keeping
+            free(curr->val);
+            mem_charge_t_sub(&set->charge, curr->size);
+            curr->val = NULL;
+        }
+    }
+
+    set->tail->next = set->free;
+    set->free = set->head;
+    set->head = NULL;
+    set->tail = NULL;
+}
+
+set_node_t *set_t_allocate_node(set_t *set, void *addr, void *val, size_t size)
+{
+    set_node_t *node = set->free;
+    if (node)
+    {
+        // A cleared node keeps its value when it has the same size (a word, most of the time)
+        set->free = node->next;
+        if (node->val != NULL && (val == NULL || node->size != size))
+        {
+            free(node->val);
+            mem_charge_t_sub(&set->charge, node->size);
+            node->val = NULL;
+        }
+    }
+    else
+    {
+        node = (set_node_t *)malloc(sizeof(set_node_t));
+        if (unlikely(!node))
+        {
+            return NULL;
+        }
+        node->val = NULL;
+        mem_charge_t_add(&set->charge, sizeof(set_node_t));
     }
 
     node->addr = addr;
     node->size = size;
+    node->borrowed = false;
     node->next = NULL;
-    node->val = NULL;
 
     // Allocate val
     if (val != NULL)
     {
-        node->val = (void *)malloc(size);
-        if (unlikely(!node->val))
+        if (node->val == NULL)
         {
-            return NULL;
+            node->val = (void *)malloc(size);
+            if (unlikely(!node->val))
+            {
+                // The node (from the free list or new) goes back to the free list, without a value
+                node->next = set->free;
+                set->free = node;
+                return NULL;
+            }
+            mem_charge_t_add(&set->charge, size);
         }
         memcpy(node->val, val, size);
     }
@@ -70,6 +122,61 @@ set_node_t *set_t_allocate_node(void *addr, void *val, size_t size)
     return node;
 }
 
+#if DEBUG_CHECKS
+static uint64_t set_t_checksum(const void *data, size_t size)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ ((const unsigned char *)data)[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+#endif
+
+/**
+ * @brief Replace a borrowed range by one owned node per word, holding copies of the values of the range.
+ */
+static bool set_t_split_borrowed(set_t *set, set_node_t *node, size_t word_size)
+{
+    char *values = (char *)node->val;
+    void *first = malloc(word_size);
+    if (unlikely(!first))
+    {
+        return false;
+    }
+    memcpy(first, values, word_size);
+    mem_charge_t_add(&set->charge, word_size);
+
+    set_node_t *last = node;
+    for (size_t offset = word_size; offset < node->size; offset += word_size)
+    {
+        set_node_t *word = set_t_allocate_node(set, (char *)node->addr + offset, values + offset, word_size);
+        if (unlikely(!word))
+        {
+            free(first);
+            return false;
+        }
+
+        word->next = last->next;
+        last->next = word;
+        last = word;
+    }
+
+    if (set->tail == node)
+    {
+        set->tail = last;
+    }
+
+    node->val = first;
+    node->size = word_size;
+    node->borrowed = false;
+
+    return true;
+}
+
 bool set_t_add_or_update(set_t *set, void *addr, void *val, size_t size)
 {
     set_node_t *curr = set->head;
@@ -77,11 +184,24 @@ bool set_t_add_or_update(set_t *set, void *addr, void *val, size_t size)
 
     while (curr)
     {
-        if (curr->addr == addr)
+        bool covers = (char *)addr >= (char *)curr->addr && (char *)addr < (char *)curr->addr + curr->size;
+
+        if (val != NULL && curr->borrowed && covers)
         {
+            // A word of a borrowed range is written again: copy the range word by word, then update the word
+            if (unlikely(!set_t_split_borrowed(set, curr, size)))
+            {
+                return false;
+            }
+            covers = (curr->addr == addr);
+        }
+
+        if (covers)
+        {
+            // The word itself, or a word of an owned range (updated in place)
             if (val != NULL)
             {
-                memcpy(curr->val, val, size);
+                memcpy((char *)curr->val + ((char *)addr - (char *)curr->addr), val, size);
             }
 
             return true;
@@ -96,7 +216,7 @@ bool set_t_add_or_update(set_t *set, void *addr, void *val, size_t size)
         curr = curr->next;
     }
 
-    set_node_t *node = set_t_allocate_node(addr, val, size);
+    set_node_t *node = set_t_allocate_node(set, addr, val, size);
     if (unlikely(!node))
     {
         return false;
@@ -127,14 +247,14 @@ void *set_t_get_val_or_null(set_t *set, void *addr)
 
     while (curr)
     {
-        if (curr->addr == addr)
+        if (curr->addr > addr)
         {
-            return curr->val;
+            return NULL;
         }
 
-        if (curr->addr > addr)
+        if ((char *)addr < (char *)curr->addr + curr->size)
         {
-            return NULL;
+            return (char *)curr->val + ((char *)addr - (char *)curr->addr);
         }
 
         curr = curr->next;
@@ -142,3 +262,185 @@ void *set_t_get_val_or_null(set_t *set, void *addr)
 
     return NULL;
 }
+
+/**
+ * @brief Insert a range node in a set, before the first node at a higher address (the range overlaps no node).
+ */
+static void set_t_insert_range(set_t *set, set_node_t *node)
+{
+    set_node_t *curr = set->head;
+    set_node_t *prev = NULL;
+    while (curr && curr->addr < node->addr)
+    {
+        prev = curr;
+        curr = curr->next;
+    }
+
+    node->next = curr;
+    if (prev == NULL)
+    {
+        set->head = node;
+    }
+    else
+    {
+        prev->next = node;
+    }
+
+    if (!curr)
+    {
+        set->tail = node;
+    }
+}
+
+bool set_t_add_borrowed(set_t *set, void *addr, const void *val, size_t size)
+{
+    set_node_t *node = set_t_allocate_node(set, addr, NULL, size);
+    if (unlikely(!node))
+    {
+        return false;
+    }
+
+    node->val = (void *)val;
+    node->borrowed = true;
+#if DEBUG_CHECKS
+    node->checksum = set_t_checksum(val, size);
+#endif
+
+    set_t_insert_range(set, node);
+
+    return true;
+}
+
+bool set_t_add_owned(set_t *set, void *addr, void *val, size_t size)
+{
+    set_node_t *node = set_t_allocate_node(set, addr, NULL, size);
+    if (unlikely(!node))
+    {
+        return false;
+    }
+
+    node->val = val;
+    mem_charge_t_add(&set->charge, size);
+    set_t_insert_range(set, node);
+
+    return true;
+}
+
+bool set_t_overlaps(set_t *set, void *addr, size_t size)
+{
+    for (set_node_t *curr = set->head; curr && (char *)curr->addr < (char *)addr + size; curr = curr->next)
+    {
+        if ((char *)curr->addr + curr->size > (char *)addr)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool set_t_check_borrowed(set_t *unused(set))
+{
+#if DEBUG_CHECKS
+    for (set_node_t *curr = set->head; curr; curr = curr->next)
+    {
+        if (curr->borrowed && set_t_checksum(curr->val, curr->size) != curr->checksum)
+        {
+            return false;
+        }
+    }
+#endif
+
+    return true;
+}
+
+read_set_t *read_set_t_init(mem_account_t *account)
+{
+    read_set_t *set = (read_set_t *)malloc(sizeof(read_set_t));
+    if (unlikely(!set))
+    {
+        return NULL;
+    }
+
+    set->entries = NULL;
+    set->addrs = NULL;
+    set->count = 0;
+    set->capacity = 0;
+    mem_charge_t_init(&set->charge, account, sizeof(read_set_t));
+
+    return set;
+}
+
+void read_set_t_clear(read_set_t *set)
+{
+    set->count = 0;
+}
+
+void read_set_t_destroy(read_set_t *set)
+{
+    free(set->entries);
+    free(set->addrs);
+    mem_charge_t_release(&set->charge);
+    free(set);
+}
+
+bool read_set_t_grow(read_set_t *set)
+{
+    size_t capacity = set->capacity ? 2 * set->capacity : READ_SET_INITIAL_CAPACITY;
+    read_set_entry_t *entries = (read_set_entry_t *)realloc(set->entries, capacity * sizeof(read_set_entry_t));
+    if (unlikely(!entries))
+    {
+        return false;
+    }
+
+    set->entries = entries;
+
+    if (CONFLICT_PROFILER)
+    {
+        void **addrs = (void **)realloc(set->addrs, capacity * sizeof(void *));
+        if (unlikely(!addrs))
+        {
+            return false;
+        }
+        set->addrs = addrs;
+    }
+
+    mem_charge_t_add(&set->charge, (capacity - set->capacity) * (sizeof(read_set_entry_t) + (CONFLICT_PROFILER ? sizeof(void *) : 0)));
+    set->capacity = capacity;
+
+    return true;
+}
+
+static int read_set_t_compare_entries(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(const read_set_entry_t *)a;
+    uintptr_t y = (uintptr_t)*(const read_set_entry_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void read_set_t_remove(read_set_t *set, read_set_entry_t *entries, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // The read set stays in reading order (it is not sorted): each of its entries is looked up in the sorted stripes
+    qsort(entries, count, sizeof(read_set_entry_t), read_set_t_compare_entries);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < set->count; i++)
+    {
+        if (!bsearch(&set->entries[i], entries, count, sizeof(read_set_entry_t), read_set_t_compare_entries))
+        {
+            if (CONFLICT_PROFILER)
+            {
+                set->addrs[kept] = set->addrs[i];
+            }
+            set->entries[kept++] = set->entries[i];
+        }
+    }
+
+    set->count = kept;
+}
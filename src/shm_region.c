@@ -0,0 +1,144 @@
+#define _GNU_SOURCE
+
+#include "shm_region.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+static size_t shm_region_t_round_up(size_t x, size_t to)
+{
+    return (x + to - 1) & ~(to - 1);
+}
+
+/*
+    =======
+    Shared-memory region implementations
+    =======
+*/
+
+shm_region_header_t *shm_region_t_create(const char *name, size_t region_size, size_t heap_size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t heap_start = SHM_REGION_HEADER_SIZE + shm_region_t_round_up(region_size, page);
+    size_t length = heap_start + shm_region_t_round_up(heap_size, page);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "shm_region: Could not create %s!\n", name);
+        return NULL;
+    }
+
+    // The object is sparse: pages (e.g. of the lock table) are only allocated when first touched
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)length) == 0)
+    {
+        map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    shm_region_header_t *shm = (shm_region_header_t *)map;
+    shm->base = (uint64_t)(uintptr_t)map;
+    shm->length = length;
+    shm->heap_start = heap_start;
+    atomic_init(&shm->heap_used, 0);
+
+    return shm;
+}
+
+void shm_region_t_publish(shm_region_header_t *shm)
+{
+    atomic_store_explicit(&shm->magic, SHM_REGION_MAGIC, memory_order_release);
+}
+
+shm_region_header_t *shm_region_t_attach(const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // Read the address and size of the mapping from the header
+    struct stat st;
+    shm_region_header_t header;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header) ||
+        pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != SHM_REGION_MAGIC || header.length != (uint64_t)st.st_size)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "shm_region: %s is not a (published) region!\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    void *base = (void *)(uintptr_t)header.base;
+    void *map = mmap(base, header.length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+
+    // Kernels without MAP_FIXED_NOREPLACE take the address as a hint
+    if (map != MAP_FAILED && map != base)
+    {
+        munmap(map, header.length);
+        map = MAP_FAILED;
+    }
+
+    if (map == MAP_FAILED)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "shm_region: The address of %s is already used in this process!\n", name);
+        return NULL;
+    }
+
+    shm_region_header_t *shm = (shm_region_header_t *)map;
+    if (atomic_load_explicit(&shm->magic, memory_order_acquire) != SHM_REGION_MAGIC)
+    {
+        munmap(map, header.length);
+        return NULL;
+    }
+
+    return shm;
+}
+
+void *shm_region_t_region(shm_region_header_t *shm)
+{
+    return (char *)shm + SHM_REGION_HEADER_SIZE;
+}
+
+void *shm_region_t_alloc(shm_region_header_t *shm, size_t size, size_t align)
+{
+    size_t heap_size = shm->length - shm->heap_start;
+    uint64_t used = atomic_load(&shm->heap_used);
+    uint64_t start;
+
+    do
+    {
+        start = shm_region_t_round_up(shm->heap_start + used, align) - shm->heap_start;
+        if (start + size > heap_size)
+        {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak(&shm->heap_used, &used, start + size));
+
+    // The heap is never reused: the block is still zeroed
+    return (char *)shm + shm->heap_start + start;
+}
+
+void shm_region_t_detach(shm_region_header_t *shm)
+{
+    munmap(shm, shm->length);
+}
+
+bool shm_region_t_unlink(const char *name)
+{
+    return shm_unlink(name) == 0;
+}
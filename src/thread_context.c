@@ -0,0 +1,165 @@
+#include "thread_context.h"
+
+#include <stdlib.h>
+
+#include "macros.h"
+
+/**
+ * @brief Binding of a region to the context of the calling thread in it.
+ *
+ */
+typedef struct thread_context_slot
+{
+    region_t *region;
+    thread_context_t *context;
+} thread_context_slot_t;
+
+static _Thread_local thread_context_slot_t thread_context_slots[THREAD_CONTEXT_SLOTS];
+static _Thread_local size_t thread_context_slots_used = 0; // Slots [0, used) may be bound
+
+static thread_context_slot_t *thread_context_t_slot(region_t *region)
+{
+    for (size_t i = 0; i < thread_context_slots_used; i++)
+    {
+        if (thread_context_slots[i].region == region)
+        {
+            return &thread_context_slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    =======
+    Thread context implementations
+    =======
+*/
+
+bool thread_context_t_enter(region_t *region)
+{
+    if (thread_context_t_slot(region))
+    {
+        return true;
+    }
+
+    // Take a free slot (unbound by an exit), else a new one
+    thread_context_slot_t *slot = thread_context_t_slot(NULL);
+    if (!slot)
+    {
+        if (unlikely(thread_context_slots_used == THREAD_CONTEXT_SLOTS))
+        {
+            return false;
+        }
+        slot = &thread_context_slots[thread_context_slots_used++];
+    }
+
+    thread_context_t *context = (thread_context_t *)thread_record_list_t_claim(&region->thread_contexts);
+    if (unlikely(!context))
+    {
+        return false;
+    }
+
+    // The sets of a reused context are kept: only a new one allocates them
+    if (!context->read_set)
+    {
+        context->read_set = read_set_t_init(&region->set_account);
+    }
+    if (!context->write_set)
+    {
+        context->write_set = set_t_init(&region->set_account);
+    }
+    if (unlikely(!context->read_set || !context->write_set))
+    {
+        thread_record_t_release(&context->record);
+        return false;
+    }
+
+    context->region = region;
+    atomic_store_explicit(&context->in_txn, false, memory_order_relaxed);
+    atomic_store_explicit(&context->commits, 0, memory_order_relaxed);
+    atomic_store_explicit(&context->aborts, 0, memory_order_relaxed);
+
+    slot->region = region;
+    slot->context = context;
+
+    return true;
+}
+
+void thread_context_t_exit(region_t *region)
+{
+    thread_context_slot_t *slot = thread_context_t_slot(region);
+    if (!slot)
+    {
+        return;
+    }
+
+    thread_record_t_release(&slot->context->record);
+    slot->region = NULL;
+    slot->context = NULL;
+}
+
+thread_context_t *thread_context_t_idle(region_t *region)
+{
+    thread_context_slot_t *slot = thread_context_t_slot(region);
+    if (!slot || atomic_load_explicit(&slot->context->in_txn, memory_order_relaxed))
+    {
+        // Not registered, or a second txn of the thread (e.g. interleaved by coroutines): allocated as usual
+        return NULL;
+    }
+
+    atomic_store_explicit(&slot->context->in_txn, true, memory_order_relaxed);
+
+    return slot->context;
+}
+
+void thread_context_t_end_txn(thread_context_t *context, bool committed)
+{
+    read_set_t_clear(context->read_set);
+    set_t_clear(context->write_set);
+
+    _Atomic uint64_t *counter = committed ? &context->commits : &context->aborts;
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&context->in_txn, false, memory_order_release);
+}
+
+size_t thread_context_t_report(region_t *region, tm_thread_stats_t *stats, size_t max)
+{
+    size_t count = 0;
+    for (thread_record_t *record = thread_record_list_t_first(&region->thread_contexts); record; record = record->next)
+    {
+        thread_context_t *context = (thread_context_t *)record;
+        if (!atomic_load_explicit(&record->in_use, memory_order_acquire))
+        {
+            continue;
+        }
+
+        if (count < max)
+        {
+            stats[count].commits = atomic_load_explicit(&context->commits, memory_order_relaxed);
+            stats[count].aborts = atomic_load_explicit(&context->aborts, memory_order_relaxed);
+            stats[count].in_txn = atomic_load_explicit(&context->in_txn, memory_order_acquire);
+        }
+        count++;
+    }
+
+    return count;
+}
+
+void thread_context_t_destroy_all(region_t *region)
+{
+    for (thread_record_t *record = thread_record_list_t_first(&region->thread_contexts); record; record = record->next)
+    {
+        thread_context_t *context = (thread_context_t *)record;
+        if (context->read_set)
+        {
+            read_set_t_destroy(context->read_set);
+        }
+        if (context->write_set)
+        {
+            set_t_destroy(context->write_set);
+        }
+    }
+
+    thread_record_list_t_destroy(&region->thread_contexts);
+}
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "thread_records.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+
+/**
+ * @brief Records held by a thread, released when it exits.
+ *
+ */
+typedef struct thread_records
+{
+    thread_record_t *records[THREAD_RECORDS_MAX_LISTS];
+    size_t count;
+} thread_records_t;
+
+static _Thread_local thread_records_t thread_records_self;
+static pthread_key_t thread_records_key;
+static pthread_once_t thread_records_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_records_t_release(void *held)
+{
+    thread_records_t *records = (thread_records_t *)held;
+
+    for (size_t i = 0; i < records->count; i++)
+    {
+        thread_record_t_release(records->records[i]);
+    }
+    records->count = 0;
+}
+
+static void thread_records_t_create_key(void)
+{
+    pthread_key_create(&thread_records_key, thread_records_t_release);
+}
+
+/*
+    =======
+    Thread record implementations
+    =======
+*/
+
+thread_record_t *thread_record_list_t_claim(thread_record_list_t *list)
+{
+    // Reuse the record of an exited thread, else push a new one
+    thread_record_t *record = atomic_load_explicit(&list->head, memory_order_acquire);
+    for (; record; record = record->next)
+    {
+        bool expected = false;
+        if (!atomic_load_explicit(&record->in_use, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&record->in_use, &expected, true, memory_order_acq_rel, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (!record)
+    {
+        size_t size = (list->record_size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+        record = (thread_record_t *)aligned_alloc(CACHE_LINE_SIZE, size);
+        if (unlikely(!record))
+        {
+            return NULL;
+        }
+        memset(record, 0, size);
+        atomic_init(&record->in_use, true);
+
+        record->next = atomic_load_explicit(&list->head, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&list->head, &record->next, record, memory_order_release, memory_order_relaxed))
+            ;
+    }
+
+    return record;
+}
+
+void thread_record_t_release(thread_record_t *record)
+{
+    atomic_store_explicit(&record->in_use, false, memory_order_release);
+}
+
+thread_record_t *thread_record_list_t_acquire(thread_record_list_t *list)
+{
+    pthread_once(&thread_records_key_once, thread_records_t_create_key);
+    if (unlikely(thread_records_self.count >= THREAD_RECORDS_MAX_LISTS))
+    {
+        return NULL;
+    }
+
+    thread_record_t *record = thread_record_list_t_claim(list);
+    if (unlikely(!record))
+    {
+        return NULL;
+    }
+
+    thread_records_self.records[thread_records_self.count++] = record;
+    pthread_setspecific(thread_records_key, &thread_records_self);
+
+    return record;
+}
+
+thread_record_t *thread_record_list_t_first(thread_record_list_t *list)
+{
+    return atomic_load_explicit(&list->head, memory_order_acquire);
+}
+
+void thread_record_list_t_destroy(thread_record_list_t *list)
+{
+    thread_record_t *record = atomic_load_explicit(&list->head, memory_order_acquire);
+    while (record)
+    {
+        thread_record_t *next = record->next;
+        free(record);
+        record = next;
+    }
+    atomic_store_explicit(&list->head, NULL, memory_order_relaxed);
+}
@@ -45,19 +45,203 @@
 
 // External headers
 #include <pthread.h>
+#include <sys/mman.h>
 
 // Internal headers
 #include <tm.h>
+#include <tm_ext.h>
 #include <assert.h>
 #include <string.h>
+#include <stdatomic.h>
 
 #include "globals.h"
 #include "tm_types.h"
 #include "utils.h"
 #include "rw_sets.h"
+#include "redo_log.h"
+#include "checkpoint.h"
+#include "latency.h"
+#include "conflict.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "shm_region.h"
+#include "thread_context.h"
 
 #include "macros.h"
 
+/** Allocate and initialize the fields of a region, apart from its first segment.
+ * @param size       Size of the first shared segment of memory (in bytes)
+ * @param align      Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param shm        Shared-memory object to place the region in, NULL for a process-private region
+ * @param lazy_locks Leave the lock table to be faulted in by its first uses, instead of initializing it
+ * @return The region, NULL on failure
+ **/
+static region_t *tm_region_init(size_t size, size_t align, shm_region_header_t *shm, bool lazy_locks)
+{
+    // Allocate memory for the region struct fields (most of it is the lock table)
+    mem_kind_t region_mem_kind = MEM_KIND_SHM;
+    region_t *region = shm          ? (region_t *)shm_region_t_region(shm)
+                       : lazy_locks ? (region_t *)mem_alloc_zeroed(sizeof(region_t), _Alignof(region_t), &region_mem_kind)
+                                    : (region_t *)mem_alloc(sizeof(region_t), _Alignof(region_t), &region_mem_kind);
+    if (unlikely(!region))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation for new TM region failed!\n");
+        return NULL;
+    }
+    region->region_mem_kind = region_mem_kind;
+    region->shm = shm;
+
+    // Initialize the segment_list lock (shared by the processes attached to the region, if any)
+    if (unlikely(!(shm ? def_lock_t_init_shared(&region->segment_list_lock) : def_lock_t_init(&region->segment_list_lock))))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation of segment lock of the TM failed!\n");
+        mem_free(region, sizeof(region_t), region_mem_kind);
+        return NULL;
+    }
+
+    // Initialize the region struct fields
+    region->start = NULL;
+    region->size = size;
+    region->align = align;
+    region->allocs = NULL;
+    region->redo_log = NULL;
+    region->recovered = NULL;
+    region->recovered_count = 0;
+    region->checkpoint_map = NULL;
+    region->checkpoint_map_size = 0;
+    region->start_mem_kind = MEM_KIND_HEAP;
+    utils_colocated_init(region);
+
+    // Initialize the global versioned clock of each shard
+    for (int shard = 0; shard < REGION_SHARDS; shard++)
+    {
+        global_versioned_clock_t_init(&region->global_versioned_clock[shard]);
+        atomic_init(&region->shard_arena_used[shard], 0);
+    }
+
+    // Reserve the address space of the shards > 0: their pages are only allocated when their segments are used
+    region->shard_arena = NULL;
+    if (REGION_SHARDS > 1)
+    {
+        void *arena = mmap(NULL, (size_t)(REGION_SHARDS - 1) << SHARD_ARENA_SHIFT, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (unlikely(arena == MAP_FAILED))
+        {
+            dprint_cwarn(COLOR_RED, stdout, "tm_create: Reserving the address space of the shards failed!\n");
+            def_lock_t_destroy(&region->segment_list_lock);
+            mem_free(region, sizeof(region_t), region_mem_kind);
+            return NULL;
+        }
+        region->shard_arena = (char *)arena;
+    }
+
+    mem_account_t_init(&region->segment_account);
+    mem_account_t_init(&region->set_account);
+    region->memory_callback = NULL;
+    region->memory_callback_arg = NULL;
+    atomic_init(&region->thread_contexts.head, NULL);
+    region->thread_contexts.record_size = sizeof(thread_context_t);
+
+    // Reserve the address space of the object segments (a private mapping: not for the regions shared by processes)
+    region->object_arena = NULL;
+    region->object_arena_size = 0;
+    for (int class = 0; class < OBJECT_CLASSES; class++)
+    {
+        atomic_init(&region->object_arena_used[class], 0);
+    }
+    if (OBJECT_LOCKS && !COLOCATED_LOCKS && !shm)
+    {
+        void *arena = mmap(NULL, (size_t)OBJECT_CLASSES << OBJECT_ARENA_SHIFT, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena != MAP_FAILED)
+        {
+            region->object_arena = (char *)arena;
+            region->object_arena_size = (size_t)OBJECT_CLASSES << OBJECT_ARENA_SHIFT;
+        }
+        else
+        {
+            // The object hints are ignored: every segment has one lock per word
+            dprint_cwarn(COLOR_RESET, stdout, "tm_create: Reserving the address space of the object segments failed!\n");
+        }
+    }
+
+    // Initialized all spinlocks. Spinlocks are mapped to shared memory regions
+    // Freshly mapped memory already holds unlocked locks: with first-touch placement (or lazy locks), the pages are left to
+    // the worker threads (a shared-memory object is always left untouched: its pages are only allocated when used)
+    if (!(region_mem_kind == MEM_KIND_SHM || ((FIRST_TOUCH_PLACEMENT || lazy_locks) && mem_is_zeroed(region_mem_kind))))
+    {
+        for (int i = 0; i < REGION_LOCK_TABLE_SIZE; i++)
+        {
+            versioned_write_spinlock_t_init(&region->versioned_write_spinlock[i]);
+        }
+    }
+
+    return region;
+}
+
+/** Create a new shared memory region, with its first segment (word granularity, or objects of one lock each).
+ * @param size        Size of the first shared segment of memory to allocate (in bytes)
+ * @param align       Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param object_size Size of the objects of the first segment, 0 for one lock per word
+ * @param log_path    Path of the redo log of the region (recovered, then appended to), NULL for none
+ * @return The region, NULL on failure
+ **/
+static region_t *tm_create_region(size_t size, size_t align, size_t object_size, char const *log_path)
+{
+    region_t *region = tm_region_init(size, align, NULL, false);
+    if (unlikely(!region))
+    {
+        return NULL;
+    }
+    size_t object_shift = utils_object_shift_of(region, object_size);
+
+    // Allign and allocate start memory for the shared region (word_size=align)
+    // With co-located locks, the memory also holds the lock of each block, and blocks must be aligned
+    size_t physical_size = utils_physical_size(region, size);
+    if (object_shift > 0)
+    {
+        // Still zeroed: the object arena is never reused
+        region->start = utils_object_arena_alloc(region, object_shift, physical_size, 0);
+    }
+    else
+    {
+        region->start = mem_alloc(physical_size, COLOCATED_LOCKS ? region->colocated_block_size : align, &region->start_mem_kind);
+        if (region->start && !(FIRST_TOUCH_PLACEMENT && mem_is_zeroed(region->start_mem_kind)))
+        {
+            memset(region->start, 0, physical_size);
+        }
+    }
+    if (unlikely(!region->start))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation of start location of TM failed!\n");
+        tm_destroy(region);
+        return NULL;
+    }
+
+    // The first segment gets the segment id 1 (see tm_start)
+    void *user_start;
+    if (COLOCATED_LOCKS && unlikely(!utils_register_segment(region, region->start, &user_start)))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation of the segment table of the TM failed!\n");
+        tm_destroy(region);
+        return NULL;
+    }
+
+    // Recover the region from its redo log (if any), and keep logging the commits to it
+    if (DURABLE_REDO_LOG && log_path)
+    {
+        region->redo_log = redo_log_t_open(region, log_path);
+        if (unlikely(!region->redo_log))
+        {
+            dprint_cwarn(COLOR_RED, stdout, "tm_create: Opening the redo log failed!\n");
+            tm_destroy(region);
+            return NULL;
+        }
+    }
+
+    return region;
+}
+
 /** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
  * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
  * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
@@ -65,44 +249,86 @@
  **/
 shared_t tm_create(size_t size, size_t align)
 {
-    // Allocate memory for the region struct fields
-    region_t *region = (region_t *)malloc(sizeof(region_t));
-    if (unlikely(!region))
+    region_t *region = tm_create_region(size, align, 0, NULL);
+
+    return region ? (shared_t)region : invalid_shared;
+}
+
+/** Create a new shared memory region whose first segment holds objects of a fixed size, always accessed as a unit:
+ * all the words of an object map to one versioned lock (see tm_alloc_objects).
+ * @param size        Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the object size
+ * @param align       Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param object_size Size of the objects (in bytes), must be a positive multiple of the alignment
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create_objects(size_t size, size_t align, size_t object_size)
+{
+    region_t *region = tm_create_region(size, align, object_size, NULL);
+
+    return region ? (shared_t)region : invalid_shared;
+}
+
+/** Create a new shared memory region whose commits are logged to a redo log (compiled in with DURABLE_REDO_LOG).
+ * If the log exists, the region is first recovered from it (see tm_recovered_address), and the log is compacted.
+ * A log is used by one region at a time: the creation fails if another region (of any process) uses it.
+ * @param path  Path of the redo log of the region
+ * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure (or if the log does not match the size/alignment)
+ **/
+shared_t tm_create_durable(char const *path, size_t size, size_t align)
+{
+    if (!DURABLE_REDO_LOG)
     {
-        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation for new TM region failed!\n");
+        dprint_cwarn(COLOR_RED, stdout, "tm_create_durable: The redo log is not compiled in (DURABLE_REDO_LOG)!\n");
         return invalid_shared;
     }
 
-    // Allign and allocate start memory for the shared region (word_size=align)
-    if (unlikely(posix_memalign(&(region->start), align, size)))
+    region_t *region = tm_create_region(size, align, 0, path);
+
+    return region ? (shared_t)region : invalid_shared;
+}
+
+/** [thread-safe] Get the error of the redo log of a region created by tm_create_durable. Once a record could not be written
+ * or synced, the failure is sticky: every later write txn aborts and tm_alloc fails, while the commits acknowledged before
+ * it stay durable. The txns whose tm_end returned true while (or after) the log failed are committed, but not durable.
+ * @param shared Shared memory region to query
+ * @return The errno of the failure, 0 if the log did not fail (or the region has no log)
+ **/
+int tm_durability_error(shared_t shared)
+{
+    region_t *region = (region_t *)shared;
+
+    return (DURABLE_REDO_LOG && region->redo_log) ? redo_log_t_error(region->redo_log) : 0;
+}
+
+/** Create a new shared memory region from a checkpoint file written by tm_checkpoint.
+ * The file is mapped copy-on-write instead of being copied, and the lock table is left to be faulted in by its first
+ * uses instead of being initialized, so the region is usable right away.
+ * @param path Path of the checkpoint file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create_from_checkpoint(char const *path)
+{
+    size_t size, align;
+    if (unlikely(!checkpoint_t_read_geometry(path, &size, &align)))
     {
-        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation of start location of TM failed!\n");
-        free(region);
+        dprint_cwarn(COLOR_RED, stdout, "tm_create_from_checkpoint: %s is not a valid checkpoint!\n", path);
         return invalid_shared;
     }
 
-    // Initialize the segment_list lock
-    if (unlikely(!def_lock_t_init(&region->segment_list_lock)))
+    region_t *region = tm_region_init(size, align, NULL, true);
+    if (unlikely(!region))
     {
-        dprint_cwarn(COLOR_RED, stdout, "tm_create: Allocation of segment lock of the TM failed!\n");
-        free(region->start);
-        free(region);
         return invalid_shared;
     }
 
-    // Initialize the region struct fields
-    memset(region->start, 0, size);
-    region->size = size;
-    region->align = align;
-    region->allocs = NULL;
-
-    // Initialize the global versioned clock
-    global_versioned_clock_t_init(&region->global_versioned_clock);
-
-    // Initialized all spinlocks. Spinlocks are mapped to shared memory regions
-    for (int i = 0; i < VWSL_NUM; i++)
+    // Note: the redo log (if enabled) is not attached, the checkpoint is the state of the region
+    if (unlikely(!checkpoint_t_map(region, path)))
     {
-        versioned_write_spinlock_t_init(&region->versioned_write_spinlock[i]);
+        dprint_cwarn(COLOR_RED, stdout, "tm_create_from_checkpoint: Mapping %s failed!\n", path);
+        tm_destroy(region);
+        return invalid_shared;
     }
 
     return region;
@@ -115,13 +341,36 @@ void tm_destroy(shared_t shared)
 {
     region_t *region = (region_t *)shared;
 
-    // Free the start address of the region
-    free(region->start);
+    // The region (and its segments) lives on in the shared-memory object, for the other processes
+    if (region->shm)
+    {
+        shm_region_t_detach(region->shm);
+        return;
+    }
+
+    // The other threads exited the region before (see tm_thread_exit): only the calling one may still be registered
+    thread_context_t_exit(region);
+    thread_context_t_destroy_all(region);
+
+    // Make every logged commit durable before the region goes away
+    if (region->redo_log)
+    {
+        redo_log_t_close(region->redo_log);
+    }
+
+    // Free the start address of the region (unless it is mapped from a checkpoint, or carved from the object arena)
+    if (region->start && !checkpoint_t_contains(region, region->start) && utils_object_shift(region, region->start) == 0)
+    {
+        mem_free(region->start, utils_physical_size(region, region->size), region->start_mem_kind);
+    }
 
     // Destroy the locks related to this region
-    global_versioned_clock_t_destroy(&region->global_versioned_clock);
+    for (int shard = 0; shard < REGION_SHARDS; shard++)
+    {
+        global_versioned_clock_t_destroy(&region->global_versioned_clock[shard]);
+    }
     def_lock_t_destroy(&region->segment_list_lock);
-    for (int i = 0; i < VWSL_NUM; i++)
+    for (int i = 0; i < REGION_LOCK_TABLE_SIZE; i++)
     {
         versioned_write_spinlock_t_destroy(&region->versioned_write_spinlock[i]);
     }
@@ -129,12 +378,35 @@ void tm_destroy(shared_t shared)
     // Free all the allocated segments
     while (region->allocs) {
         segment_list tail = region->allocs->next;
-        free(region->allocs);
+        if (!checkpoint_t_contains(region, region->allocs) && utils_shard_of(region, region->allocs) == 0 &&
+            utils_object_shift(region, region->allocs) == 0)
+        {
+            free(region->allocs);
+        }
         region->allocs = tail;
     }
 
+    if (region->checkpoint_map)
+    {
+        munmap(region->checkpoint_map, region->checkpoint_map_size);
+    }
+    if (region->shard_arena)
+    {
+        munmap(region->shard_arena, (size_t)(REGION_SHARDS - 1) << SHARD_ARENA_SHIFT);
+    }
+    if (region->object_arena)
+    {
+        munmap(region->object_arena, region->object_arena_size);
+    }
+    free(region->recovered);
+
+    for (int i = 0; i < COLOCATED_DIRECTORY_SIZE; i++)
+    {
+        free(region->segment_directory[i]);
+    }
+
     // Free the region struct
-    free(region);
+    mem_free(region, sizeof(region_t), region->region_mem_kind);
 }
 
 /** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
@@ -143,6 +415,12 @@ void tm_destroy(shared_t shared)
  **/
 void *tm_start(shared_t shared)
 {
+    if (COLOCATED_LOCKS)
+    {
+        // Logical address of the first word of the segment with id 1
+        return (void *)((uintptr_t)1 << COLOCATED_SEGMENT_SHIFT);
+    }
+
     return ((region_t *)shared)->start;
 }
 
@@ -164,6 +442,25 @@ size_t tm_align(shared_t shared)
     return ((region_t *)shared)->align;
 }
 
+/**
+ * @brief Report a read aborting a txn to the diagnostics (conflict profiler, trace, hardware counters), if they are compiled in.
+ */
+static inline void tm_note_read_abort(txn_t *txn, void *word_addr)
+{
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_read);
+    }
+    if (CONFLICT_PROFILER)
+    {
+        conflict_t_record(word_addr);
+    }
+    if (TRACE_EVENTS)
+    {
+        trace_t_event(TRACE_READ_ABORT, txn, (uintptr_t)word_addr);
+    }
+}
+
 /** [thread-safe] Begin a new transaction on the given shared memory region.
  * @param shared Shared memory region to start a transaction on
  * @param is_ro  Whether the transaction is read-only
@@ -174,9 +471,9 @@ tx_t tm_begin(shared_t shared, bool is_ro)
     region_t *region = (region_t *)shared;
 
     // Here, we create a new transaction and return a pointer to the struct representing the transaction
-    // TL2 Algorithm: Sample load the current value of the global version clock as rv
+    // TL2 Algorithm: Sample load the current value of the global version clock as rv (of every shard)
 
-    txn_t *txn = txn_t_init(is_ro, global_versioned_clock_t_get_clock(&region->global_versioned_clock), -1);
+    txn_t *txn = txn_t_init(region, is_ro, -1);
     if (unlikely(!txn))
     {
         dprint_cwarn(COLOR_RESET, stdout, "tm_begin: Could not allocate a new transaction!\n");
@@ -203,19 +500,27 @@ bool tm_end(shared_t shared, tx_t tx)
         // Read-only txns are validated each time they read a word
         // Reaching this point means that all the reads are succesfully validated
         // Thus, it can commit right away. Same goes for write txns that did not write anything.
-        commit_result = COMMIT;
+        // Ranges read in place were only validated before being read.
+        commit_result = !txn->read_in_place || utils_validate_read_set(region, txn->read_set, txn->rv, NULL);
     }
     else
     {
         // Check commit using TL2 algorithm
+        if (TRACE_EVENTS)
+        {
+            trace_t_event(TRACE_COMMIT_START, txn, 0);
+        }
         commit_result = utils_check_commit(region, txn);
+        if (TRACE_EVENTS)
+        {
+            trace_t_event(TRACE_COMMIT_END, txn, commit_result);
+        }
     }
 
     // Dealloacate the memory used for this txn
+    txn->committed = commit_result;
     txn_t_destroy(txn);
 
-    dprint_clog(COLOR_RESET, stdout, "tm_end  [%lu]: Deallocated. Commit: %d\n", (tx_t)txn, commit_result);
-
     return commit_result;
 }
 
@@ -234,7 +539,10 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
     txn_t *txn = (txn_t *)tx;
     size_t word_size = region->align;
 
-    dprint_clog(COLOR_RESET, stdout, "tm_read [%lu]:  Reading from %lu to %lu\n", (tx_t)txn, source, target);
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
 
     if (txn->is_ro)
     {
@@ -255,17 +563,25 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
         // Iterate over the words of the region to be read
         for (size_t i = 0; i < size; i += word_size)
         {
-            void *word_addr = (char *)source + i; // Source is the TM segment
-            void *targ_addr = (char *)target + i; // Target is the memory that the value of the TM words will be stored
+            void *word_addr = utils_translate(region, (char *)source + i); // Source is the TM segment
+            void *targ_addr = (char *)target + i;                          // Target is the memory that the value of the TM words will be stored
 
             // Get the versioned write spinlock for this word and validate it
-            versioned_write_spinlock_t *vws = utils_get_mapped_lock(region->versioned_write_spinlock, word_addr);
+            versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, word_addr);
             
+            size_t shard = utils_shard_of(region, word_addr);
+
             // Pre-Validate the lock
             int l = versioned_write_spinlock_t_load(vws);
+            if (WAIT_ON_LOCKED_STRIPES && (l & 0x1))
+            {
+                // Let the owner finish its commit: the txn goes on if the word it wrote is still older than rv
+                l = versioned_write_spinlock_t_wait_unlocked(vws);
+            }
             int readv = l >> 1;
-            if (l & 0x1 || (readv > txn->rv))
+            if (l & 0x1 || (readv > txn->rv[shard]))
             {
+                tm_note_read_abort(txn, word_addr);
                 txn_t_destroy(txn);
                 return false;
             }
@@ -277,12 +593,11 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
             int after_readv = n >> 1;
             if (n & 0x1 || after_readv != readv)
             {
+                tm_note_read_abort(txn, word_addr);
                 txn_t_destroy(txn);
                 return false;
             }
         }
-
-        dprint_clog(COLOR_RESET, stdout, "tm_read [%lu]:  Read only txn, validated all locks and copied the values\n", (tx_t)txn);
     }
     else
     {
@@ -312,8 +627,8 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
         // Iterate over the memory words (word_size = align)
         for (size_t i = 0; i < size; i += word_size)
         {
-            void *word_addr = (char *)source + i; // Source is the TM region to be read
-            void *targ_addr = (char *)target + i; // Target is the memory that the value of the TM words will be stored
+            void *word_addr = utils_translate(region, (char *)source + i); // Source is the TM region to be read
+            void *targ_addr = (char *)target + i;                          // Target is the memory that the value of the TM words will be stored
 
             // Check if the source_word appears in the write set.
             void *val = set_t_get_val_or_null(txn->write_set, word_addr);
@@ -324,13 +639,21 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
                 continue;
             }
 
-            versioned_write_spinlock_t *vws = utils_get_mapped_lock(region->versioned_write_spinlock, word_addr);
+            versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, word_addr);
             
+            size_t shard = utils_shard_of(region, word_addr);
+
             // Pre-Validate the lock
             int l = versioned_write_spinlock_t_load(vws);
+            if (WAIT_ON_LOCKED_STRIPES && (l & 0x1))
+            {
+                // Let the owner finish its commit: the txn goes on if the word it wrote is still older than rv
+                l = versioned_write_spinlock_t_wait_unlocked(vws);
+            }
             int readv = l >> 1;
-            if (l & 0x1 || (readv > txn->rv))
+            if (l & 0x1 || (readv > txn->rv[shard]))
             {
+                tm_note_read_abort(txn, word_addr);
                 txn_t_destroy(txn);
                 return false;
             }
@@ -342,19 +665,24 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
             int after_readv = n >> 1;
             if (n & 0x1 || after_readv != readv)
             {
+                tm_note_read_abort(txn, word_addr);
                 txn_t_destroy(txn);
                 return false;
             }
 
-            if (unlikely(!set_t_add_or_update(txn->read_set, word_addr, NULL, word_size)))
+            if (unlikely(!read_set_t_add(txn->read_set, utils_read_set_entry(region, vws), word_addr)))
             {
                 txn_t_destroy(txn);
                 exit(EXIT_FAILURE);
             }
+            txn->read_shards |= 1u << shard;
         }
     }
 
-    dprint_clog(COLOR_RESET, stdout, "tm_read [%lu]:  Actions passed, txn can continue!\n", (tx_t)txn);
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_read);
+    }
 
     return true;
 }
@@ -384,15 +712,18 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
     // Specifically, txn aims to write the source data to the target data
     //
 
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
+
     // Iterate the words of the segment (word_size = align)
     for (size_t i = 0; i < size; i += region->align)
     {
-        void *word_addr = (char *)target + i;   // Target is the address of the segment in the TM
-        void *source_addr = (char *)source + i; // Source contents are the data to be written
+        void *word_addr = utils_translate(region, (char *)target + i); // Target is the address of the segment in the TM
+        void *source_addr = (char *)source + i;                        // Source contents are the data to be written
         size_t word_size = region->align;
 
-        dprint_clog(COLOR_RESET, stdout, "tm_write[%lu]:  Word write from %lu to %lu\n", (tx_t)txn, source_addr, word_addr);
-
         // Add or update the entry of word_addr in the write set, setting the value to source_addr
         if (unlikely(!set_t_add_or_update(txn->write_set, word_addr, source_addr, word_size)))
         {
@@ -402,6 +733,11 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
         }
     }
 
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_write);
+    }
+
     return true;
 }
 
@@ -417,30 +753,20 @@ alloc_t tm_alloc(shared_t shared, tx_t unused(tx), size_t size, void **target)
     // Infer the region associated with this alloc call
     region_t *region = (region_t *)shared;
 
-    // Make sure alignment is okay
-    size_t align = region->align;
-    align = align < sizeof(segment_t *) ? sizeof(void *) : align;
-
-    // Allocate the memory for this new segment
-    segment_t *sn;
-    if (unlikely(posix_memalign((void **)&sn, align, sizeof(segment_t) + size) != 0))
+    // Allocate the memory for this new segment and insert it in the segment list
+    void *segment;
+    if (unlikely(!utils_alloc_segment(region, size, &segment)))
     {
         dprint_cwarn(COLOR_RESET, stdout, "tm_alloc[%lu]: Something went wrong when memalign. Stoppping!\n", tx);
         return nomem_alloc;
     }
 
-    // Insert the segment in the linked list in a thread-safe way
-    def_lock_t_lock(&region->segment_list_lock);
-    sn->prev = NULL;
-    sn->next = region->allocs;
-    if (sn->next)
-        sn->next->prev = sn;
-    region->allocs = sn;
-    def_lock_t_unlock(&region->segment_list_lock);
-
-    // Initialize segment words with NULL
-    void *segment = (void *)((uintptr_t)sn + sizeof(segment_t));
-    memset(segment, 0, size);
+    // Log the segment before its address is published, so that every write to it is logged after it
+    if (DURABLE_REDO_LOG && region->redo_log && unlikely(!redo_log_t_append_alloc(region->redo_log, segment, size)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_alloc[%lu]: Could not log the new segment!\n", tx);
+        return nomem_alloc;
+    }
 
     // Set the target pointing to the first word of this newly allocated segment
     *target = segment;
@@ -459,3 +785,917 @@ bool tm_free(shared_t unused(shared), tx_t unused(tx), void *unused(target))
     // Note: All the segments allocated by any txn will be freed when the region is destroyed.
     return true;
 }
+
+/** [thread-safe] Translate an address of the shared memory region from before a restart to its address after the restart,
+ * for regions recovered from the redo log (by tm_create_durable) or created from a checkpoint.
+ * @param shared Shared memory region to query
+ * @param addr   Address (in a segment of the region) before the restart
+ * @return Address after the restart, NULL if it was not part of a restored segment
+ **/
+void *tm_recovered_address(shared_t shared, void const *addr)
+{
+    region_t *region = (region_t *)shared;
+
+    segment_range_t *range = utils_find_range(region->recovered, region->recovered_count, (uintptr_t)addr, 0);
+    if (!range)
+    {
+        return NULL;
+    }
+
+    return range->new_start + ((uintptr_t)addr - range->old_start);
+}
+
+/** [thread-safe] Write a consistent snapshot of the shared memory region to a file, chunk by chunk. The running transactions
+ * are not blocked, unless the chunks they write keep changing: their stripes are then locked until the snapshot is complete.
+ * @param shared Shared memory region to checkpoint
+ * @param path   Path of the checkpoint file (replaced atomically)
+ * @return Whether the checkpoint was written
+ **/
+bool tm_checkpoint(shared_t shared, char const *path)
+{
+    return checkpoint_t_write((region_t *)shared, path);
+}
+
+/** Delay the next attempt of a logical txn of a batch by a randomized exponential backoff.
+ * @param attempt Attempts of the logical txn so far
+ * @param seed    State of the pseudo-random generator of the batch
+ **/
+static void tm_batch_backoff(unsigned attempt, uint64_t *seed)
+{
+    *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+    unsigned shift = attempt < BATCH_BACKOFF_MAX_SHIFT ? attempt : BATCH_BACKOFF_MAX_SHIFT;
+    for (uint64_t pause = (*seed >> 33) & (((uint64_t)1 << shift) - 1); pause > 0; pause--)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        atomic_signal_fence(memory_order_seq_cst);
+#endif
+    }
+}
+
+/** [thread-safe] Run a batch of small logical transactions as a single txn (one clock increment, one pass over the locks).
+ * If the combined txn aborts, the logical transactions are committed one by one instead, each one attempted up to
+ * BATCH_MAX_ATTEMPTS times with a randomized exponential backoff in between. The batch stops at the first logical
+ * transaction that cannot commit, so the committed ones are always a prefix of the batch.
+ * @param shared    Shared memory region to access
+ * @param entries   The logical transactions, in order
+ * @param count     Number of logical transactions
+ * @param committed Receives the number of logical transactions committed (i.e. the index of the first one not committed),
+ *                  may be NULL
+ * @return Whether every logical transaction committed
+ **/
+bool tm_batch(shared_t shared, tm_batch_entry_t const *entries, size_t count, size_t *committed)
+{
+    size_t done = 0;
+    tx_t tx = tm_begin(shared, false);
+    if (likely(tx != invalid_tx))
+    {
+        size_t i = 0;
+        while (i < count && entries[i].op(shared, tx, entries[i].arg))
+        {
+            i++;
+        }
+
+        // An aborted logical txn has destroyed the combined txn
+        done = (i == count && tm_end(shared, tx)) ? count : 0;
+    }
+
+    // Fallback: a conflict on one logical txn must not keep re-aborting the whole batch
+    uint64_t seed = (uint64_t)(uintptr_t)&seed; // Differs between the threads (stack address)
+    for (unsigned attempt = 0; done < count && attempt < BATCH_MAX_ATTEMPTS;)
+    {
+        tx = tm_begin(shared, false);
+        if (likely(tx != invalid_tx) && entries[done].op(shared, tx, entries[done].arg) && tm_end(shared, tx))
+        {
+            done++;
+            attempt = 0; // Each logical txn has its own attempts
+        }
+        else if (++attempt < BATCH_MAX_ATTEMPTS)
+        {
+            tm_batch_backoff(attempt, &seed);
+        }
+    }
+
+    if (committed)
+    {
+        *committed = done;
+    }
+
+    return done == count;
+}
+
+/** [thread-safe] Get a pointer to a range of the shared memory region, to read it without copying it (seqlock pattern).
+ * The range is added to the read set of the txn: the data read in place can only be trusted after a successful tm_validate
+ * (or tm_end), and must not be accessed after the end of the txn. Later writes of the txn to the range are not visible through it.
+ * @param shared Shared memory region to access
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to read (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer receiving the address to read from. NULL when the range cannot be read in place (then use tm_read):
+ *               with the co-located lock layout, or when the txn wrote to the range
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_read_in_place(shared_t shared, tx_t tx, void const *source, size_t size, void const **target)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    *target = NULL;
+    if (COLOCATED_LOCKS)
+    {
+        // The words of a range are not contiguous in this layout
+        return true;
+    }
+
+    // The shared memory would not show the values written by this txn
+    if (set_t_overlaps(txn->write_set, (void *)source, size))
+    {
+        return true;
+    }
+
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
+
+    // Pre-validate the stripes of the range: the data is only read by the caller, validation happens in tm_validate
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, (char *)source + i);
+        int l = versioned_write_spinlock_t_load(vws);
+        if (WAIT_ON_LOCKED_STRIPES && (l & 0x1))
+        {
+            l = versioned_write_spinlock_t_wait_unlocked(vws);
+        }
+
+        if (l & 0x1 || (l >> 1) > txn->rv[utils_shard_of(region, (char *)source + i)])
+        {
+            tm_note_read_abort(txn, (char *)source + i);
+            txn_t_destroy(txn);
+            return false;
+        }
+
+        if (unlikely(!read_set_t_add(txn->read_set, utils_read_set_entry(region, vws), (char *)source + i)))
+        {
+            txn_t_destroy(txn);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    txn->read_in_place = true;
+    txn->read_shards |= 1u << utils_shard_of(region, source);
+    *target = source;
+
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_read);
+    }
+
+    return true;
+}
+
+/** [thread-safe] Check that every word read by the transaction so far (in particular in place) is still unchanged.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to validate
+ * @return Whether the whole transaction can continue (if not, the transaction was aborted)
+ **/
+bool tm_validate(shared_t shared, tx_t tx)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    // The loads of the data read in place must not be reordered after the loads of the versions
+    atomic_thread_fence(memory_order_acquire);
+
+    if (!utils_validate_read_set(region, txn->read_set, txn->rv, NULL))
+    {
+        txn_t_destroy(txn);
+        return false;
+    }
+
+    return true;
+}
+
+/** [thread-safe] Read operation for data that the caller knows to be immutable while the txn runs (e.g. written once, before
+ * being published): the words are copied without any validation, and are not added to the read set. A word written
+ * concurrently may be read torn, and the writes of the txn itself to the range are not visible.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @return Whether the whole transaction can continue (always true)
+ **/
+bool tm_read_unvalidated(shared_t shared, tx_t unused(tx), void const *source, size_t size, void *target)
+{
+    region_t *region = (region_t *)shared;
+
+    if (!COLOCATED_LOCKS)
+    {
+        memcpy(target, source, size);
+        return true;
+    }
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        memcpy((char *)target + i, utils_translate(region, (char const *)source + i), region->align);
+    }
+
+    return true;
+}
+
+/** [thread-safe] Early release: remove the stripes of a range from the read set of the transaction, so that the commit no
+ * longer validates them (e.g. the nodes left behind by a traversal, of which only the last ones matter). The txn is then
+ * only serializable if its outcome does not depend on the released words, which is up to the caller. Every word of a
+ * released stripe is released, including the words of other ranges that share the stripe (the words of one object).
+ * Read-only transactions keep no read set: nothing to release.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Start address of the range (in the shared region)
+ * @param size   Length of the range (in bytes), must be a positive multiple of the alignment
+ **/
+void tm_release(shared_t shared, tx_t tx, void const *source, size_t size)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    if (txn->is_ro)
+    {
+        return;
+    }
+
+    // The stripes of the range, removed at once. Each word has its own stripe (consecutive words have consecutive ones),
+    // but the words of an object, or of a block of the co-located layout, share one
+    read_set_entry_t local[64];
+    read_set_entry_t *entries = local;
+    size_t capacity = sizeof(local) / sizeof(local[0]);
+    if (size / region->align > capacity)
+    {
+        // Without memory, the stripes are removed by batches of the local array (one pass over the read set per batch)
+        read_set_entry_t *all = (read_set_entry_t *)malloc(size / region->align * sizeof(read_set_entry_t));
+        if (likely(all))
+        {
+            entries = all;
+            capacity = size / region->align;
+        }
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        void *word_addr = utils_translate(region, (char const *)source + i);
+        read_set_entry_t entry = utils_read_set_entry(region, utils_get_mapped_lock(region, word_addr));
+        if (count > 0 && entries[count - 1] == entry)
+        {
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            read_set_t_remove(txn->read_set, entries, count);
+            count = 0;
+        }
+        entries[count++] = entry;
+    }
+
+    read_set_t_remove(txn->read_set, entries, count);
+    if (entries != local)
+    {
+        free(entries);
+    }
+}
+
+/** [thread-safe] Write operation that borrows the source buffer instead of copying it into the write set.
+ * Contract: the source buffer must stay alive and unchanged until tm_end returns (the commit copies from it into the
+ * shared memory). It is checked at commit with DEBUG_CHECKS. The txn may still read and write the target range.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param source Source start address (in a private region, borrowed until the end of the transaction)
+ * @param size   Length to write (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in the shared region)
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_write_borrowed(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
+{
+    txn_t *txn = (txn_t *)tx;
+
+    // The words of a range are not contiguous in the co-located layout, and words already written are updated in place
+    if (COLOCATED_LOCKS || set_t_overlaps(txn->write_set, target, size))
+    {
+        return tm_write(shared, tx, source, size, target);
+    }
+
+    if (unlikely(!set_t_add_borrowed(txn->write_set, target, source, size)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_write_borrowed[%lu]:  Something went wrong when adding data to write-set.\n", (tx_t)txn);
+        txn_t_destroy(txn);
+        exit(EXIT_FAILURE);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read a range of the shared memory region into a private buffer with one bulk copy: the stripes of the range are
+ * pre-validated (and added to the read set of a write txn), then the range is copied at once, then the stripes are
+ * post-validated (free, and not newer than rv). Ranges written by the txn, and the co-located layout, go through tm_read.
+ */
+static bool tm_read_range(region_t *region, txn_t *txn, void const *source, size_t size, void *target)
+{
+    if (COLOCATED_LOCKS || set_t_overlaps(txn->write_set, (void *)source, size))
+    {
+        return tm_read(region, (tx_t)txn, source, size, target);
+    }
+
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
+
+    size_t shard = utils_shard_of(region, source); // A segment (and thus a range) never spans two shards
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, (char *)source + i);
+        int l = versioned_write_spinlock_t_load(vws);
+        if (WAIT_ON_LOCKED_STRIPES && (l & 0x1))
+        {
+            l = versioned_write_spinlock_t_wait_unlocked(vws);
+        }
+
+        if (l & 0x1 || (l >> 1) > txn->rv[shard])
+        {
+            tm_note_read_abort(txn, (char *)source + i);
+            txn_t_destroy(txn);
+            return false;
+        }
+
+        if (!txn->is_ro && unlikely(!read_set_t_add(txn->read_set, utils_read_set_entry(region, vws), (char *)source + i)))
+        {
+            txn_t_destroy(txn);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(target, source, size);
+
+    // The loads of the range must not be reordered after the loads of the versions
+    atomic_thread_fence(memory_order_acquire);
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        int l = versioned_write_spinlock_t_load(utils_get_mapped_lock(region, (char *)source + i));
+        if (l & 0x1 || (l >> 1) > txn->rv[shard])
+        {
+            tm_note_read_abort(txn, (char *)source + i);
+            txn_t_destroy(txn);
+            return false;
+        }
+    }
+
+    if (!txn->is_ro)
+    {
+        txn->read_shards |= 1u << shard;
+    }
+
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_read);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Add a range to the write set of a txn as a single node owning the (malloc'ed) values, freed with the write set.
+ * Ranges overlapping words already written, and the co-located layout, go through tm_write (and the values are freed).
+ */
+static bool tm_write_range(region_t *region, txn_t *txn, void *values, size_t size, void *target)
+{
+    if (COLOCATED_LOCKS || set_t_overlaps(txn->write_set, target, size))
+    {
+        bool result = tm_write(region, (tx_t)txn, values, size, target);
+        free(values);
+        return result;
+    }
+
+    if (unlikely(!set_t_add_owned(txn->write_set, target, values, size)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_write_range[%lu]:  Something went wrong when adding data to write-set.\n", (tx_t)txn);
+        free(values);
+        txn_t_destroy(txn);
+        exit(EXIT_FAILURE);
+    }
+
+    return true;
+}
+
+/** [thread-safe] Copy a range of the shared memory region to another one (which may overlap it, as memmove), in a write txn.
+ * Not a zero-copy operation: the data moves twice, as with tm_read and tm_write through a private buffer. The source is
+ * read into a private buffer with one bulk copy (validated per stripe), and the target is written at commit from that
+ * buffer, as a single write-set entry. What it saves is the per-word bookkeeping (one read-set entry per stripe, one
+ * write-set node for the whole range), not the copies.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Target start address (in the shared region)
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_copy_buffered(shared_t shared, tx_t tx, void *target, void const *source, size_t size)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    void *values = malloc(size);
+    if (unlikely(!values))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_copy_buffered[%lu]:  Could not allocate the copied range.\n", tx);
+        txn_t_destroy(txn);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!tm_read_range(region, txn, source, size, values))
+    {
+        free(values);
+        return false;
+    }
+
+    return tm_write_range(region, txn, values, size, target);
+}
+
+/** [thread-safe] Set every byte of a range of the shared memory region to a value (as memset), in a write txn.
+ * The range is written at commit from a single write-set entry.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param target Target start address (in the shared region)
+ * @param byte   Value of the bytes
+ * @param size   Length to set (in bytes), must be a positive multiple of the alignment
+ * @return Whether the whole transaction can continue
+ **/
+bool tm_fill(shared_t shared, tx_t tx, void *target, uint8_t byte, size_t size)
+{
+    region_t *region = (region_t *)shared;
+    txn_t *txn = (txn_t *)tx;
+
+    void *values = malloc(size);
+    if (unlikely(!values))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_fill[%lu]:  Could not allocate the filled range.\n", tx);
+        txn_t_destroy(txn);
+        exit(EXIT_FAILURE);
+    }
+    memset(values, byte, size);
+
+    return tm_write_range(region, txn, values, size, target);
+}
+
+/** [thread-safe] Find the first word of a range whose stripe is locked (by a committing transaction), without any txn.
+ * Lets a caller that would rather not wait in, or abort, tm_read decide when to read the range (see tm_async.hpp).
+ * @param shared Shared memory region to query
+ * @param source Start address of the range (in the shared region)
+ * @param size   Length of the range (in bytes), must be a positive multiple of the alignment
+ * @return First word of the range whose stripe is locked, NULL if none is
+ **/
+void *tm_locked_word(shared_t shared, void const *source, size_t size)
+{
+    region_t *region = (region_t *)shared;
+
+    for (size_t i = 0; i < size; i += region->align)
+    {
+        void *word_addr = utils_translate(region, (char const *)source + i);
+        if (versioned_write_spinlock_t_load(utils_get_mapped_lock(region, word_addr)) & 0x1)
+        {
+            return (char *)source + i;
+        }
+    }
+
+    return NULL;
+}
+
+/** Create a new shared memory region in a named shared-memory object, so that other processes can attach to it.
+ * The clock, the lock table, the segment list and the segments all live in the object, mapped at the same address
+ * in every process. Not available with the co-located lock layout, the redo log, sharded clocks (REGION_SHARDS > 1) or
+ * WAIT_ON_LOCKED_STRIPES (its wait buckets are private to each process: the waiters would never be woken by the others).
+ * Warning: a process that dies while committing leaves the stripes it locked locked forever, for every process.
+ * @param name     Name of the shared-memory object (e.g. "/my_region"), which must not exist yet
+ * @param size     Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
+ * @param align    Alignment (in bytes, must be a power of 2) that the shared memory region must support
+ * @param capacity Memory available to tm_alloc (in bytes), for the whole life of the region
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create_shared(char const *name, size_t size, size_t align, size_t capacity)
+{
+    if (COLOCATED_LOCKS || DURABLE_REDO_LOG || REGION_SHARDS > 1 || WAIT_ON_LOCKED_STRIPES)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_create_shared: Not supported with co-located locks, the redo log, shards or waiting on locked stripes!\n");
+        return invalid_shared;
+    }
+
+    // The heap holds the first segment, then the segments of tm_alloc
+    size_t heap_size = size + align + capacity;
+    shm_region_header_t *shm = shm_region_t_create(name, sizeof(region_t), heap_size);
+    if (unlikely(!shm))
+    {
+        return invalid_shared;
+    }
+
+    region_t *region = tm_region_init(size, align, shm, false);
+    if (unlikely(!region))
+    {
+        shm_region_t_detach(shm);
+        shm_region_t_unlink(name);
+        return invalid_shared;
+    }
+
+    region->start = shm_region_t_alloc(shm, size, align);
+    region->start_mem_kind = MEM_KIND_SHM;
+
+    shm_region_t_publish(shm);
+
+    return region;
+}
+
+/** Attach to a shared memory region created (by any process) with tm_create_shared. tm_destroy detaches from it.
+ * @param name Name of the shared-memory object
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_attach_shared(char const *name)
+{
+    if (WAIT_ON_LOCKED_STRIPES)
+    {
+        dprint_cwarn(COLOR_RED, stdout, "tm_attach_shared: Not supported with waiting on locked stripes!\n");
+        return invalid_shared;
+    }
+
+    shm_region_header_t *shm = shm_region_t_attach(name);
+    if (unlikely(!shm))
+    {
+        return invalid_shared;
+    }
+
+    return shm_region_t_region(shm);
+}
+
+/** Remove the name of a shared memory region created with tm_create_shared. Its memory is released once every process detached.
+ * @param name Name of the shared-memory object
+ * @return Whether the name was removed
+ **/
+bool tm_unlink_shared(char const *name)
+{
+    return shm_region_t_unlink(name);
+}
+
+/** [thread-safe] Begin a new transaction that only accesses one shard of the shared memory region: it only samples the clock
+ * of that shard (and only bumps it on commit). Accessing another shard aborts the transaction.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param shard  Shard accessed by the transaction (less than REGION_SHARDS)
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+ **/
+tx_t tm_begin_in_shard(shared_t shared, bool is_ro, size_t shard)
+{
+    region_t *region = (region_t *)shared;
+
+    txn_t *txn = shard < REGION_SHARDS ? txn_t_init(region, is_ro, (int)shard) : NULL;
+    if (unlikely(!txn))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_begin_in_shard: Could not allocate a new transaction!\n");
+        return invalid_tx;
+    }
+
+    return (tx_t)txn;
+}
+
+/** [thread-safe] Memory allocation operation in a given shard of the shared memory region (see tm_alloc).
+ * The words of the segment are versioned by the clock of the shard. Shard 0 is the shard of tm_start and tm_alloc.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to use
+ * @param shard  Shard of the new segment (less than REGION_SHARDS)
+ * @param size   Allocation requested size (in bytes), must be a positive multiple of the alignment
+ * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+ **/
+alloc_t tm_alloc_in_shard(shared_t shared, tx_t tx, size_t shard, size_t size, void **target)
+{
+    region_t *region = (region_t *)shared;
+
+    void *segment;
+    if (unlikely(shard >= REGION_SHARDS || !utils_alloc_segment_in_shard(region, shard, size, &segment)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_alloc_in_shard[%lu]: No memory left in shard %lu!\n", tx, shard);
+        return nomem_alloc;
+    }
+
+    if (DURABLE_REDO_LOG && region->redo_log && unlikely(!redo_log_t_append_alloc(region->redo_log, segment, size)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_alloc_in_shard[%lu]: Could not log the new segment!\n", tx);
+        return nomem_alloc;
+    }
+
+    *target = segment;
+
+    return success_alloc;
+}
+
+/** [thread-safe] Memory allocation of a segment of objects of a fixed size, always accessed as a unit (see tm_alloc).
+ * All the words of an object map to one versioned lock, so that reading or writing an object adds one stripe to the read or
+ * write set (objects larger than 2^(OBJECT_MIN_SHIFT + OBJECT_CLASSES - 1) bytes, or of sizes that are not powers of 2,
+ * are locked by blocks of the largest power of 2 dividing their size). A hint: without OBJECT_LOCKS, with the co-located
+ * layout or in a region shared by processes, or if the object size is not larger than the alignment, the segment is a
+ * segment of tm_alloc. The objects of segments restored from a checkpoint or the redo log have one lock per word.
+ * @param shared      Shared memory region associated with the transaction
+ * @param tx          Transaction to use
+ * @param object_size Size of the objects (in bytes), must be a positive multiple of the alignment
+ * @param size        Allocation requested size (in bytes), must be a positive multiple of the object size
+ * @param target      Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
+ * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
+ **/
+alloc_t tm_alloc_objects(shared_t shared, tx_t tx, size_t object_size, size_t size, void **target)
+{
+    region_t *region = (region_t *)shared;
+
+    void *segment;
+    size_t shift = utils_object_shift_of(region, object_size);
+    if (shift == 0 || unlikely(!utils_alloc_segment_of_objects(region, shift, size, &segment)))
+    {
+        // Word granularity (also when the arena of the block size is full)
+        return tm_alloc(shared, tx, size, target);
+    }
+
+    if (DURABLE_REDO_LOG && region->redo_log && unlikely(!redo_log_t_append_alloc(region->redo_log, segment, size)))
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_alloc_objects[%lu]: Could not log the new segment!\n", tx);
+        return nomem_alloc;
+    }
+
+    *target = segment;
+
+    return success_alloc;
+}
+
+/** [thread-safe] Merge the latency histograms of every thread, without stopping them (see tm_latency_kind_t).
+ * @param histograms Array of tm_latency_kinds histograms receiving the merged ones
+ * @return Whether the histograms are recorded (LATENCY_HISTOGRAMS), else they are all empty
+ **/
+bool tm_latency_snapshot(tm_latency_histogram_t *histograms)
+{
+    if (!LATENCY_HISTOGRAMS)
+    {
+        memset(histograms, 0, tm_latency_kinds * sizeof(tm_latency_histogram_t));
+        return false;
+    }
+
+    latency_t_snapshot(histograms);
+
+    return true;
+}
+
+/** Smallest value counted by a bucket of the latency histograms.
+ * @param bucket Bucket index (up to TM_LATENCY_BUCKETS)
+ * @return Lower bound of the bucket
+ **/
+uint64_t tm_latency_bucket_value(size_t bucket)
+{
+    if (bucket < ((size_t)2 << TM_LATENCY_SUB_BITS))
+    {
+        return (uint64_t)bucket;
+    }
+
+    size_t magnitude = (bucket >> TM_LATENCY_SUB_BITS) + TM_LATENCY_SUB_BITS - 1;
+    if (magnitude > 63)
+    {
+        return UINT64_MAX;
+    }
+    uint64_t sub = bucket & ((1u << TM_LATENCY_SUB_BITS) - 1);
+
+    return (1ull << magnitude) | (sub << (magnitude - TM_LATENCY_SUB_BITS));
+}
+
+/** Value at a given percentile of a latency histogram (the lower bound of its bucket, at most the maximum value).
+ * @param histogram Histogram, e.g. from tm_latency_snapshot
+ * @param percentile Percentile, between 0 and 100
+ * @return Value at the percentile, 0 if the histogram is empty
+ **/
+uint64_t tm_latency_percentile(tm_latency_histogram_t const *histogram, double percentile)
+{
+    uint64_t total = 0;
+    for (size_t b = 0; b < TM_LATENCY_BUCKETS; b++)
+    {
+        total += histogram->buckets[b];
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    rank = rank == 0 ? 1 : rank;
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < TM_LATENCY_BUCKETS; b++)
+    {
+        seen += histogram->buckets[b];
+        if (seen >= rank)
+        {
+            uint64_t value = tm_latency_bucket_value(b);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return 0;
+}
+
+/** [thread-safe] Report the lock stripes of the region on which the most aborts were sampled by the conflict profiler.
+ * Only the last CONFLICT_RING_SIZE samples of each thread are kept. Without CONFLICT_PROFILER, nothing is reported.
+ * @param shared   Shared memory region to report on
+ * @param hotspots Array receiving the hotspots, by decreasing number of aborts
+ * @param max      Size of the array
+ * @return Number of hotspots written
+ **/
+size_t tm_conflict_report(shared_t shared, tm_conflict_hotspot_t *hotspots, size_t max)
+{
+    if (!CONFLICT_PROFILER)
+    {
+        return 0;
+    }
+
+    return conflict_t_report((region_t *)shared, hotspots, max);
+}
+
+/** [thread-safe] Write the events traced by every thread (the last TRACE_RING_SIZE ones of each) to a file,
+ * as a Chrome trace (JSON) to load in chrome://tracing or Perfetto. Without TRACE_EVENTS, nothing is written.
+ * @param path Path of the file
+ * @return Whether the file was written
+ **/
+bool tm_trace_dump(char const *path)
+{
+    if (!TRACE_EVENTS)
+    {
+        return false;
+    }
+
+    return trace_t_dump(path);
+}
+
+/** [thread-safe] Get the hardware counters of each STM phase of the calling thread (see tm_perf_phase_t).
+ * @param counters Array of tm_perf_phases counters
+ * @return Whether counters are recorded (PERF_COUNTERS, and at least one hardware counter could be opened)
+ **/
+bool tm_perf_thread_counters(tm_perf_counters_t *counters)
+{
+    if (!PERF_COUNTERS)
+    {
+        memset(counters, 0, tm_perf_phases * sizeof(tm_perf_counters_t));
+        return false;
+    }
+
+    return perf_t_thread_counters(counters);
+}
+
+/** [thread-safe] Sum the hardware counters of each STM phase of every thread, without stopping them.
+ * @param counters Array of tm_perf_phases counters
+ * @return Whether counters are recorded (PERF_COUNTERS, and at least one hardware counter could be opened)
+ **/
+bool tm_perf_counters(tm_perf_counters_t *counters)
+{
+    if (!PERF_COUNTERS)
+    {
+        memset(counters, 0, tm_perf_phases * sizeof(tm_perf_counters_t));
+        return false;
+    }
+
+    return perf_t_counters(counters);
+}
+
+/** Print hardware counters (e.g. from tm_perf_counters) as a table, with the average of each event per call of a phase.
+ * @param counters Array of tm_perf_phases counters
+ **/
+void tm_perf_print(tm_perf_counters_t const *counters)
+{
+    static const char *phases[tm_perf_phases] = {"read", "write", "lock", "validate", "writeback"};
+
+    printf("%-10s %12s %14s %14s %14s\n", "phase", "calls", "cycles/call", "llc-miss/call", "dtlb-miss/call");
+    for (int phase = 0; phase < tm_perf_phases; phase++)
+    {
+        double calls = counters[phase].calls ? (double)counters[phase].calls : 1.0;
+        printf("%-10s %12lu %14.1f %14.3f %14.3f\n", phases[phase], counters[phase].calls,
+               (double)counters[phase].counts[tm_perf_cycles] / calls,
+               (double)counters[phase].counts[tm_perf_llc_misses] / calls,
+               (double)counters[phase].counts[tm_perf_dtlb_misses] / calls);
+    }
+}
+
+/** [thread-safe] Get the memory held by a shared memory region (see tm_memory_stats_t).
+ * @param shared Shared memory region to query
+ * @param stats  Receives the memory of the region
+ * @return Whether the sets of the running txns are counted (MEMORY_ACCOUNTING)
+ **/
+bool tm_memory_stats(shared_t shared, tm_memory_stats_t *stats)
+{
+    region_t *region = (region_t *)shared;
+
+    stats->lock_table = sizeof(region->versioned_write_spinlock);
+    stats->region = sizeof(region_t) - stats->lock_table;
+    stats->first_segment = utils_physical_size(region, region->size);
+    stats->segments = atomic_load(&region->segment_account.bytes);
+    stats->sets = atomic_load(&region->set_account.bytes);
+    stats->sets_peak = atomic_load(&region->set_account.peak);
+
+    stats->segment_count = 0;
+    def_lock_t_lock(&region->segment_list_lock);
+    for (segment_t *sn = region->allocs; sn; sn = sn->next)
+    {
+        stats->segment_count++;
+    }
+    def_lock_t_unlock(&region->segment_list_lock);
+
+    return MEMORY_ACCOUNTING;
+}
+
+/**
+ * @brief Report an account crossing its soft limit to the callback of its region.
+ */
+static void tm_memory_exceeded(mem_account_t *account, void *arg)
+{
+    region_t *region = (region_t *)arg;
+    tm_memory_callback_t callback = region->memory_callback;
+    if (!callback)
+    {
+        return;
+    }
+
+    tm_memory_stats_t stats;
+    tm_memory_stats(region, &stats);
+    callback(region, account == &region->set_account ? tm_memory_sets : tm_memory_segments, &stats, region->memory_callback_arg);
+}
+
+/** Set soft limits on the memory of a shared memory region: the callback is called when the memory of the segments or of the
+ * sets of the running txns crosses its limit (nothing is refused). To be called while no txn runs on the region.
+ * @param shared        Shared memory region
+ * @param segment_limit Limit on tm_memory_stats_t.segments (in bytes), 0 for none
+ * @param set_limit     Limit on tm_memory_stats_t.sets (in bytes), 0 for none (only checked with MEMORY_ACCOUNTING)
+ * @param callback      Function called on a crossed limit (see tm_memory_callback_t)
+ * @param arg           Last argument of the callback
+ * @return Whether the limits were set (not for a region shared by processes, where any process could cross them)
+ **/
+bool tm_memory_limits(shared_t shared, size_t segment_limit, size_t set_limit, tm_memory_callback_t callback, void *arg)
+{
+    region_t *region = (region_t *)shared;
+    if (region->shm)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_memory_limits: The regions shared by processes have no memory limits!\n");
+        return false;
+    }
+
+    region->memory_callback = callback;
+    region->memory_callback_arg = arg;
+
+    mem_account_t *accounts[] = {&region->segment_account, &region->set_account};
+    size_t limits[] = {segment_limit, set_limit};
+    for (int i = 0; i < 2; i++)
+    {
+        accounts[i]->on_exceeded = tm_memory_exceeded;
+        accounts[i]->arg = region;
+        mem_account_t_set_limit(accounts[i], limits[i]);
+    }
+
+    return true;
+}
+
+/** [thread-safe] Register the calling thread in a shared memory region: the transactions it begins on the region then run
+ * in a context of the thread (from a registry of the region), which keeps the transaction and its sets between them instead
+ * of allocating them. Only one transaction of the thread at a time runs in the context; the others are allocated as usual.
+ * The thread must call tm_thread_exit before it exits, and before the region is destroyed by another thread.
+ * @param shared Shared memory region
+ * @return Whether the thread is registered (not in a region shared by processes, nor in more than THREAD_CONTEXT_SLOTS regions)
+ **/
+bool tm_thread_enter(shared_t shared)
+{
+    region_t *region = (region_t *)shared;
+    if (region->shm)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "tm_thread_enter: The regions shared by processes have no thread contexts!\n");
+        return false;
+    }
+
+    return thread_context_t_enter(region);
+}
+
+/** [thread-safe] Unregister the calling thread from a shared memory region (outside of a transaction): its context is
+ * kept by the region for the next thread to register.
+ * @param shared Shared memory region
+ **/
+void tm_thread_exit(shared_t shared)
+{
+    thread_context_t_exit((region_t *)shared);
+}
+
+/** [thread-safe] Enumerate the threads registered in a shared memory region, while they keep running transactions: e.g. to
+ * sum their statistics, or to wait until none of them is in a transaction.
+ * @param shared Shared memory region
+ * @param stats  Array receiving the statistics of each registered thread
+ * @param max    Size of the array
+ * @return The number of registered threads (possibly more than max)
+ **/
+size_t tm_thread_contexts(shared_t shared, tm_thread_stats_t *stats, size_t max)
+{
+    return thread_context_t_report((region_t *)shared, stats, max);
+}
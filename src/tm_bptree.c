@@ -0,0 +1,390 @@
+#include "tm_bptree.h"
+
+#define BPT_ROOT 0
+#define BPT_HEADER_WORDS 1
+
+#define MAX_KEYS (TM_BPTREE_ORDER - 1)
+
+#define NODE_LEAF 0
+#define NODE_COUNT 1
+#define NODE_NEXT_LEAF 2
+#define NODE_KEYS 3
+#define NODE_SLOTS (NODE_KEYS + MAX_KEYS)
+#define NODE_WORDS (NODE_SLOTS + TM_BPTREE_ORDER)
+
+/**
+ * @brief Read the header and the keys of a node (the slots are read one at a time).
+ */
+static bool tm_bptree_read_keys(shared_t shared, tx_t tx, tm_ds_word_t node, tm_ds_word_t *fields)
+{
+    if (!tm_ds_read(shared, tx, (void *)node, NODE_KEYS, fields))
+    {
+        return false;
+    }
+
+    return fields[NODE_COUNT] == 0 || tm_ds_read(shared, tx, tm_ds_field((void *)node, NODE_KEYS), fields[NODE_COUNT], &fields[NODE_KEYS]);
+}
+
+/**
+ * @brief Index of the child of an inner node covering a key: child i holds the keys in [keys[i - 1], keys[i]).
+ */
+static size_t tm_bptree_child_index(const tm_ds_word_t *fields, tm_ds_word_t key)
+{
+    size_t i = 0;
+    while (i < fields[NODE_COUNT] && key >= fields[NODE_KEYS + i])
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Index of the first key of a leaf greater or equal to a key.
+ */
+static size_t tm_bptree_leaf_index(const tm_ds_word_t *fields, tm_ds_word_t key)
+{
+    size_t i = 0;
+    while (i < fields[NODE_COUNT] && key > fields[NODE_KEYS + i])
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Descend from the root to the leaf covering a key (read-only path).
+ */
+static bool tm_bptree_find_leaf(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, tm_ds_word_t *leaf, tm_ds_word_t *fields)
+{
+    if (!tm_ds_read(shared, tx, tm_ds_field(tree, BPT_ROOT), 1, leaf) || !tm_bptree_read_keys(shared, tx, *leaf, fields))
+    {
+        return false;
+    }
+
+    while (!fields[NODE_LEAF])
+    {
+        size_t index = tm_bptree_child_index(fields, key);
+        if (!tm_ds_read(shared, tx, tm_ds_field((void *)*leaf, NODE_SLOTS + index), 1, leaf) ||
+            !tm_bptree_read_keys(shared, tx, *leaf, fields))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Split the full child at a given index of a non-full inner node. Both nodes are fully read and rewritten.
+ *
+ * @param parent_fields The words of the parent, updated with the new separator and child.
+ */
+static alloc_t tm_bptree_split_child(shared_t shared, tx_t tx, tm_ds_word_t parent, tm_ds_word_t *parent_fields, size_t index)
+{
+    tm_ds_word_t child = parent_fields[NODE_SLOTS + index];
+    tm_ds_word_t left[NODE_WORDS];
+    if (!tm_ds_read(shared, tx, (void *)child, NODE_WORDS, left))
+    {
+        return abort_alloc;
+    }
+
+    void *right_node;
+    alloc_t result = tm_alloc(shared, tx, NODE_WORDS * TM_DS_WORD_SIZE, &right_node);
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    tm_ds_word_t right[NODE_WORDS] = {0};
+    tm_ds_word_t separator;
+    size_t mid = MAX_KEYS / 2;
+    right[NODE_LEAF] = left[NODE_LEAF];
+
+    if (left[NODE_LEAF])
+    {
+        // Leaves keep every key: the separator is copied up, and the right leaf is linked in the chain
+        right[NODE_COUNT] = MAX_KEYS - mid;
+        for (size_t i = 0; i < MAX_KEYS - mid; i++)
+        {
+            right[NODE_KEYS + i] = left[NODE_KEYS + mid + i];
+            right[NODE_SLOTS + i] = left[NODE_SLOTS + mid + i];
+        }
+        right[NODE_NEXT_LEAF] = left[NODE_NEXT_LEAF];
+        left[NODE_NEXT_LEAF] = (tm_ds_word_t)right_node;
+        separator = right[NODE_KEYS];
+    }
+    else
+    {
+        // Inner nodes move the separator up
+        right[NODE_COUNT] = MAX_KEYS - mid - 1;
+        for (size_t i = 0; i < MAX_KEYS - mid - 1; i++)
+        {
+            right[NODE_KEYS + i] = left[NODE_KEYS + mid + 1 + i];
+        }
+        for (size_t i = 0; i < MAX_KEYS - mid; i++)
+        {
+            right[NODE_SLOTS + i] = left[NODE_SLOTS + mid + 1 + i];
+        }
+        separator = left[NODE_KEYS + mid];
+    }
+    left[NODE_COUNT] = mid;
+
+    // Insert the separator and the right node in the parent
+    for (size_t i = parent_fields[NODE_COUNT]; i > index; i--)
+    {
+        parent_fields[NODE_KEYS + i] = parent_fields[NODE_KEYS + i - 1];
+        parent_fields[NODE_SLOTS + i + 1] = parent_fields[NODE_SLOTS + i];
+    }
+    parent_fields[NODE_KEYS + index] = separator;
+    parent_fields[NODE_SLOTS + index + 1] = (tm_ds_word_t)right_node;
+    parent_fields[NODE_COUNT]++;
+
+    if (!tm_ds_write(shared, tx, right_node, NODE_WORDS, right) ||
+        !tm_ds_write(shared, tx, (void *)child, NODE_WORDS, left) ||
+        !tm_ds_write(shared, tx, (void *)parent, NODE_WORDS, parent_fields))
+    {
+        return abort_alloc;
+    }
+
+    return success_alloc;
+}
+
+/*
+    =======
+    B+-tree implementations
+    =======
+*/
+
+alloc_t tm_bptree_create(shared_t shared, tx_t tx, tm_bptree_t *tree)
+{
+    if (!tm_ds_supported(shared))
+    {
+        return nomem_alloc;
+    }
+
+    void *header;
+    void *root;
+    alloc_t result = tm_alloc(shared, tx, BPT_HEADER_WORDS * TM_DS_WORD_SIZE, &header);
+    if (result == success_alloc)
+    {
+        result = tm_alloc(shared, tx, NODE_WORDS * TM_DS_WORD_SIZE, &root);
+    }
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    // The root starts as an empty leaf
+    tm_ds_word_t leaf = 1;
+    tm_ds_word_t root_word = (tm_ds_word_t)root;
+    if (!tm_ds_write(shared, tx, tm_ds_field(root, NODE_LEAF), 1, &leaf) ||
+        !tm_ds_write(shared, tx, tm_ds_field(header, BPT_ROOT), 1, &root_word))
+    {
+        return abort_alloc;
+    }
+
+    *tree = header;
+    return success_alloc;
+}
+
+bool tm_bptree_get(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, tm_ds_word_t *value, bool *found)
+{
+    tm_ds_word_t leaf;
+    tm_ds_word_t fields[NODE_SLOTS];
+    if (!tm_bptree_find_leaf(shared, tx, tree, key, &leaf, fields))
+    {
+        return false;
+    }
+
+    size_t index = tm_bptree_leaf_index(fields, key);
+    *found = (index < fields[NODE_COUNT] && fields[NODE_KEYS + index] == key);
+    if (*found)
+    {
+        return tm_ds_read(shared, tx, tm_ds_field((void *)leaf, NODE_SLOTS + index), 1, value);
+    }
+
+    return true;
+}
+
+alloc_t tm_bptree_put(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, tm_ds_word_t value)
+{
+    tm_ds_word_t node;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_ds_read(shared, tx, tm_ds_field(tree, BPT_ROOT), 1, &node) || !tm_ds_read(shared, tx, (void *)node, NODE_WORDS, fields))
+    {
+        return abort_alloc;
+    }
+
+    if (fields[NODE_COUNT] == MAX_KEYS)
+    {
+        // Grow the tree: a new root with the old root as its only child, then split the old root
+        void *root;
+        alloc_t result = tm_alloc(shared, tx, NODE_WORDS * TM_DS_WORD_SIZE, &root);
+        if (result != success_alloc)
+        {
+            return result;
+        }
+
+        tm_ds_word_t root_fields[NODE_WORDS] = {0};
+        root_fields[NODE_SLOTS] = node;
+        result = tm_bptree_split_child(shared, tx, (tm_ds_word_t)root, root_fields, 0);
+        if (result != success_alloc)
+        {
+            return result;
+        }
+
+        node = (tm_ds_word_t)root;
+        if (!tm_ds_write(shared, tx, tm_ds_field(tree, BPT_ROOT), 1, &node))
+        {
+            return abort_alloc;
+        }
+
+        for (size_t i = 0; i < NODE_WORDS; i++)
+        {
+            fields[i] = root_fields[i];
+        }
+    }
+
+    // Every node on the way down has room for one more key: full children are split before descending into them
+    while (!fields[NODE_LEAF])
+    {
+        size_t index = tm_bptree_child_index(fields, key);
+        tm_ds_word_t child = fields[NODE_SLOTS + index];
+        tm_ds_word_t child_count;
+        if (!tm_ds_read(shared, tx, tm_ds_field((void *)child, NODE_COUNT), 1, &child_count))
+        {
+            return abort_alloc;
+        }
+
+        if (child_count == MAX_KEYS)
+        {
+            alloc_t result = tm_bptree_split_child(shared, tx, node, fields, index);
+            if (result != success_alloc)
+            {
+                return result;
+            }
+
+            index = tm_bptree_child_index(fields, key);
+            child = fields[NODE_SLOTS + index];
+        }
+
+        node = child;
+        if (!tm_ds_read(shared, tx, (void *)node, NODE_WORDS, fields))
+        {
+            return abort_alloc;
+        }
+    }
+
+    size_t index = tm_bptree_leaf_index(fields, key);
+    if (index < fields[NODE_COUNT] && fields[NODE_KEYS + index] == key)
+    {
+        return tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_SLOTS + index), 1, &value) ? success_alloc : abort_alloc;
+    }
+
+    // Shift the larger entries and rewrite the modified tail of the keys and of the values
+    size_t count = fields[NODE_COUNT];
+    for (size_t i = count; i > index; i--)
+    {
+        fields[NODE_KEYS + i] = fields[NODE_KEYS + i - 1];
+        fields[NODE_SLOTS + i] = fields[NODE_SLOTS + i - 1];
+    }
+    fields[NODE_KEYS + index] = key;
+    fields[NODE_SLOTS + index] = value;
+    fields[NODE_COUNT] = count + 1;
+
+    if (!tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_COUNT), 1, &fields[NODE_COUNT]) ||
+        !tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_KEYS + index), count + 1 - index, &fields[NODE_KEYS + index]) ||
+        !tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_SLOTS + index), count + 1 - index, &fields[NODE_SLOTS + index]))
+    {
+        return abort_alloc;
+    }
+
+    return success_alloc;
+}
+
+bool tm_bptree_remove(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t key, bool *removed)
+{
+    tm_ds_word_t leaf;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_bptree_find_leaf(shared, tx, tree, key, &leaf, fields))
+    {
+        return false;
+    }
+
+    size_t index = tm_bptree_leaf_index(fields, key);
+    *removed = (index < fields[NODE_COUNT] && fields[NODE_KEYS + index] == key);
+    if (!*removed)
+    {
+        return true;
+    }
+
+    size_t count = fields[NODE_COUNT];
+    if (!tm_ds_read(shared, tx, tm_ds_field((void *)leaf, NODE_SLOTS), count, &fields[NODE_SLOTS]))
+    {
+        return false;
+    }
+
+    for (size_t i = index; i + 1 < count; i++)
+    {
+        fields[NODE_KEYS + i] = fields[NODE_KEYS + i + 1];
+        fields[NODE_SLOTS + i] = fields[NODE_SLOTS + i + 1];
+    }
+    fields[NODE_COUNT] = count - 1;
+
+    if (!tm_ds_write(shared, tx, tm_ds_field((void *)leaf, NODE_COUNT), 1, &fields[NODE_COUNT]))
+    {
+        return false;
+    }
+
+    // Only the entries after the removed one move
+    return index + 1 == count ||
+           (tm_ds_write(shared, tx, tm_ds_field((void *)leaf, NODE_KEYS + index), count - 1 - index, &fields[NODE_KEYS + index]) &&
+            tm_ds_write(shared, tx, tm_ds_field((void *)leaf, NODE_SLOTS + index), count - 1 - index, &fields[NODE_SLOTS + index]));
+}
+
+bool tm_bptree_scan(shared_t shared, tx_t tx, tm_bptree_t tree, tm_ds_word_t from, size_t max, tm_ds_word_t *keys, tm_ds_word_t *values, size_t *count)
+{
+    tm_ds_word_t leaf;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_bptree_find_leaf(shared, tx, tree, from, &leaf, fields))
+    {
+        return false;
+    }
+
+    *count = 0;
+    size_t index = tm_bptree_leaf_index(fields, from);
+    while (*count < max)
+    {
+        size_t taken = fields[NODE_COUNT] - index;
+        if (taken > max - *count)
+        {
+            taken = max - *count;
+        }
+
+        if (taken > 0)
+        {
+            if (!tm_ds_read(shared, tx, tm_ds_field((void *)leaf, NODE_SLOTS + index), taken, &values[*count]))
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < taken; i++)
+            {
+                keys[*count + i] = fields[NODE_KEYS + index + i];
+            }
+            *count += taken;
+        }
+
+        // The next leaf pointer was read with the keys
+        leaf = fields[NODE_NEXT_LEAF];
+        if (leaf == 0 || *count == max || !tm_bptree_read_keys(shared, tx, leaf, fields))
+        {
+            return leaf == 0 || *count == max;
+        }
+        index = 0;
+    }
+
+    return true;
+}
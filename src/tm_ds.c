@@ -0,0 +1,74 @@
+#include "tm_ds.h"
+
+
+bool tm_ds_supported(shared_t shared)
+{
+    size_t align = tm_align(shared);
+
+    return align <= TM_DS_WORD_SIZE && TM_DS_WORD_SIZE % align == 0;
+}
+
+bool tm_ds_read(shared_t shared, tx_t tx, const void *addr, size_t words, tm_ds_word_t *out)
+{
+    return tm_read(shared, tx, addr, words * TM_DS_WORD_SIZE, out);
+}
+
+bool tm_ds_write(shared_t shared, tx_t tx, void *addr, size_t words, const tm_ds_word_t *in)
+{
+    return tm_write(shared, tx, in, words * TM_DS_WORD_SIZE, addr);
+}
+
+alloc_t tm_ds_alloc_node(shared_t shared, tx_t tx, void *free_list, size_t words, void **node)
+{
+    tm_ds_word_t head;
+    if (!tm_ds_read(shared, tx, free_list, 1, &head))
+    {
+        return abort_alloc;
+    }
+
+    if (head == 0)
+    {
+        // New segments are zeroed by tm_alloc
+        return tm_alloc(shared, tx, words * TM_DS_WORD_SIZE, node);
+    }
+
+    // Pop the node. It is not cleared: the callers initialize every word of a new node anyway
+    tm_ds_word_t next;
+    if (!tm_ds_read(shared, tx, (void *)head, 1, &next) || !tm_ds_write(shared, tx, free_list, 1, &next))
+    {
+        return abort_alloc;
+    }
+
+    *node = (void *)head;
+    return success_alloc;
+}
+
+bool tm_ds_free_node(shared_t shared, tx_t tx, void *free_list, void *node)
+{
+    tm_ds_word_t head;
+    if (!tm_ds_read(shared, tx, free_list, 1, &head) || !tm_ds_write(shared, tx, node, 1, &head))
+    {
+        return false;
+    }
+
+    tm_ds_word_t new_head = (tm_ds_word_t)node;
+    if (!tm_ds_write(shared, tx, free_list, 1, &new_head))
+    {
+        return false;
+    }
+
+    // Let the region know the node is no longer used (it is only reclaimed with the region)
+    return tm_free(shared, tx, node);
+}
+
+tm_ds_word_t tm_ds_hash(tm_ds_word_t key)
+{
+    uint64_t x = (uint64_t)key;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return (tm_ds_word_t)x;
+}
@@ -0,0 +1,264 @@
+#include "tm_hashmap.h"
+
+#define HM_BUCKETS 0
+#define HM_BUCKET_COUNT 1
+#define HM_FREE 2
+#define HM_COUNTER(i) (TM_HASHMAP_STRIDE * (1 + (i)))
+#define HM_HEADER_WORDS (TM_HASHMAP_STRIDE * (1 + TM_HASHMAP_COUNTERS))
+
+#define NODE_NEXT 0 // Also the link of the free list
+#define NODE_KEY 1
+#define NODE_VALUE 2
+#define NODE_WORDS 3
+
+/**
+ * @brief Get the element counter of the stripe of a key. The stripe is given by the top bits of the hash of the key,
+ * which the bucket index never uses, so that the keys of a stripe are spread over all the buckets (and vice versa).
+ */
+static void *tm_hashmap_counter(tm_hashmap_t map, tm_ds_word_t key)
+{
+    return tm_ds_field(map, HM_COUNTER((tm_ds_hash(key) >> (8 * TM_DS_WORD_SIZE - 8)) % TM_HASHMAP_COUNTERS));
+}
+
+/**
+ * @brief Find the node of a key in its chain.
+ *
+ * @param link Pointer receiving the address of the word pointing to the node (or that would point to a new node).
+ * @param node Pointer receiving the node (0 if the key is not in the map).
+ * @param fields Buffer receiving the words of the node (when found).
+ */
+static bool tm_hashmap_find(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, void **link, tm_ds_word_t *node, tm_ds_word_t *fields)
+{
+    tm_ds_word_t header[2];
+    if (!tm_ds_read(shared, tx, map, 2, header))
+    {
+        return false;
+    }
+
+    void *bucket = tm_ds_field((void *)header[HM_BUCKETS], tm_ds_hash(key) & (header[HM_BUCKET_COUNT] - 1));
+    if (!tm_ds_read(shared, tx, bucket, 1, node))
+    {
+        return false;
+    }
+
+    *link = bucket;
+    while (*node != 0)
+    {
+        if (!tm_ds_read(shared, tx, (void *)*node, NODE_WORDS, fields))
+        {
+            return false;
+        }
+
+        if (fields[NODE_KEY] == key)
+        {
+            return true;
+        }
+
+        *link = tm_ds_field((void *)*node, NODE_NEXT);
+        *node = fields[NODE_NEXT];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Double the number of buckets, relinking every node in the new buckets.
+ */
+static alloc_t tm_hashmap_resize(shared_t shared, tx_t tx, tm_hashmap_t map)
+{
+    tm_ds_word_t header[2];
+    if (!tm_ds_read(shared, tx, map, 2, header))
+    {
+        return abort_alloc;
+    }
+
+    tm_ds_word_t count = header[HM_BUCKET_COUNT];
+    void *buckets;
+    alloc_t result = tm_alloc(shared, tx, 2 * count * TM_DS_WORD_SIZE, &buckets);
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    for (tm_ds_word_t i = 0; i < count; i++)
+    {
+        tm_ds_word_t node;
+        if (!tm_ds_read(shared, tx, tm_ds_field((void *)header[HM_BUCKETS], i), 1, &node))
+        {
+            return abort_alloc;
+        }
+
+        while (node != 0)
+        {
+            tm_ds_word_t fields[NODE_WORDS];
+            if (!tm_ds_read(shared, tx, (void *)node, NODE_WORDS, fields))
+            {
+                return abort_alloc;
+            }
+
+            // Push the node at the front of its new bucket
+            void *bucket = tm_ds_field(buckets, tm_ds_hash(fields[NODE_KEY]) & (2 * count - 1));
+            tm_ds_word_t head;
+            if (!tm_ds_read(shared, tx, bucket, 1, &head) ||
+                !tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_NEXT), 1, &head) ||
+                !tm_ds_write(shared, tx, bucket, 1, &node))
+            {
+                return abort_alloc;
+            }
+
+            node = fields[NODE_NEXT];
+        }
+    }
+
+    tm_ds_word_t new_header[2] = {(tm_ds_word_t)buckets, 2 * count};
+    if (!tm_ds_write(shared, tx, map, 2, new_header))
+    {
+        return abort_alloc;
+    }
+
+    // The old buckets are not reachable anymore
+    return tm_free(shared, tx, (void *)header[HM_BUCKETS]) ? success_alloc : abort_alloc;
+}
+
+/*
+    =======
+    Hash map implementations
+    =======
+*/
+
+alloc_t tm_hashmap_create(shared_t shared, tx_t tx, size_t buckets, tm_hashmap_t *map)
+{
+    if (!tm_ds_supported(shared))
+    {
+        return nomem_alloc;
+    }
+
+    size_t count = TM_HASHMAP_MIN_BUCKETS;
+    while (count < buckets)
+    {
+        count *= 2;
+    }
+
+    void *header;
+    void *table;
+    alloc_t result = tm_alloc(shared, tx, HM_HEADER_WORDS * TM_DS_WORD_SIZE, &header);
+    if (result == success_alloc)
+    {
+        result = tm_alloc(shared, tx, count * TM_DS_WORD_SIZE, &table);
+    }
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    tm_ds_word_t fields[2] = {(tm_ds_word_t)table, count};
+    if (!tm_ds_write(shared, tx, header, 2, fields))
+    {
+        return abort_alloc;
+    }
+
+    *map = header;
+    return success_alloc;
+}
+
+bool tm_hashmap_get(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, tm_ds_word_t *value, bool *found)
+{
+    void *link;
+    tm_ds_word_t node;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_hashmap_find(shared, tx, map, key, &link, &node, fields))
+    {
+        return false;
+    }
+
+    *found = (node != 0);
+    if (*found)
+    {
+        *value = fields[NODE_VALUE];
+    }
+
+    return true;
+}
+
+alloc_t tm_hashmap_put(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, tm_ds_word_t value)
+{
+    void *link;
+    tm_ds_word_t node;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_hashmap_find(shared, tx, map, key, &link, &node, fields))
+    {
+        return abort_alloc;
+    }
+
+    if (node != 0)
+    {
+        // Update in place: a single word is written
+        return tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_VALUE), 1, &value) ? success_alloc : abort_alloc;
+    }
+
+    void *new_node;
+    alloc_t result = tm_ds_alloc_node(shared, tx, tm_ds_field(map, HM_FREE), NODE_WORDS, &new_node);
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    // Append the node at the end of the chain (link points to the last next pointer, or to the bucket)
+    tm_ds_word_t new_fields[NODE_WORDS] = {0, key, value};
+    tm_ds_word_t new_word = (tm_ds_word_t)new_node;
+    if (!tm_ds_write(shared, tx, new_node, NODE_WORDS, new_fields) || !tm_ds_write(shared, tx, link, 1, &new_word))
+    {
+        return abort_alloc;
+    }
+
+    // Count the element in the stripe of the key, and grow the table when the stripe is over the load factor
+    tm_ds_word_t header[2];
+    tm_ds_word_t counter;
+    void *counter_addr = tm_hashmap_counter(map, key);
+    if (!tm_ds_read(shared, tx, map, 2, header) || !tm_ds_read(shared, tx, counter_addr, 1, &counter))
+    {
+        return abort_alloc;
+    }
+
+    counter++;
+    if (!tm_ds_write(shared, tx, counter_addr, 1, &counter))
+    {
+        return abort_alloc;
+    }
+
+    if (counter * TM_HASHMAP_COUNTERS > TM_HASHMAP_LOAD_FACTOR * header[HM_BUCKET_COUNT])
+    {
+        return tm_hashmap_resize(shared, tx, map);
+    }
+
+    return success_alloc;
+}
+
+bool tm_hashmap_remove(shared_t shared, tx_t tx, tm_hashmap_t map, tm_ds_word_t key, bool *removed)
+{
+    void *link;
+    tm_ds_word_t node;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_hashmap_find(shared, tx, map, key, &link, &node, fields))
+    {
+        return false;
+    }
+
+    *removed = (node != 0);
+    if (!*removed)
+    {
+        return true;
+    }
+
+    // Unlink the node, uncount it, and keep it for reuse
+    tm_ds_word_t counter;
+    void *counter_addr = tm_hashmap_counter(map, key);
+    if (!tm_ds_write(shared, tx, link, 1, &fields[NODE_NEXT]) || !tm_ds_read(shared, tx, counter_addr, 1, &counter))
+    {
+        return false;
+    }
+
+    counter--;
+    return tm_ds_write(shared, tx, counter_addr, 1, &counter) &&
+           tm_ds_free_node(shared, tx, tm_ds_field(map, HM_FREE), (void *)node);
+}
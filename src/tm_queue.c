@@ -0,0 +1,125 @@
+#include "tm_queue.h"
+
+#define Q_HEAD 0
+#define Q_DEQ_FREE 1 // Written by the dequeuers (with the head)
+#define Q_TAIL TM_QUEUE_STRIDE
+#define Q_ENQ_FREE (TM_QUEUE_STRIDE + 1) // Written by the enqueuers (with the tail)
+#define Q_HEADER_WORDS (2 * TM_QUEUE_STRIDE)
+
+#define NODE_NEXT 0 // Also the link of the free list
+#define NODE_VALUE 1
+#define NODE_WORDS 2
+
+/*
+    =======
+    Queue implementations
+    =======
+*/
+
+alloc_t tm_queue_create(shared_t shared, tx_t tx, tm_queue_t *queue)
+{
+    if (!tm_ds_supported(shared))
+    {
+        return nomem_alloc;
+    }
+
+    void *header;
+    void *sentinel;
+    alloc_t result = tm_alloc(shared, tx, Q_HEADER_WORDS * TM_DS_WORD_SIZE, &header);
+    if (result == success_alloc)
+    {
+        result = tm_alloc(shared, tx, NODE_WORDS * TM_DS_WORD_SIZE, &sentinel);
+    }
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    tm_ds_word_t sentinel_word = (tm_ds_word_t)sentinel;
+    if (!tm_ds_write(shared, tx, tm_ds_field(header, Q_HEAD), 1, &sentinel_word) ||
+        !tm_ds_write(shared, tx, tm_ds_field(header, Q_TAIL), 1, &sentinel_word))
+    {
+        return abort_alloc;
+    }
+
+    *queue = header;
+    return success_alloc;
+}
+
+/**
+ * @brief Refill the enqueuers' free list, when it is empty, with all the nodes freed by the dequeuers.
+ */
+static bool tm_queue_refill(shared_t shared, tx_t tx, tm_queue_t queue)
+{
+    tm_ds_word_t enq_free;
+    tm_ds_word_t deq_free;
+    if (!tm_ds_read(shared, tx, tm_ds_field(queue, Q_ENQ_FREE), 1, &enq_free))
+    {
+        return false;
+    }
+
+    // Only an empty list is refilled, so that the dequeuers' list is only read once per batch of nodes
+    if (enq_free != 0 || !tm_ds_read(shared, tx, tm_ds_field(queue, Q_DEQ_FREE), 1, &deq_free))
+    {
+        return enq_free != 0;
+    }
+
+    tm_ds_word_t empty = 0;
+    return deq_free == 0 || (tm_ds_write(shared, tx, tm_ds_field(queue, Q_DEQ_FREE), 1, &empty) &&
+                             tm_ds_write(shared, tx, tm_ds_field(queue, Q_ENQ_FREE), 1, &deq_free));
+}
+
+alloc_t tm_queue_enqueue(shared_t shared, tx_t tx, tm_queue_t queue, tm_ds_word_t value)
+{
+    if (!tm_queue_refill(shared, tx, queue))
+    {
+        return abort_alloc;
+    }
+
+    void *node;
+    alloc_t result = tm_ds_alloc_node(shared, tx, tm_ds_field(queue, Q_ENQ_FREE), NODE_WORDS, &node);
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    tm_ds_word_t tail;
+    tm_ds_word_t fields[NODE_WORDS] = {0, value};
+    tm_ds_word_t node_word = (tm_ds_word_t)node;
+    if (!tm_ds_write(shared, tx, node, NODE_WORDS, fields) ||
+        !tm_ds_read(shared, tx, tm_ds_field(queue, Q_TAIL), 1, &tail) ||
+        !tm_ds_write(shared, tx, tm_ds_field((void *)tail, NODE_NEXT), 1, &node_word) ||
+        !tm_ds_write(shared, tx, tm_ds_field(queue, Q_TAIL), 1, &node_word))
+    {
+        return abort_alloc;
+    }
+
+    return success_alloc;
+}
+
+bool tm_queue_dequeue(shared_t shared, tx_t tx, tm_queue_t queue, tm_ds_word_t *value, bool *found)
+{
+    tm_ds_word_t sentinel;
+    tm_ds_word_t fields[NODE_WORDS];
+    if (!tm_ds_read(shared, tx, tm_ds_field(queue, Q_HEAD), 1, &sentinel) ||
+        !tm_ds_read(shared, tx, tm_ds_field((void *)sentinel, NODE_NEXT), 1, &fields[NODE_NEXT]))
+    {
+        return false;
+    }
+
+    *found = (fields[NODE_NEXT] != 0);
+    if (!*found)
+    {
+        return true;
+    }
+
+    // The first node becomes the new sentinel, and the old sentinel is kept for reuse (by the enqueuers, see tm_queue_refill)
+    void *first = (void *)fields[NODE_NEXT];
+    if (!tm_ds_read(shared, tx, tm_ds_field(first, NODE_VALUE), 1, value) ||
+        !tm_ds_write(shared, tx, tm_ds_field(queue, Q_HEAD), 1, &fields[NODE_NEXT]))
+    {
+        return false;
+    }
+
+    return tm_ds_free_node(shared, tx, tm_ds_field(queue, Q_DEQ_FREE), (void *)sentinel);
+}
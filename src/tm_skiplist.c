@@ -0,0 +1,210 @@
+#include "tm_skiplist.h"
+
+#include "macros.h"
+
+#define SL_HEAD 0
+#define SL_FREE(height) (TM_SKIPLIST_MAX_HEIGHT + (height) - 1)
+#define SL_HEADER_WORDS (2 * TM_SKIPLIST_MAX_HEIGHT)
+
+#define NODE_KEY 0 // Also the link of the free list, once the node is unlinked
+#define NODE_VALUE 1
+#define NODE_HEIGHT 2
+#define NODE_NEXT 3
+#define NODE_WORDS(height) (NODE_NEXT + (height))
+
+/**
+ * @brief Draw the height of a new node: level i is reached with probability 1/2^i.
+ */
+static size_t tm_skiplist_random_height(void)
+{
+    static _Thread_local uint64_t state = 0;
+    if (unlikely(state == 0))
+    {
+        state = (uint64_t)tm_ds_hash((tm_ds_word_t)&state) | 1;
+    }
+
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    size_t height = 1;
+    for (uint64_t bits = state; (bits & 1) && height < TM_SKIPLIST_MAX_HEIGHT; bits >>= 1)
+    {
+        height++;
+    }
+
+    return height;
+}
+
+/**
+ * @brief Find the predecessors and successors of a key at every level.
+ *
+ * @param preds Array receiving, for each level, the address of the next pointer to update on insertion/removal.
+ * @param succ Pointer receiving the first node with a key greater or equal to the key (0 if none).
+ * @param succ_key Pointer receiving the key of succ (when not 0).
+ */
+static bool tm_skiplist_find(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, void **preds, tm_ds_word_t *succ, tm_ds_word_t *succ_key)
+{
+    void *tower = tm_ds_field(list, SL_HEAD); // Next pointers of the current predecessor
+    tm_ds_word_t next = 0;
+    tm_ds_word_t next_key = 0;
+
+    for (size_t level = TM_SKIPLIST_MAX_HEIGHT; level-- > 0;)
+    {
+        while (true)
+        {
+            if (!tm_ds_read(shared, tx, tm_ds_field(tower, level), 1, &next))
+            {
+                return false;
+            }
+
+            if (next == 0)
+            {
+                break;
+            }
+
+            if (!tm_ds_read(shared, tx, tm_ds_field((void *)next, NODE_KEY), 1, &next_key))
+            {
+                return false;
+            }
+
+            if (next_key >= key)
+            {
+                break;
+            }
+
+            tower = tm_ds_field((void *)next, NODE_NEXT);
+        }
+
+        if (preds)
+        {
+            preds[level] = tm_ds_field(tower, level);
+        }
+    }
+
+    *succ = next;
+    *succ_key = next_key;
+    return true;
+}
+
+/*
+    =======
+    Skiplist implementations
+    =======
+*/
+
+alloc_t tm_skiplist_create(shared_t shared, tx_t tx, tm_skiplist_t *list)
+{
+    if (!tm_ds_supported(shared))
+    {
+        return nomem_alloc;
+    }
+
+    // New segments are zeroed: the head tower is empty and so are the free lists
+    return tm_alloc(shared, tx, SL_HEADER_WORDS * TM_DS_WORD_SIZE, list);
+}
+
+bool tm_skiplist_get(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, tm_ds_word_t *value, bool *found)
+{
+    tm_ds_word_t node;
+    tm_ds_word_t node_key;
+    if (!tm_skiplist_find(shared, tx, list, key, NULL, &node, &node_key))
+    {
+        return false;
+    }
+
+    *found = (node != 0 && node_key == key);
+    if (*found)
+    {
+        return tm_ds_read(shared, tx, tm_ds_field((void *)node, NODE_VALUE), 1, value);
+    }
+
+    return true;
+}
+
+alloc_t tm_skiplist_put(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, tm_ds_word_t value)
+{
+    void *preds[TM_SKIPLIST_MAX_HEIGHT];
+    tm_ds_word_t node;
+    tm_ds_word_t node_key;
+    if (!tm_skiplist_find(shared, tx, list, key, preds, &node, &node_key))
+    {
+        return abort_alloc;
+    }
+
+    if (node != 0 && node_key == key)
+    {
+        return tm_ds_write(shared, tx, tm_ds_field((void *)node, NODE_VALUE), 1, &value) ? success_alloc : abort_alloc;
+    }
+
+    size_t height = tm_skiplist_random_height();
+    void *new_node;
+    alloc_t result = tm_ds_alloc_node(shared, tx, tm_ds_field(list, SL_FREE(height)), NODE_WORDS(height), &new_node);
+    if (result != success_alloc)
+    {
+        return result;
+    }
+
+    // Build the whole node privately, then link it in at each of its levels
+    tm_ds_word_t fields[NODE_WORDS(TM_SKIPLIST_MAX_HEIGHT)] = {key, value, height};
+    for (size_t level = 0; level < height; level++)
+    {
+        if (!tm_ds_read(shared, tx, preds[level], 1, &fields[NODE_NEXT + level]))
+        {
+            return abort_alloc;
+        }
+    }
+
+    if (!tm_ds_write(shared, tx, new_node, NODE_WORDS(height), fields))
+    {
+        return abort_alloc;
+    }
+
+    tm_ds_word_t new_word = (tm_ds_word_t)new_node;
+    for (size_t level = 0; level < height; level++)
+    {
+        if (!tm_ds_write(shared, tx, preds[level], 1, &new_word))
+        {
+            return abort_alloc;
+        }
+    }
+
+    return success_alloc;
+}
+
+bool tm_skiplist_remove(shared_t shared, tx_t tx, tm_skiplist_t list, tm_ds_word_t key, bool *removed)
+{
+    void *preds[TM_SKIPLIST_MAX_HEIGHT];
+    tm_ds_word_t node;
+    tm_ds_word_t node_key;
+    if (!tm_skiplist_find(shared, tx, list, key, preds, &node, &node_key))
+    {
+        return false;
+    }
+
+    *removed = (node != 0 && node_key == key);
+    if (!*removed)
+    {
+        return true;
+    }
+
+    tm_ds_word_t height;
+    tm_ds_word_t next[TM_SKIPLIST_MAX_HEIGHT];
+    if (!tm_ds_read(shared, tx, tm_ds_field((void *)node, NODE_HEIGHT), 1, &height) ||
+        !tm_ds_read(shared, tx, tm_ds_field((void *)node, NODE_NEXT), height, next))
+    {
+        return false;
+    }
+
+    // Keys are unique: the node is the successor of every predecessor below its height
+    for (size_t level = 0; level < height; level++)
+    {
+        if (!tm_ds_write(shared, tx, preds[level], 1, &next[level]))
+        {
+            return false;
+        }
+    }
+
+    return tm_ds_free_node(shared, tx, tm_ds_field(list, SL_FREE(height)), (void *)node);
+}
@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "macros.h"
+#include "thread_records.h"
+#include "utils.h"
+
+/**
+ * @brief An event of a ring. The fields are atomic, since a dump may read an event while it is overwritten
+ * (such events are detected and dropped by the dump).
+ *
+ */
+typedef struct trace_event
+{
+    _Atomic uint64_t time; // Nanoseconds (CLOCK_MONOTONIC)
+    _Atomic uint64_t tx;
+    _Atomic uint64_t arg;
+    _Atomic uint64_t type;
+} trace_event_t;
+
+/**
+ * @brief Ring of the events of a thread. Only its thread writes it.
+ *
+ */
+typedef struct trace_ring
+{
+    thread_record_t record;
+    _Atomic uint64_t head; // Number of events written so far
+    trace_event_t events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static thread_record_list_t trace_rings = THREAD_RECORD_LIST_INIT(trace_ring_t);
+static _Thread_local trace_ring_t *trace_self = NULL;
+
+static const char *trace_t_names[TRACE_EVENT_TYPES] = {
+    "begin", "read abort", "commit", "lock acquired", "lock failed",
+    "validated", "validation failed", "writeback done", "commit", "txn"};
+
+/**
+ * @brief Write an event as a Chrome trace event.
+ */
+static void trace_t_write_event(FILE *file, bool *first, size_t tid, uint64_t time, uint64_t tx, uint64_t arg, uint64_t type)
+{
+    if (type >= TRACE_EVENT_TYPES || type == TRACE_BEGIN)
+    {
+        // Begin events are written with their txn span (when its end event is written)
+        return;
+    }
+
+    fprintf(file, "%s\n{\"name\":\"%s\",\"pid\":1,\"tid\":%zu,\"ts\":%llu.%03llu", *first ? "" : ",",
+            trace_t_names[type], tid, (unsigned long long)(time / 1000), (unsigned long long)(time % 1000));
+    *first = false;
+
+    switch (type)
+    {
+    case TRACE_COMMIT_START:
+        fprintf(file, ",\"ph\":\"B\"}");
+        break;
+    case TRACE_COMMIT_END:
+        fprintf(file, ",\"ph\":\"E\",\"args\":{\"committed\":%s}}", arg ? "true" : "false");
+        break;
+    case TRACE_END:
+        fprintf(file, ",\"ph\":\"e\",\"cat\":\"txn\",\"id\":\"0x%llx\",\"args\":{\"committed\":%s}}", (unsigned long long)tx, arg ? "true" : "false");
+        break;
+    case TRACE_READ_ABORT:
+        fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"tx\":\"0x%llx\",\"addr\":\"0x%llx\"}}", (unsigned long long)tx, (unsigned long long)arg);
+        break;
+    default:
+        fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"tx\":\"0x%llx\"}}", (unsigned long long)tx);
+        break;
+    }
+}
+
+/*
+    =======
+    Trace implementations
+    =======
+*/
+
+void trace_t_event(trace_event_type_t type, const void *tx, uint64_t arg)
+{
+    if (unlikely(!trace_self))
+    {
+        trace_self = (trace_ring_t *)thread_record_list_t_acquire(&trace_rings);
+        if (unlikely(!trace_self))
+        {
+            return;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t head = atomic_load_explicit(&trace_self->head, memory_order_relaxed);
+    trace_event_t *event = &trace_self->events[head & (TRACE_RING_SIZE - 1)];
+
+    // The event is published by the new head. Until then, a dump reading the slot takes it for the event it overwrites,
+    // which it drops once it sees the new head
+    atomic_store_explicit(&event->time, (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec, memory_order_relaxed);
+    atomic_store_explicit(&event->tx, (uint64_t)(uintptr_t)tx, memory_order_relaxed);
+    atomic_store_explicit(&event->arg, arg, memory_order_relaxed);
+    atomic_store_explicit(&event->type, (uint64_t)type, memory_order_relaxed);
+    atomic_store_explicit(&trace_self->head, head + 1, memory_order_release);
+}
+
+bool trace_t_dump(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    trace_event_t *copy = (trace_event_t *)malloc(TRACE_RING_SIZE * sizeof(trace_event_t));
+    if (unlikely(!file || !copy))
+    {
+        if (file)
+            fclose(file);
+        free(copy);
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+
+    size_t tid = 0;
+    for (thread_record_t *record = thread_record_list_t_first(&trace_rings); record; record = record->next, tid++)
+    {
+        trace_ring_t *ring = (trace_ring_t *)record;
+
+        // Copy the events, then drop the ones whose slot was reused (or is being written) during the copy
+        uint64_t end = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t start = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+        for (uint64_t i = start; i < end; i++)
+        {
+            trace_event_t *event = &ring->events[i & (TRACE_RING_SIZE - 1)];
+            atomic_init(&copy[i - start].time, atomic_load_explicit(&event->time, memory_order_relaxed));
+            atomic_init(&copy[i - start].tx, atomic_load_explicit(&event->tx, memory_order_relaxed));
+            atomic_init(&copy[i - start].arg, atomic_load_explicit(&event->arg, memory_order_relaxed));
+            atomic_init(&copy[i - start].type, atomic_load_explicit(&event->type, memory_order_relaxed));
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t writer = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t valid = writer >= TRACE_RING_SIZE ? writer - TRACE_RING_SIZE + 1 : 0;
+
+        // Begin events are held until the end of their txn, so that the spans written are always closed
+        uint64_t first_valid = start > valid ? start : valid;
+        bool in_commit = false;
+        for (uint64_t i = first_valid; i < end; i++)
+        {
+            trace_event_t *event = &copy[i - start];
+            uint64_t type = atomic_load_explicit(&event->type, memory_order_relaxed);
+            uint64_t tx = atomic_load_explicit(&event->tx, memory_order_relaxed);
+
+            if (type == TRACE_COMMIT_START || type == TRACE_COMMIT_END)
+            {
+                // A commit whose start was overwritten is dropped
+                bool starts = (type == TRACE_COMMIT_START);
+                type = (starts || in_commit) ? type : TRACE_EVENT_TYPES;
+                in_commit = starts;
+            }
+            else if (type == TRACE_END)
+            {
+                // Find the begin of the txn among the previous events of the thread, else drop the end too
+                trace_event_t *begin = NULL;
+                for (uint64_t j = i; !begin && j-- > first_valid;)
+                {
+                    if (atomic_load_explicit(&copy[j - start].type, memory_order_relaxed) == TRACE_BEGIN &&
+                        atomic_load_explicit(&copy[j - start].tx, memory_order_relaxed) == tx)
+                    {
+                        begin = &copy[j - start];
+                    }
+                }
+
+                if (!begin)
+                {
+                    continue;
+                }
+
+                uint64_t time = atomic_load_explicit(&begin->time, memory_order_relaxed);
+                fprintf(file, "%s\n{\"name\":\"txn\",\"cat\":\"txn\",\"ph\":\"b\",\"id\":\"0x%llx\",\"pid\":1,\"tid\":%zu,\"ts\":%llu.%03llu,\"args\":{\"ro\":%s}}",
+                        first ? "" : ",", (unsigned long long)tx, tid, (unsigned long long)(time / 1000), (unsigned long long)(time % 1000),
+                        atomic_load_explicit(&begin->arg, memory_order_relaxed) ? "true" : "false");
+                first = false;
+            }
+
+            trace_t_write_event(file, &first, tid, atomic_load_explicit(&event->time, memory_order_relaxed), tx,
+                                atomic_load_explicit(&event->arg, memory_order_relaxed), type);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    free(copy);
+
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        dprint_cwarn(COLOR_RESET, stdout, "trace: Could not write %s!\n", path);
+    }
+
+    return ok;
+}
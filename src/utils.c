@@ -1,30 +1,85 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "utils.h"
 
 #include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "conflict.h"
+#include "latency.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "redo_log.h"
+#include "shm_region.h"
+#include "thread_context.h"
+
+/**
+ * @brief Allocate a cache-line aligned descriptor (with PAD_HOT_FIELDS). aligned_alloc bypasses the per-thread caches of
+ * malloc, and costs more than the rest of a short txn: the descriptor is aligned in a larger block from malloc instead.
+ */
+static txn_t *txn_t_alloc(void)
+{
+    const size_t align = _Alignof(txn_t);
+    void *block = malloc(sizeof(txn_t) + align - 1);
+    if (unlikely(!block))
+    {
+        return NULL;
+    }
 
-txn_t *txn_t_init(bool is_ro, int rv, int wv)
+    txn_t *txn = (txn_t *)(((uintptr_t)block + align - 1) & ~(uintptr_t)(align - 1));
+    txn->block = block;
+    return txn;
+}
+
+txn_t *txn_t_init(region_t *region, bool is_ro, int shard)
 {
-    txn_t *txn = (txn_t *)malloc(sizeof(txn_t));
+    thread_context_t *context = thread_context_t_idle(region);
+    txn_t *txn = context ? &context->txn : txn_t_alloc();
     if (unlikely(!txn))
     {
         return NULL;
     }
 
     txn->is_ro = is_ro;
-    txn->rv = rv;
-    txn->wv = wv;
-    txn->read_set = set_t_init();
+    txn->read_in_place = false;
+    txn->shard = shard;
+    txn->read_shards = 0;
+    txn->committed = false;
+    txn->begin_time = LATENCY_HISTOGRAMS ? latency_t_now() : 0;
+    if (TRACE_EVENTS)
+    {
+        trace_t_event(TRACE_BEGIN, txn, is_ro);
+    }
+
+    // No word has a negative version: the shards sampled as -1 cannot be read
+    for (int s = 0; s < REGION_SHARDS; s++)
+    {
+        txn->rv[s] = (shard < 0 || s == shard) ? global_versioned_clock_t_get_clock(&region->global_versioned_clock[s]) : -1;
+        txn->wv[s] = -1;
+    }
+
+    txn->context = context;
+    if (context)
+    {
+        txn->read_set = context->read_set;
+        txn->write_set = context->write_set;
+        return txn;
+    }
+
+    txn->read_set = read_set_t_init(&region->set_account);
     if (unlikely(!txn->read_set))
     {
-        free(txn);
+        free(txn->block);
         return NULL;
     }
 
-    txn->write_set = set_t_init();
+    txn->write_set = set_t_init(&region->set_account);
     if (unlikely(!txn->write_set))
     {
-        set_t_destroy(txn->read_set);
-        free(txn);
+        read_set_t_destroy(txn->read_set);
+        free(txn->block);
         return NULL;
     }
 
@@ -33,56 +88,340 @@ txn_t *txn_t_init(bool is_ro, int rv, int wv)
 
 void txn_t_destroy(txn_t *txn)
 {
-    set_t_destroy(txn->read_set);
+    if (LATENCY_HISTOGRAMS)
+    {
+        latency_t_record_txn(txn->begin_time, txn->committed);
+    }
+    if (TRACE_EVENTS)
+    {
+        trace_t_event(TRACE_END, txn, txn->committed);
+    }
+
+    if (txn->context)
+    {
+        thread_context_t_end_txn(txn->context, txn->committed);
+        return;
+    }
+
+    read_set_t_destroy(txn->read_set);
     set_t_destroy(txn->write_set);
 
-    free(txn);
+    free(txn->block);
 }
 
-versioned_write_spinlock_t *utils_get_mapped_lock(versioned_write_spinlock_t *locks, void *addr)
+size_t utils_physical_size(region_t *region, size_t size)
 {
-    uintptr_t x = (uintptr_t)addr;
-    return &locks[x % VWSL_NUM];
+    if (!COLOCATED_LOCKS)
+    {
+        return size;
+    }
+
+    size_t words = size / region->align;
+    size_t blocks = (words + region->colocated_words_per_block - 1) / region->colocated_words_per_block;
+
+    return blocks * region->colocated_block_size;
 }
 
-bool utils_try_lock_set(region_t *region, set_t *set)
+void utils_colocated_init(region_t *region)
 {
-    set_node_t *curr = set->head;
+    // A block is a cache line, or two words when words are larger than half a cache line
+    size_t align = region->align;
+    region->colocated_block_size = 2 * align > CACHE_LINE_SIZE ? 2 * align : CACHE_LINE_SIZE;
+    region->colocated_lock_slot = (sizeof(versioned_write_spinlock_t) + align - 1) / align * align;
+    region->colocated_words_per_block = (region->colocated_block_size - region->colocated_lock_slot) / align;
+
+    region->segment_count = 1; // Segment id 0 is never used, so that no valid address is NULL
+    memset(region->segment_directory, 0, sizeof(region->segment_directory));
+}
 
-    while (curr)
+bool utils_register_segment(region_t *region, void *base, void **addr)
+{
+    size_t id = region->segment_count;
+    if (unlikely(id >= COLOCATED_MAX_SEGMENTS))
     {
-        versioned_write_spinlock_t *vwsl = utils_get_mapped_lock(region->versioned_write_spinlock, curr->addr);
-        if (!versioned_write_spinlock_t_lock(vwsl))
+        return false;
+    }
+
+    void ***chunk = &region->segment_directory[id >> COLOCATED_CHUNK_SHIFT];
+    if (!*chunk)
+    {
+        *chunk = (void **)calloc((size_t)1 << COLOCATED_CHUNK_SHIFT, sizeof(void *));
+        if (unlikely(!*chunk))
         {
-            utils_unlock_set(region, set, set->head, curr);
             return false;
         }
+    }
 
-        curr = curr->next;
+    (*chunk)[id & ((1 << COLOCATED_CHUNK_SHIFT) - 1)] = base;
+    region->segment_count++;
+
+    *addr = (void *)((uintptr_t)id << COLOCATED_SEGMENT_SHIFT);
+
+    return true;
+}
+
+static size_t utils_segment_header_size(region_t *region, size_t *align)
+{
+    // Make sure alignment is okay
+    *align = region->align < sizeof(segment_t *) ? sizeof(void *) : region->align;
+
+    // Co-located locks are found by masking addresses: the data must start at a block boundary
+    if (COLOCATED_LOCKS && *align < region->colocated_block_size)
+    {
+        *align = region->colocated_block_size;
     }
 
+    return (sizeof(segment_t) + *align - 1) & ~(*align - 1);
+}
+
+void *utils_segment_data(region_t *region, segment_t *sn)
+{
+    size_t align;
+    return (void *)((uintptr_t)sn + utils_segment_header_size(region, &align));
+}
+
+bool utils_alloc_segment(region_t *region, size_t size, void **segment)
+{
+    return utils_alloc_segment_in_shard(region, 0, size, segment);
+}
+
+/**
+ * @brief Carve a block from an arena (lock-free), so that the address at the given offset in the block is aligned.
+ */
+static void *utils_arena_carve(char *arena, _Atomic size_t *used_bytes, size_t capacity, size_t size, size_t align, size_t offset)
+{
+    size_t used = atomic_load(used_bytes);
+    size_t start;
+
+    do
+    {
+        start = ((used + offset + align - 1) & ~(align - 1)) - offset;
+        if (start + size > capacity)
+        {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak(used_bytes, &used, start + size));
+
+    return arena + start;
+}
+
+/**
+ * @brief Carve a block from the arena of a shard (lock-free). The arena is never reused: the block is still zeroed.
+ */
+static void *utils_shard_arena_alloc(region_t *region, size_t shard, size_t size, size_t align)
+{
+    char *arena = region->shard_arena + ((shard - 1) << SHARD_ARENA_SHIFT);
+
+    return utils_arena_carve(arena, &region->shard_arena_used[shard], (size_t)1 << SHARD_ARENA_SHIFT, size, align, 0);
+}
+
+/**
+ * @brief Insert a new segment in the segment list of the region (thread-safe), giving it a segment id with co-located locks.
+ */
+static bool utils_insert_segment(region_t *region, segment_t *sn, void **segment)
+{
+    def_lock_t_lock(&region->segment_list_lock);
+    if (COLOCATED_LOCKS && unlikely(!utils_register_segment(region, *segment, segment)))
+    {
+        def_lock_t_unlock(&region->segment_list_lock);
+        return false;
+    }
+    sn->prev = NULL;
+    sn->next = region->allocs;
+    if (sn->next)
+        sn->next->prev = sn;
+    region->allocs = sn;
+    def_lock_t_unlock(&region->segment_list_lock);
+
+    size_t align;
+    mem_account_t_add(&region->segment_account, utils_segment_header_size(region, &align) + utils_physical_size(region, sn->size));
+
     return true;
 }
 
-void utils_unlock_set(region_t *region, set_t *unused(set), set_node_t *start, set_node_t *end)
+bool utils_alloc_segment_in_shard(region_t *region, size_t shard, size_t size, void **segment)
 {
-    // Note: to unlock the full set, start=set->head and end=NULL.
-    set_node_t *curr = start;
+    size_t align;
+    size_t header = utils_segment_header_size(region, &align);
 
-    while (curr)
+    size_t physical_size = utils_physical_size(region, size);
+
+    // Allocate the memory for this new segment
+    segment_t *sn;
+    bool zeroed = (region->shm != NULL || shard > 0);
+    if (shard > 0)
+    {
+        sn = (segment_t *)utils_shard_arena_alloc(region, shard, header + physical_size, align);
+        if (unlikely(!sn))
+        {
+            return false;
+        }
+    }
+    else if (region->shm)
     {
-        // The last node is the node that the lock failed
-        // Thus, we dont need to unlock anything and we stop.
-        if (curr == end)
+        // Carved from the heap of the shared-memory object, so that every attached process sees it at the same address
+        sn = (segment_t *)shm_region_t_alloc(region->shm, header + physical_size, align);
+        if (unlikely(!sn))
         {
-            return;
+            return false;
         }
+    }
+    else if (unlikely(posix_memalign((void **)&sn, align, header + physical_size) != 0))
+    {
+        return false;
+    }
+    sn->size = size;
 
-        versioned_write_spinlock_t *vwsl = utils_get_mapped_lock(region->versioned_write_spinlock, curr->addr);
-        versioned_write_spinlock_t_unlock(vwsl);
+    // Initialize segment words with NULL (and the co-located locks, if any, as unlocked with version 0)
+    void *data = (void *)((uintptr_t)sn + header);
+    if (!zeroed)
+    {
+        memset(data, 0, physical_size); // The heap of a shared-memory object (or a shard arena) is never reused
+    }
+    *segment = data;
 
-        curr = curr->next;
+    // Insert the segment in the linked list in a thread-safe way
+    if (unlikely(!utils_insert_segment(region, sn, segment)))
+    {
+        free(sn);
+        return false;
+    }
+
+    return true;
+}
+
+size_t utils_object_shift_of(region_t *region, size_t object_size)
+{
+    if (!OBJECT_LOCKS || region->object_arena_size == 0 || object_size == 0)
+    {
+        return 0;
+    }
+
+    size_t shift = (size_t)__builtin_ctzll(object_size);
+    if (shift > OBJECT_MIN_SHIFT + OBJECT_CLASSES - 1)
+    {
+        shift = OBJECT_MIN_SHIFT + OBJECT_CLASSES - 1;
+    }
+
+    return (shift < OBJECT_MIN_SHIFT || ((size_t)1 << shift) <= region->align) ? 0 : shift;
+}
+
+void *utils_object_arena_alloc(region_t *region, size_t shift, size_t size, size_t offset)
+{
+    size_t class = shift - OBJECT_MIN_SHIFT;
+    char *arena = region->object_arena + (class << OBJECT_ARENA_SHIFT);
+
+    return utils_arena_carve(arena, &region->object_arena_used[class], (size_t)1 << OBJECT_ARENA_SHIFT, size, (size_t)1 << shift, offset);
+}
+
+bool utils_alloc_segment_of_objects(region_t *region, size_t shift, size_t size, void **segment)
+{
+    size_t align;
+    size_t header = utils_segment_header_size(region, &align);
+
+    // The header is right before the first object, which starts a block
+    segment_t *sn = (segment_t *)utils_object_arena_alloc(region, shift, header + size, header);
+    if (unlikely(!sn))
+    {
+        return false;
     }
+    sn->size = size;
+    *segment = (void *)((uintptr_t)sn + header);
+
+    return utils_insert_segment(region, sn, segment);
+}
+
+segment_range_t *utils_find_range(segment_range_t *ranges, size_t count, uintptr_t addr, size_t size)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (addr >= ranges[i].old_start && addr + size <= ranges[i].old_start + ranges[i].size)
+        {
+            return &ranges[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Unlock the stripes of a write set, in order, up to a given word of a given node (excluded).
+ * Consecutive words that map to the same lock were locked once, so they are unlocked once.
+ */
+static void utils_unlock_stripes(region_t *region, set_node_t *start, set_node_t *end, size_t end_offset)
+{
+    versioned_write_spinlock_t *prev_vwsl = NULL;
+
+    for (set_node_t *curr = start; curr; curr = curr->next)
+    {
+        for (size_t offset = 0; offset < curr->size; offset += region->align)
+        {
+            // The end is the word whose lock failed: it was not taken
+            if (curr == end && offset == end_offset)
+            {
+                return;
+            }
+
+            versioned_write_spinlock_t *vwsl = utils_get_mapped_lock(region, (char *)curr->addr + offset);
+            if (vwsl != prev_vwsl)
+            {
+                versioned_write_spinlock_t_unlock(vwsl);
+            }
+
+            prev_vwsl = vwsl;
+        }
+    }
+}
+
+bool utils_try_lock_set(region_t *region, set_t *set)
+{
+    set_node_t *curr = set->head;
+    size_t offset = 0;
+    versioned_write_spinlock_t *prev_vwsl = NULL;
+    bool waited = false;
+
+    // A node holds a word, or a range of words (borrowed writes): each word of a range has its own stripe
+    while (curr)
+    {
+        // Neighbouring words may share a lock (e.g. a block of the co-located layout): it is only taken once
+        versioned_write_spinlock_t *vwsl = utils_get_mapped_lock(region, (char *)curr->addr + offset);
+        if (vwsl != prev_vwsl && !versioned_write_spinlock_t_lock(vwsl))
+        {
+            utils_unlock_stripes(region, set->head, curr, offset);
+            if (!WAIT_ON_LOCKED_STRIPES || waited)
+            {
+                if (CONFLICT_PROFILER)
+                {
+                    conflict_t_record((char *)curr->addr + offset);
+                }
+                return false;
+            }
+
+            // Wait for the owner without holding any lock (so that waiters never wait on each other), then start over once
+            versioned_write_spinlock_t_wait_unlocked(vwsl);
+            waited = true;
+            curr = set->head;
+            offset = 0;
+            prev_vwsl = NULL;
+            continue;
+        }
+
+        prev_vwsl = vwsl;
+        offset += region->align;
+        if (offset >= curr->size)
+        {
+            curr = curr->next;
+            offset = 0;
+        }
+    }
+
+    return true;
+}
+
+void utils_unlock_set(region_t *region, set_t *unused(set), set_node_t *start, set_node_t *end)
+{
+    // Note: to unlock the full set, start=set->head and end=NULL.
+    utils_unlock_stripes(region, start, end, 0);
 }
 
 bool utils_check_commit(region_t *region, txn_t *txn)
@@ -106,20 +445,90 @@ bool utils_check_commit(region_t *region, txn_t *txn)
 
     // The write set it ordered here. No need for sorting.
 
+    if (DEBUG_CHECKS && unlikely(!set_t_check_borrowed(txn->write_set)))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "utils_check_commit: A buffer passed to tm_write_borrowed was modified before the commit!\n");
+        return ABORT;
+    }
+
+    // Find the shards written by the txn. A txn started in a single shard cannot write to the others
+    unsigned written_shards = 1;
+    if (REGION_SHARDS > 1)
+    {
+        written_shards = 0;
+        for (set_node_t *curr = txn->write_set->head; curr; curr = curr->next)
+        {
+            written_shards |= 1u << utils_shard_of(region, curr->addr);
+        }
+
+        if (txn->shard >= 0 && written_shards != 1u << txn->shard)
+        {
+            return ABORT;
+        }
+    }
+
     // Try to lock the write set
-    if (!utils_try_lock_set(region, txn->write_set))
+    uint64_t phase_start = LATENCY_HISTOGRAMS ? latency_t_now() : 0;
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
+    bool locked = utils_try_lock_set(region, txn->write_set);
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_lock);
+    }
+    if (LATENCY_HISTOGRAMS)
+    {
+        uint64_t now = latency_t_now();
+        latency_t_record(tm_latency_lock, now - phase_start);
+        phase_start = now;
+    }
+    if (TRACE_EVENTS)
+    {
+        trace_t_event(locked ? TRACE_LOCK_ACQUIRED : TRACE_LOCK_FAILED, txn, 0);
+    }
+    if (!locked)
     {
         return ABORT;
     }
 
-    // Increment and Fetch the value of the global_versioned_clock
-    txn->wv = global_versioned_clock_t_increment_and_fetch(&region->global_versioned_clock);
+    // Increment and Fetch the value of the global_versioned_clock of each written shard (always after locking all the words,
+    // so that a txn that sampled the new value of any of these clocks cannot see the old value of any of these words)
+    bool skip_validation = (txn->read_shards & ~written_shards) == 0;
+    int max_wv = 0;
+    for (int shard = 0; shard < REGION_SHARDS; shard++)
+    {
+        if (written_shards & (1u << shard))
+        {
+            txn->wv[shard] = global_versioned_clock_t_increment_and_fetch(&region->global_versioned_clock[shard]);
+            skip_validation = skip_validation && txn->wv[shard] == txn->rv[shard] + 1;
+            max_wv = txn->wv[shard] > max_wv ? txn->wv[shard] : max_wv;
+        }
+    }
 
-    // If the values were modified by another txn, try to vadiate the read set
-    if (txn->wv != txn->rv + 1)
+    // If the values were modified by another txn (in any shard read by this one), try to vadiate the read set
+    if (!skip_validation)
     {
         // Validate read set
-        if (!utils_validate_read_set(region, txn->read_set, txn->rv))
+        if (PERF_COUNTERS)
+        {
+            perf_t_start();
+        }
+        bool valid = utils_validate_read_set(region, txn->read_set, txn->rv, txn->write_set);
+        if (PERF_COUNTERS)
+        {
+            perf_t_stop(tm_perf_validate);
+        }
+        if (LATENCY_HISTOGRAMS)
+        {
+            latency_t_record(tm_latency_validate, latency_t_now() - phase_start);
+        }
+        if (TRACE_EVENTS)
+        {
+            trace_t_event(valid ? TRACE_VALIDATED : TRACE_VALIDATION_FAILED, txn, 0);
+        }
+        if (!valid)
         {
             // Never forget to release the locks, even if the validation was not succesful
             utils_unlock_set(region, txn->write_set, txn->write_set->head, NULL);
@@ -127,25 +536,232 @@ bool utils_check_commit(region_t *region, txn_t *txn)
         }
     }
 
+    // Append the write set to the redo log while the locks are still held, so that the log follows the commit order
+    uint64_t lsn = 0;
+    if (DURABLE_REDO_LOG && region->redo_log)
+    {
+        lsn = redo_log_t_append_write_set(region->redo_log, txn->write_set, max_wv);
+        if (unlikely(!lsn))
+        {
+            utils_unlock_set(region, txn->write_set, txn->write_set->head, NULL);
+            return ABORT;
+        }
+    }
+
     // Write the new values to the words of the write set, and release the locks
+    phase_start = LATENCY_HISTOGRAMS ? latency_t_now() : 0;
+    if (PERF_COUNTERS)
+    {
+        perf_t_start();
+    }
     utils_update_and_unlock_write_set(region, txn->write_set, txn->wv);
+    if (PERF_COUNTERS)
+    {
+        perf_t_stop(tm_perf_writeback);
+    }
+    if (LATENCY_HISTOGRAMS)
+    {
+        latency_t_record(tm_latency_writeback, latency_t_now() - phase_start);
+    }
+    if (TRACE_EVENTS)
+    {
+        trace_t_event(TRACE_WRITEBACK_DONE, txn, 0);
+    }
+
+    // The locks are released early: txns that depend on this one are logged after it, so they cannot become durable before it.
+    // The writes are visible already: a failure is left to the log, which refuses every later commit (see tm_durability_error)
+    if (DURABLE_REDO_LOG && region->redo_log && unlikely(!redo_log_t_wait_durable(region->redo_log, lsn)))
+    {
+        dprint_cwarn(COLOR_RED, stdout, "utils_check_commit: Could not make a commit durable, the redo log refuses the next ones!\n");
+    }
 
     return COMMIT;
 }
 
-bool utils_validate_read_set(region_t *region, read_set_t *set, int rv)
+/**
+ * @brief Get the lock of a read-set entry.
+ */
+static versioned_write_spinlock_t *utils_read_set_lock(region_t *region, read_set_entry_t entry)
 {
-    set_node_t *curr = set->head;
+#if COLOCATED_LOCKS
+    (void)region;
+    return entry;
+#else
+    return &region->versioned_write_spinlock[entry];
+#endif
+}
 
-    while (curr)
+/**
+ * @brief Get the shard of a lock of the lock table (each shard has its own part of the table).
+ */
+static size_t utils_shard_of_lock(region_t *region, versioned_write_spinlock_t *vws)
+{
+    return (size_t)(vws - region->versioned_write_spinlock) / (VWSL_NUM / REGION_SHARDS);
+}
+
+/**
+ * @brief Check whether the transaction holds a lock, i.e. whether a word of its (locked) write-set maps to it.
+ */
+static bool utils_holds_lock(region_t *region, write_set_t *held, versioned_write_spinlock_t *vws)
+{
+    for (set_node_t *curr = held ? held->head : NULL; curr; curr = curr->next)
     {
-        versioned_write_spinlock_t *vws = utils_get_mapped_lock(region->versioned_write_spinlock, curr->addr);
-        if (!utils_validate_versioned_write_spinlock(vws, rv))
+        for (size_t offset = 0; offset < curr->size; offset += region->align)
         {
-            return false;
+            if (utils_get_mapped_lock(region, (char *)curr->addr + offset) == vws)
+            {
+                return true;
+            }
         }
+    }
 
-        curr = curr->next;
+    return false;
+}
+
+/**
+ * @brief Find the first stripe of an array that is locked or newer than rv (one stripe at a time).
+ *
+ * @return size_t The index of the stripe, 'count' if every stripe is valid.
+ */
+static size_t utils_find_invalid_stripe_scalar(const int *locks, const uint32_t *stripes, size_t count, int rv)
+{
+    // A valid lock word is unlocked (even) with a version <= rv, i.e. it is at most 2 * rv
+    for (size_t i = 0; i < count; i++)
+    {
+        int l = locks[stripes[i]];
+        if ((l & 0x1) || l > 2 * rv)
+        {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static size_t utils_find_invalid_stripe_avx2(const int *locks, const uint32_t *stripes, size_t count, int rv)
+{
+    const __m256i limit = _mm256_set1_epi32(2 * rv);
+    const __m256i lock_bit = _mm256_set1_epi32(0x1);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i *)(stripes + i));
+        __m256i l = _mm256_i32gather_epi32(locks, index, sizeof(int));
+        __m256i locked = _mm256_cmpeq_epi32(_mm256_and_si256(l, lock_bit), lock_bit);
+        int invalid = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpgt_epi32(l, limit), locked)));
+        if (invalid)
+        {
+            return i + (size_t)__builtin_ctz((unsigned)invalid);
+        }
+    }
+
+    return i + utils_find_invalid_stripe_scalar(locks, stripes + i, count - i, rv);
+}
+
+__attribute__((target("avx512f"))) static size_t utils_find_invalid_stripe_avx512(const int *locks, const uint32_t *stripes, size_t count, int rv)
+{
+    const __m512i limit = _mm512_set1_epi32(2 * rv);
+    const __m512i lock_bit = _mm512_set1_epi32(0x1);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i index = _mm512_loadu_si512((const void *)(stripes + i));
+        __m512i l = _mm512_i32gather_epi32(index, locks, sizeof(int));
+        __mmask16 invalid = _mm512_cmpgt_epi32_mask(l, limit) | _mm512_test_epi32_mask(l, lock_bit);
+        if (invalid)
+        {
+            return i + (size_t)__builtin_ctz((unsigned)invalid);
+        }
+    }
+
+    return i + utils_find_invalid_stripe_scalar(locks, stripes + i, count - i, rv);
+}
+#endif
+
+typedef size_t (*utils_find_invalid_stripe_fn)(const int *, const uint32_t *, size_t, int);
+
+/**
+ * @brief Pick the widest implementation the CPU supports (once).
+ */
+static utils_find_invalid_stripe_fn utils_find_invalid_stripe_impl(void)
+{
+    static _Atomic(utils_find_invalid_stripe_fn) impl = NULL;
+
+    utils_find_invalid_stripe_fn fn = atomic_load_explicit(&impl, memory_order_relaxed);
+    if (unlikely(!fn))
+    {
+        fn = utils_find_invalid_stripe_scalar;
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (VECTOR_VALIDATION && __builtin_cpu_supports("avx512f"))
+        {
+            fn = utils_find_invalid_stripe_avx512;
+        }
+        else if (VECTOR_VALIDATION && __builtin_cpu_supports("avx2"))
+        {
+            fn = utils_find_invalid_stripe_avx2;
+        }
+#endif
+        atomic_store_explicit(&impl, fn, memory_order_relaxed);
+    }
+
+    return fn;
+}
+
+/**
+ * @brief Validate the i-th entry of a read-set, accepting the stripes locked by the transaction itself.
+ */
+static bool utils_validate_read_set_entry(region_t *region, read_set_t *set, size_t i, const int *rv, write_set_t *held)
+{
+    versioned_write_spinlock_t *vws = utils_read_set_lock(region, set->entries[i]);
+    int shard_rv = rv[REGION_SHARDS == 1 ? 0 : utils_shard_of_lock(region, vws)];
+
+    int l = versioned_write_spinlock_t_load(vws);
+    if ((l >> 1) <= shard_rv && (!(l & 0x1) || utils_holds_lock(region, held, vws)))
+    {
+        return true;
+    }
+
+    if (CONFLICT_PROFILER)
+    {
+        conflict_t_record(set->addrs[i]);
+    }
+
+    return false;
+}
+
+bool utils_validate_read_set(region_t *region, read_set_t *set, const int *rv, write_set_t *held)
+{
+    if (COLOCATED_LOCKS || REGION_SHARDS > 1)
+    {
+        // The stripes are not (all) indices in the lock table, or do not share one rv
+        for (size_t i = 0; i < set->count; i++)
+        {
+            if (!utils_validate_read_set_entry(region, set, i, rv, held))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Check the stripes in bulk: the (rare) invalid-looking ones are checked again one by one, since they may be held
+    utils_find_invalid_stripe_fn find_invalid_stripe = utils_find_invalid_stripe_impl();
+    const int *locks = (const int *)region->versioned_write_spinlock;
+    const uint32_t *stripes = (const uint32_t *)set->entries;
+
+    atomic_thread_fence(memory_order_acquire);
+    for (size_t i = find_invalid_stripe(locks, stripes, set->count, rv[0]); i < set->count;
+         i += 1 + find_invalid_stripe(locks, stripes + i + 1, set->count - i - 1, rv[0]))
+    {
+        if (!utils_validate_read_set_entry(region, set, i, rv, held))
+        {
+            return false;
+        }
     }
 
     return true;
@@ -162,7 +778,7 @@ bool utils_validate_versioned_write_spinlock(versioned_write_spinlock_t *vws, in
     return true;
 }
 
-void utils_update_and_unlock_write_set(region_t *region, write_set_t *set, int wv)
+void utils_update_and_unlock_write_set(region_t *region, write_set_t *set, const int *wv)
 {
     set_node_t *curr = set->head;
 
@@ -170,8 +786,28 @@ void utils_update_and_unlock_write_set(region_t *region, write_set_t *set, int w
     {
         memcpy(curr->addr, curr->val, curr->size);
 
-        versioned_write_spinlock_t *vws = utils_get_mapped_lock(region->versioned_write_spinlock, curr->addr);
-        versioned_write_spinlock_t_update_version(vws, wv); // Updates and unlocks the lock
+        // A segment (and thus a range) never spans two shards
+        int version = wv[utils_shard_of(region, curr->addr)];
+
+        for (size_t offset = 0; offset < curr->size; offset += region->align)
+        {
+            // A lock shared with the next word is released only once that word is written too
+            versioned_write_spinlock_t *vws = utils_get_mapped_lock(region, (char *)curr->addr + offset);
+            versioned_write_spinlock_t *next_vws = NULL;
+            if (offset + region->align < curr->size)
+            {
+                next_vws = utils_get_mapped_lock(region, (char *)curr->addr + offset + region->align);
+            }
+            else if (curr->next)
+            {
+                next_vws = utils_get_mapped_lock(region, curr->next->addr);
+            }
+
+            if (next_vws != vws)
+            {
+                versioned_write_spinlock_t_update_version(vws, version); // Updates and unlocks the lock
+            }
+        }
 
         curr = curr->next;
     }